@@ -4,7 +4,106 @@
 #include "HttpModule.h"
 #include "Interfaces/IHttpRequest.h"
 #include "Interfaces/IHttpResponse.h"
-#include "AudioResampler.h"
+#include "TextSanitizer.h"
+
+namespace
+{
+    // whisper.cpp decodes 16 kHz mono; sending exactly that keeps the upload small and skips its own conversion.
+    constexpr int32 WhisperSampleRate = 16000;
+    constexpr int32 WavHeaderSize = 44;
+    constexpr int32 BytesPerSample = sizeof(int16);
+
+    void WriteLE(uint8*& Dest, uint32 Value, int32 NumBytes)
+    {
+        for (int32 i = 0; i < NumBytes; i++)
+        {
+            *Dest++ = static_cast<uint8>(Value >> (8 * i));
+        }
+    }
+
+    /** Writes a 16-bit mono PCM WAV file of NumSamples samples at SampleRate into Dest, which must hold WavHeaderSize + 2 * NumSamples bytes. */
+    void WriteWav(uint8* Dest, const float* Samples, int32 NumSamples, int32 SampleRate)
+    {
+        const uint32 DataSize = NumSamples * BytesPerSample;
+
+        FMemory::Memcpy(Dest, "RIFF", 4); Dest += 4;
+        WriteLE(Dest, WavHeaderSize - 8 + DataSize, 4);
+        FMemory::Memcpy(Dest, "WAVEfmt ", 8); Dest += 8;
+        WriteLE(Dest, 16, 4);                            // fmt chunk size
+        WriteLE(Dest, 1, 2);                             // PCM
+        WriteLE(Dest, 1, 2);                             // mono
+        WriteLE(Dest, SampleRate, 4);
+        WriteLE(Dest, SampleRate * BytesPerSample, 4);   // byte rate
+        WriteLE(Dest, BytesPerSample, 2);                // block align
+        WriteLE(Dest, 16, 2);                            // bits per sample
+        FMemory::Memcpy(Dest, "data", 4); Dest += 4;
+        WriteLE(Dest, DataSize, 4);
+
+        for (int32 i = 0; i < NumSamples; i++)
+        {
+            const int16 Sample = static_cast<int16>(FMath::Clamp(Samples[i], -1.0f, 1.0f) * 32767.0f);
+            WriteLE(Dest, static_cast<uint16>(Sample), 2);
+        }
+    }
+
+    /** Filter half-length for each quality; Balanced keeps the speech band flat to about 6 kHz at 16 kHz output. */
+    int32 GetZeroCrossings(EResamplerQuality Quality)
+    {
+        switch (Quality)
+        {
+        case EResamplerQuality::Fast:
+            return 4;
+        case EResamplerQuality::Best:
+            return 16;
+        default:
+            return 8;
+        }
+    }
+
+    /** Resamples mono audio to the rate whisper.cpp expects. Returns Samples itself when no conversion is needed. */
+    const float* ToWhisperRate(const TArray<float>& Samples, int32 SampleRate, EResamplerQuality Quality, TArray<float>& Scratch, int32& OutNumSamples)
+    {
+        if (SampleRate == WhisperSampleRate || Samples.Num() == 0)
+        {
+            OutNumSamples = Samples.Num();
+            return Samples.GetData();
+        }
+
+        FStreamingResampler Resampler;
+        Resampler.Init(SampleRate, WhisperSampleRate, GetZeroCrossings(Quality));
+        Scratch.SetNumUninitialized(Resampler.GetMaxOutputFrames(Samples.Num()) + Resampler.GetMaxOutputFrames(Resampler.GetNumTaps()));
+
+        OutNumSamples = Resampler.Process(Samples.GetData(), Samples.Num(), Scratch.GetData());
+        OutNumSamples += Resampler.Flush(Scratch.GetData() + OutNumSamples);
+        return Scratch.GetData();
+    }
+
+    /** Resamples one block of a VAD stream, keeping the filter history in Resampler. Returns Samples itself when no conversion is needed. */
+    const float* ResampleBlock(FStreamingResampler& Resampler, EResamplerQuality Quality, const float* Samples, int32 NumSamples, int32 SampleRate, int32 TargetRate, TArray<float>& OutBuffer, int32& OutNumSamples)
+    {
+        if (SampleRate == TargetRate)
+        {
+            OutNumSamples = NumSamples;
+            return Samples;
+        }
+
+        const int32 ZeroCrossings = GetZeroCrossings(Quality);
+        if (!Resampler.IsInitialized(SampleRate, TargetRate, ZeroCrossings))
+        {
+            Resampler.Init(SampleRate, TargetRate, ZeroCrossings);
+        }
+
+        // Grows once to the block size, then is reused.
+        const int32 MaxOutput = Resampler.GetMaxOutputFrames(NumSamples);
+        if (OutBuffer.Num() < MaxOutput)
+        {
+            OutBuffer.SetNumUninitialized(MaxOutput);
+        }
+
+        OutNumSamples = Resampler.Process(Samples, NumSamples, OutBuffer.GetData());
+        return OutBuffer.GetData();
+    }
+}
 
 UASRComponent::UASRComponent()
 {
@@ -15,11 +114,6 @@ void UASRComponent::BeginPlay()
 {
     Super::BeginPlay();
 
-    if (!IFileManager::Get().DirectoryExists(*RecordedAudioFolder))
-    {
-        IFileManager::Get().MakeDirectory(*RecordedAudioFolder, true);
-    }
-
 #if !(PLATFORM_WINDOWS && PLATFORM_64BITS)
     if (VadMode == EVadMode::WebRTC || VadMode == EVadMode::TEN)
     {
@@ -38,61 +132,63 @@ void UASRComponent::BeginPlay()
     DeviceSampleRate = DeviceInfo.PreferredSampleRate;
     DeviceChannels = DeviceInfo.InputChannels;
 
+    // The ring holds a few seconds so the worker can fall behind briefly, e.g. while a segment is being uploaded.
+    CaptureRing.Init(DeviceSampleRate * CaptureRingSeconds);
+    DownmixBuffer.SetNumUninitialized(CaptureBufferFrames);
+    PreRollBuffer.SetNumZeroed(FMath::Max(0, FMath::RoundToInt(PreRollMs * DeviceSampleRate / 1000.0f)));
+
     Audio::FAudioCaptureDeviceParams CaptureParams;
     Audio::FOnAudioCaptureFunction CaptureCallback = [this](const void* InAudio, int32 NumFrames, int32 NumChannels, int32 SampleRate, double StreamTime, bool bOverflow)
         {
+            // Runs on the audio thread: only downmix into the ring and wake the worker. No locks, no allocations.
             const float* AudioBuffer = static_cast<const float*>(InAudio);
-            const int32 NumSamples = NumFrames * NumChannels;
+            CaptureSampleRate.store(SampleRate, std::memory_order_relaxed);
 
-            TArray<float> MonoBuffer;
-            MonoBuffer.SetNumUninitialized(NumFrames);
-            for (int32 i = 0; i < NumFrames; i++)
+            if (bOverflow)
             {
-                float Sum = 0.f;
-                for (int32 c = 0; c < NumChannels; c++)
-                {
-                    Sum += AudioBuffer[i * NumChannels + c];
-                }
-                MonoBuffer[i] = Sum / NumChannels;
+                CaptureOverflows.fetch_add(1, std::memory_order_relaxed);
             }
 
-            FScopeLock Lock(&AudioDataLock);
-
-            if (IsSpeechFrame(MonoBuffer.GetData(), MonoBuffer.Num(), SampleRate))
-            {
-                CapturedAudioData.Append(MonoBuffer.GetData(), MonoBuffer.Num());
-                SilenceSamplesCount = 0;
-            }
-            else if (CapturedAudioData.Num() > 0)
+            for (int32 Start = 0; Start < NumFrames; Start += DownmixBuffer.Num())
             {
-                SilenceSamplesCount += MonoBuffer.Num();
-                CapturedAudioData.Append(MonoBuffer.GetData(), MonoBuffer.Num());
+                const int32 Count = FMath::Min(DownmixBuffer.Num(), NumFrames - Start);
+                const float* Frames = AudioBuffer + Start * NumChannels;
 
-                if (SilenceSamplesCount >= SecondsOfSilenceBeforeSend * SampleRate)
+                const float* Mono = Frames;
+                if (NumChannels > 1)
                 {
-                    if (CapturedAudioData.Num() >= MinSpeechDuration * SampleRate)
+                    const float Scale = 1.0f / NumChannels;
+                    for (int32 i = 0; i < Count; i++)
                     {
-                        TArray<float> AudioToSave;
-                        AudioToSave = CapturedAudioData;
-                        CapturedAudioData.Empty();
-                        SilenceSamplesCount = 0;
-
-                        FString Guid = FGuid::NewGuid().ToString(EGuidFormats::Short);
-                        FString AudioPath = FPaths::Combine(RecordedAudioFolder, FString::Printf(TEXT("ASR-%s.wav"), *Guid));
-
-                        SaveWavFile(AudioToSave, AudioPath);
-                        TranscribeAudio(AudioPath);
-                    }
-                    else
-                    {
-                        CapturedAudioData.Empty();
-                        SilenceSamplesCount = 0;
+                        float Sum = 0.f;
+                        for (int32 c = 0; c < NumChannels; c++)
+                        {
+                            Sum += Frames[i * NumChannels + c];
+                        }
+                        DownmixBuffer[i] = Sum * Scale;
                     }
+                    Mono = DownmixBuffer.GetData();
+                }
+
+                const int32 Written = CaptureRing.Write(Mono, Count);
+                if (Written < Count)
+                {
+                    DroppedCaptureSamples.fetch_add(Count - Written, std::memory_order_relaxed);
                 }
             }
+
+            CaptureWorkerEvent->Trigger();
         };
 
-    if (!AudioCapture.OpenAudioCaptureStream(CaptureParams, CaptureCallback, 1024))
+    CaptureWorkerEvent = FPlatformProcess::GetSynchEventFromPool(false);
+    CaptureDrainedEvent = FPlatformProcess::GetSynchEventFromPool(false);
+    bStopCaptureWorker = false;
+    CaptureWorker = Async(EAsyncExecution::Thread, [this]()
+        {
+            RunCaptureWorker();
+        });
+
+    if (!AudioCapture.OpenAudioCaptureStream(CaptureParams, CaptureCallback, CaptureBufferFrames))
     {
         UE_LOG(LogTemp, Error, TEXT("[LocalAIForNPCs | ASR] Failed to open audio capture stream."));
         return;
@@ -140,6 +236,165 @@ void UASRComponent::BeginPlay()
     }
 }
 
+void UASRComponent::RunCaptureWorker()
+{
+    TArray<float> Chunk;
+    Chunk.SetNumUninitialized(CaptureBufferFrames);
+
+    while (!bStopCaptureWorker)
+    {
+        CaptureWorkerEvent->Wait(100);
+
+        // Read the flush request before draining, so everything captured before it was made is processed.
+        const uint32 FlushRequest = CaptureFlushRequests.load(std::memory_order_acquire);
+
+        int32 NumRead = 0;
+        while ((NumRead = CaptureRing.Read(Chunk.GetData(), Chunk.Num())) > 0)
+        {
+            ProcessCapturedAudio(Chunk.GetData(), NumRead, CaptureSampleRate.load(std::memory_order_relaxed));
+        }
+
+        if (const int32 Dropped = DroppedCaptureSamples.exchange(0, std::memory_order_relaxed))
+        {
+            UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | ASR] Capture ring full, dropped %d samples."), Dropped);
+        }
+        if (const int32 Overflows = CaptureOverflows.exchange(0, std::memory_order_relaxed))
+        {
+            UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | ASR] Audio device reported %d capture overflows."), Overflows);
+        }
+
+        if (FlushRequest != CaptureFlushesDone.load(std::memory_order_relaxed))
+        {
+            CaptureFlushesDone.store(FlushRequest, std::memory_order_release);
+            CaptureDrainedEvent->Trigger();
+        }
+    }
+}
+
+void UASRComponent::ProcessCapturedAudio(const float* Samples, int32 NumSamples, int32 SampleRate)
+{
+    const int32 MaxSamples = FMath::Max(1, FMath::RoundToInt(MaxBufferedSeconds * SampleRate));
+    TArray<float> AudioToSend;
+    {
+        FScopeLock Lock(&AudioDataLock);
+
+        if (VadMode == EVadMode::Disabled)
+        {
+            const int32 ToKeep = FMath::Min(NumSamples, MaxSamples - CapturedAudioData.Num());
+            if (ToKeep < NumSamples && !bCaptureLimitReached)
+            {
+                UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | ASR] Recording reached %.1f seconds, further audio is ignored."), MaxBufferedSeconds);
+                bCaptureLimitReached = true;
+            }
+            if (ToKeep > 0)
+            {
+                CapturedAudioData.Append(Samples, ToKeep);
+            }
+            return;
+        }
+
+        if (GetSpeechRatio(Samples, NumSamples, SampleRate) > 0.0f)
+        {
+            if (CapturedAudioData.Num() == 0)
+            {
+                // Speech starts: keep the audio just before it, including frames held back by the onset smoothing.
+                TakePreRoll(CapturedAudioData);
+            }
+            CapturedAudioData.Append(Samples, NumSamples);
+            SilenceSamplesCount = 0;
+        }
+        else if (CapturedAudioData.Num() > 0)
+        {
+            SilenceSamplesCount += NumSamples;
+            CapturedAudioData.Append(Samples, NumSamples);
+
+            if (SilenceSamplesCount >= SecondsOfSilenceBeforeSend * SampleRate)
+            {
+                if (CapturedAudioData.Num() >= MinSpeechDuration * SampleRate)
+                {
+                    AudioToSend = MoveTemp(CapturedAudioData);
+                }
+                CapturedAudioData.Reset();
+                SilenceSamplesCount = 0;
+            }
+        }
+        else
+        {
+            WritePreRoll(Samples, NumSamples);
+        }
+
+        if (CapturedAudioData.Num() >= MaxSamples)
+        {
+            UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | ASR] Speech segment reached %.1f seconds, sending it now."), MaxBufferedSeconds);
+            AudioToSend = MoveTemp(CapturedAudioData);
+            CapturedAudioData.Reset();
+            SilenceSamplesCount = 0;
+        }
+    }
+
+    if (AudioToSend.Num() > 0)
+    {
+        TranscribeAudioData(AudioToSend, SampleRate);
+    }
+}
+
+void UASRComponent::WritePreRoll(const float* Samples, int32 NumSamples)
+{
+    const int32 Capacity = PreRollBuffer.Num();
+    if (Capacity == 0)
+    {
+        return;
+    }
+
+    // Only the newest Capacity samples can survive, so older ones are never copied.
+    if (NumSamples > Capacity)
+    {
+        Samples += NumSamples - Capacity;
+        NumSamples = Capacity;
+    }
+
+    const int32 First = FMath::Min(NumSamples, Capacity - PreRollWritePos);
+    FMemory::Memcpy(PreRollBuffer.GetData() + PreRollWritePos, Samples, First * sizeof(float));
+    FMemory::Memcpy(PreRollBuffer.GetData(), Samples + First, (NumSamples - First) * sizeof(float));
+
+    PreRollWritePos = (PreRollWritePos + NumSamples) % Capacity;
+    PreRollNum = FMath::Min(PreRollNum + NumSamples, Capacity);
+}
+
+void UASRComponent::TakePreRoll(TArray<float>& OutAudio)
+{
+    if (PreRollNum == 0)
+    {
+        return;
+    }
+
+    const int32 Capacity = PreRollBuffer.Num();
+    const int32 Start = (PreRollWritePos - PreRollNum + Capacity) % Capacity;
+    const int32 First = FMath::Min(PreRollNum, Capacity - Start);
+    OutAudio.Append(PreRollBuffer.GetData() + Start, First);
+    OutAudio.Append(PreRollBuffer.GetData(), PreRollNum - First);
+
+    PreRollWritePos = 0;
+    PreRollNum = 0;
+}
+
+void UASRComponent::StopCaptureWorker()
+{
+    if (!CaptureWorkerEvent)
+    {
+        return;
+    }
+
+    bStopCaptureWorker = true;
+    CaptureWorkerEvent->Trigger();
+    CaptureWorker.Wait();
+
+    FPlatformProcess::ReturnSynchEventToPool(CaptureWorkerEvent);
+    FPlatformProcess::ReturnSynchEventToPool(CaptureDrainedEvent);
+    CaptureWorkerEvent = nullptr;
+    CaptureDrainedEvent = nullptr;
+}
+
 void UASRComponent::StartRecording()
 {
     if (!AudioCapture.IsStreamOpen())
@@ -156,7 +411,12 @@ void UASRComponent::StartRecording()
 
     {
         FScopeLock Lock(&AudioDataLock);
-        CapturedAudioData.Empty();
+        CapturedAudioData.Reset();
+        SilenceSamplesCount = 0;
+        bCaptureLimitReached = false;
+        ResetVadState();
+        PreRollWritePos = 0;
+        PreRollNum = 0;
     }
 
     if (!AudioCapture.StartStream())
@@ -169,40 +429,95 @@ void UASRComponent::StartRecording()
 }
 
 FString UASRComponent::StopRecording()
+{
+    TArray<float> AudioToSave;
+    if (!StopCapture(AudioToSave))
+    {
+        return TEXT("");
+    }
+
+    UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | ASR] Recording stopped. Saving WAV file..."));
+
+    FString Guid = FGuid::NewGuid().ToString(EGuidFormats::Short);
+    FString AudioPath = FPaths::Combine(RecordedAudioFolder, FString::Printf(TEXT("ASR-%s.wav"), *Guid));
+
+    SaveWavFile(AudioToSave, AudioPath);
+
+    return AudioPath;
+}
+
+void UASRComponent::StopRecordingAndTranscribe()
+{
+    TArray<float> AudioToSend;
+    if (!StopCapture(AudioToSend))
+    {
+        OnTranscriptionComplete.Broadcast(TEXT(""));
+        return;
+    }
+
+    UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | ASR] Recording stopped."));
+
+    TranscribeAudioData(AudioToSend, GetCaptureSampleRate());
+}
+
+int32 UASRComponent::GetCaptureSampleRate() const
+{
+    // Zero until the first capture callback; nothing was recorded then, so the preferred rate is as good as any.
+    const int32 SampleRate = CaptureSampleRate.load(std::memory_order_relaxed);
+    return SampleRate > 0 ? SampleRate : DeviceSampleRate;
+}
+
+void UASRComponent::DiscardRecording()
+{
+    TArray<float> Discarded;
+    if (StopCapture(Discarded))
+    {
+        UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | ASR] Recording discarded."));
+    }
+}
+
+bool UASRComponent::StopCapture(TArray<float>& OutAudio)
 {
     if (VadMode != EVadMode::Disabled)
     {
         UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | ASR] VAD is enabled. Recording will stop automatically when speech is detected."));
-        return TEXT("");
+        return false;
     }
 
     if (!AudioCapture.IsStreamOpen() || !AudioCapture.IsCapturing())
     {
         UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | ASR] Not currently recording."));
-        return TEXT("");
+        return false;
     }
 
     if (!AudioCapture.StopStream())
     {
         UE_LOG(LogTemp, Error, TEXT("[LocalAIForNPCs | ASR] Failed to stop audio capture stream."));
-        return TEXT("");
+        return false;
     }
 
-    UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | ASR] Recording stopped. Saving WAV file..."));
+    // Let the worker process what is still in the ring before taking the recording.
+    const uint32 FlushRequest = CaptureFlushRequests.fetch_add(1, std::memory_order_acq_rel) + 1;
+    CaptureWorkerEvent->Trigger();
 
-    TArray<float> AudioToSave;
+    // The event may still be set by a flush an earlier call stopped waiting for, so wake-ups are checked against the
+    // count the worker has drained up to.
+    const double Deadline = FPlatformTime::Seconds() + 0.5;
+    while (static_cast<int32>(CaptureFlushesDone.load(std::memory_order_acquire) - FlushRequest) < 0)
     {
-        FScopeLock Lock(&AudioDataLock);
-        AudioToSave = CapturedAudioData;
-        CapturedAudioData.Empty();
+        const double Remaining = Deadline - FPlatformTime::Seconds();
+        if (Remaining <= 0.0)
+        {
+            UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | ASR] Timed out waiting for captured audio to be processed."));
+            break;
+        }
+        CaptureDrainedEvent->Wait(FMath::Max(1, FMath::CeilToInt32(Remaining * 1000.0)));
     }
 
-    FString Guid = FGuid::NewGuid().ToString(EGuidFormats::Short);
-    FString AudioPath = FPaths::Combine(RecordedAudioFolder, FString::Printf(TEXT("ASR-%s.wav"), *Guid));
-
-    SaveWavFile(AudioToSave, AudioPath);
-
-    return AudioPath;
+    FScopeLock Lock(&AudioDataLock);
+    OutAudio = MoveTemp(CapturedAudioData);
+    CapturedAudioData.Reset();
+    return true;
 }
 
 void UASRComponent::SaveWavFile(const TArray<float>& InAudioData, FString OutputPath) const
@@ -213,47 +528,15 @@ void UASRComponent::SaveWavFile(const TArray<float>& InAudioData, FString Output
         return;
     }
 
-    int32 SampleRate = DeviceSampleRate;
-    int32 NumChannels = DeviceChannels;
-    int32 BitsPerSample = 16;
+    TArray<float> Resampled;
+    int32 NumSamples = 0;
+    const float* Samples = ToWhisperRate(InAudioData, GetCaptureSampleRate(), ResamplerQuality, Resampled, NumSamples);
 
     TArray<uint8> WavData;
-    int32 NumSamples = InAudioData.Num();
-    int32 DataSize = NumSamples * sizeof(int16);
-    int32 FileSize = 44 + DataSize - 8;
-
-    WavData.Append((uint8*)"RIFF", 4);
-    WavData.Append((uint8*)&FileSize, 4);
-    WavData.Append((uint8*)"WAVE", 4);
-
-    WavData.Append((uint8*)"fmt ", 4);
-    uint32 Subchunk1Size = 16;
-    uint16 AudioFormat = 1;
-    WavData.Append((uint8*)&Subchunk1Size, 4);
-    WavData.Append((uint8*)&AudioFormat, 2);
-    WavData.Append((uint8*)&NumChannels, 2);
-    WavData.Append((uint8*)&SampleRate, 4);
-
-    uint32 ByteRate = SampleRate * NumChannels * BitsPerSample / 8;
-    uint16 BlockAlign = NumChannels * BitsPerSample / 8;
-    WavData.Append((uint8*)&ByteRate, 4);
-    WavData.Append((uint8*)&BlockAlign, 2);
-    WavData.Append((uint8*)&BitsPerSample, 2);
-
-    WavData.Append((uint8*)"data", 4);
-    WavData.Append((uint8*)&DataSize, 4);
-
-    for (int32 i = 0; i < InAudioData.Num(); i += NumChannels)
-    {
-        float MonoSample = 0.0f;
-        for (int32 c = 0; c < NumChannels; ++c)
-            MonoSample += InAudioData[i + c];
-        MonoSample /= NumChannels;
-
-        int16 IntSample = static_cast<int16>(FMath::Clamp(MonoSample, -0.999f, 0.999f) * 32767.0f);
-        WavData.Append((uint8*)&IntSample, sizeof(int16));
-    }
+    WavData.SetNumUninitialized(WavHeaderSize + NumSamples * BytesPerSample);
+    WriteWav(WavData.GetData(), Samples, NumSamples, WhisperSampleRate);
 
+    IFileManager::Get().MakeDirectory(*FPaths::GetPath(OutputPath), true);
     if (FFileHelper::SaveArrayToFile(WavData, *OutputPath))
     {
         UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | ASR] WAV file saved to: %s"), *OutputPath);
@@ -266,7 +549,8 @@ void UASRComponent::SaveWavFile(const TArray<float>& InAudioData, FString Output
 
 void UASRComponent::TranscribeAudio(const FString& AudioPath)
 {
-    if (!FPaths::FileExists(AudioPath))
+    TArray<uint8> FileData;
+    if (!FFileHelper::LoadFileToArray(FileData, *AudioPath))
     {
         UE_LOG(LogTemp, Error, TEXT("[LocalAIForNPCs | ASR] Audio file not found: %s"), *AudioPath);
 
@@ -275,22 +559,74 @@ void UASRComponent::TranscribeAudio(const FString& AudioPath)
         return;
     }
 
+    const FString Boundary = CreateBoundary();
+    TArray<uint8> Content = CreateMultiPartRequest(Boundary, FileData.Num(), [&FileData](uint8* Dest)
+        {
+            FMemory::Memcpy(Dest, FileData.GetData(), FileData.Num());
+        });
+
+    SendTranscriptionRequest(MoveTemp(Content), Boundary, FPaths::GetCleanFilename(AudioPath));
+}
+
+void UASRComponent::TranscribeAudioData(const TArray<float>& MonoAudio, int32 SampleRate)
+{
+    if (MonoAudio.Num() == 0 || SampleRate <= 0)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | ASR] No audio to transcribe."));
+
+        // May run on the capture worker, which EndPlay joins before the component goes away, so this is alive here.
+        AsyncTaskForTurn(TWeakObjectPtr<UASRComponent>(this), nullptr, [this]()
+            {
+                OnTranscriptionComplete.Broadcast(TEXT(""));
+            });
+
+        return;
+    }
+
+    TArray<float> Resampled;
+    int32 NumSamples = 0;
+    const float* Samples = ToWhisperRate(MonoAudio, SampleRate, ResamplerQuality, Resampled, NumSamples);
+
+    // The WAV is written straight into the request body, which is allocated once at its final size.
+    const FString Boundary = CreateBoundary();
+    TArray<uint8> Content = CreateMultiPartRequest(Boundary, WavHeaderSize + NumSamples * BytesPerSample, [Samples, NumSamples](uint8* Dest)
+        {
+            WriteWav(Dest, Samples, NumSamples, WhisperSampleRate);
+        });
+
+    SendTranscriptionRequest(MoveTemp(Content), Boundary, FString::Printf(TEXT("%.2f seconds of audio"), NumSamples / static_cast<float>(WhisperSampleRate)));
+}
+
+void UASRComponent::SendTranscriptionRequest(TArray<uint8>&& Content, const FString& Boundary, const FString& Description)
+{
     FString Url = FString::Printf(TEXT("http://localhost:%d/inference"), Port);
-    TArray<uint8> Content = CreateMultiPartRequest(AudioPath);
 
     TSharedRef<IHttpRequest, ESPMode::ThreadSafe> Request = FHttpModule::Get().CreateRequest();
     Request->SetURL(Url);
     Request->SetVerb("POST");
-    Request->SetHeader("Content-Type", "multipart/form-data; boundary=" + CurrentBoundary);
-    Request->SetContent(Content);
+    Request->SetHeader("Content-Type", "multipart/form-data; boundary=" + Boundary);
+    Request->SetContent(MoveTemp(Content));
 
-    Request->OnProcessRequestComplete().BindLambda([this, AudioPath](FHttpRequestPtr Req, FHttpResponsePtr Response, bool bWasSuccessful)
+    const FCancellationTokenPtr Token = GetCancellationToken();
+    const uint32 CancelHandle = Token->AddCallback([Request]()
         {
+            Request->CancelRequest();
+        });
+
+    Request->OnProcessRequestComplete().BindLambda([this, WeakThis = TWeakObjectPtr<UASRComponent>(this), Description, Token, CancelHandle](FHttpRequestPtr Req, FHttpResponsePtr Response, bool bWasSuccessful)
+        {
+            Token->RemoveCallback(CancelHandle);
+            if (!WeakThis.IsValid() || Token->IsCancelled())
+            {
+                UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | ASR] Transcription of %s cancelled."), *Description);
+                return;
+            }
+
             if (!bWasSuccessful || !Response.IsValid())
             {
                 UE_LOG(LogTemp, Error, TEXT("[LocalAIForNPCs | ASR] Request failed."));
 
-                AsyncTask(ENamedThreads::GameThread, [this]()
+                AsyncTaskForTurn(WeakThis, Token, [this]()
                     {
                         OnTranscriptionComplete.Broadcast(TEXT(""));
                     });
@@ -303,7 +639,7 @@ void UASRComponent::TranscribeAudio(const FString& AudioPath)
             {
                 UE_LOG(LogTemp, Error, TEXT("[LocalAIForNPCs | ASR] HTTP %d: %s"), Code, *Response->GetContentAsString());
 
-                AsyncTask(ENamedThreads::GameThread, [this]()
+                AsyncTaskForTurn(WeakThis, Token, [this]()
                     {
                         OnTranscriptionComplete.Broadcast(TEXT(""));
                     });
@@ -315,98 +651,83 @@ void UASRComponent::TranscribeAudio(const FString& AudioPath)
             UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | ASR] Transcription completed."));
             UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | ASR] Result: %s"), *ResultText);
 
-            FString SanitizedResult = SanitizeString(ResultText);
+            FString SanitizedResult = FTextSanitizer::Sanitize(ResultText, ETextSanitizeFlags::ASR);
 
-            AsyncTask(ENamedThreads::GameThread, [this, SanitizedResult]()
+            AsyncTaskForTurn(WeakThis, Token, [this, SanitizedResult]()
                 {
                     OnTranscriptionComplete.Broadcast(SanitizedResult);
                 });
         });
 
     Request->ProcessRequest();
-    UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | ASR] Transcription request for file %s sent to %s"), *AudioPath, *Url);
+    UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | ASR] Transcription request for %s sent to %s"), *Description, *Url);
 }
 
-TArray<uint8> UASRComponent::CreateMultiPartRequest(FString FilePath)
+void UASRComponent::SetCancellationToken(const FCancellationTokenPtr& Token)
 {
-    TArray<uint8> Payload;
-    FString Boundary = "----UEBoundary" + FGuid::NewGuid().ToString().Replace(TEXT("-"), TEXT(""));
-    CurrentBoundary = Boundary;
-
-    auto AppendLine = [&Payload](const FString& Line)
-        {
-            FString WithNewline = Line + TEXT("\r\n");
-            FTCHARToUTF8 Convert(*WithNewline);
-            Payload.Append((uint8*)Convert.Get(), Convert.Length());
-        };
-
-    AppendLine("--" + Boundary);
-    AppendLine("Content-Disposition: form-data; name=\"file\"");
-    AppendLine("");
-    AppendLine(FilePath);
-
-    AppendLine("--" + Boundary);
-    AppendLine("Content-Disposition: form-data; name=\"temperature\"");
-    AppendLine("");
-    AppendLine("0.0");
-
-    AppendLine("--" + Boundary);
-    AppendLine("Content-Disposition: form-data; name=\"temperature_inc\"");
-    AppendLine("");
-    AppendLine("0.2");
-
-    AppendLine("--" + Boundary);
-    AppendLine("Content-Disposition: form-data; name=\"response_format\"");
-    AppendLine("");
-    AppendLine("text");
-
-    AppendLine("--" + Boundary + "--");
+    FScopeLock Lock(&CancellationTokenLock);
+    CancellationToken = Token;
+}
 
-    return Payload;
+FCancellationTokenPtr UASRComponent::GetCancellationToken()
+{
+    FScopeLock Lock(&CancellationTokenLock);
+    if (!CancellationToken.IsValid())
+    {
+        CancellationToken = MakeShared<FCancellationToken, ESPMode::ThreadSafe>();
+    }
+    return CancellationToken;
 }
 
-FString UASRComponent::SanitizeString(const FString& String)
+FString UASRComponent::CreateBoundary()
 {
-    FString Result = String;
+    return "----UEBoundary" + FGuid::NewGuid().ToString().Replace(TEXT("-"), TEXT(""));
+}
 
-    auto RegexReplace = [](const FString& InputStr, const FString& PatternStr) -> FString
+TArray<uint8> UASRComponent::CreateMultiPartRequest(const FString& Boundary, int32 FileSize, TFunctionRef<void(uint8*)> WriteFile)
+{
+    FString Head;
+    Head += TEXT("--") + Boundary + TEXT("\r\n");
+    Head += TEXT("Content-Disposition: form-data; name=\"file\"; filename=\"audio.wav\"\r\n");
+    Head += TEXT("Content-Type: audio/wav\r\n");
+    Head += TEXT("\r\n");
+
+    FString Tail = TEXT("\r\n");
+    auto AppendField = [&Tail, &Boundary](const TCHAR* Name, const TCHAR* Value)
         {
-            FRegexPattern Pattern(PatternStr);
-            FString Output = InputStr;
-
-            FRegexMatcher Matcher(Pattern, Output);
-            while (Matcher.FindNext())
-            {
-                int32 Start = Matcher.GetMatchBeginning();
-                int32 Length = Matcher.GetMatchEnding() - Start;
-                Output.RemoveAt(Start, Length);
-
-                Matcher = FRegexMatcher(Pattern, Output);
-            }
-
-            return Output;
+            Tail += TEXT("--") + Boundary + TEXT("\r\n");
+            Tail += FString::Printf(TEXT("Content-Disposition: form-data; name=\"%s\"\r\n\r\n%s\r\n"), Name, Value);
         };
+    AppendField(TEXT("temperature"), TEXT("0.0"));
+    AppendField(TEXT("temperature_inc"), TEXT("0.2"));
+    AppendField(TEXT("response_format"), TEXT("text"));
+    Tail += TEXT("--") + Boundary + TEXT("--\r\n");
 
-    Result = RegexReplace(Result, TEXT("\\[[^\\]]*\\]"));
-
-    Result = RegexReplace(Result, TEXT("\\*[^\\*]*\\*"));
-
-    Result = Result.Replace(TEXT("\""), TEXT(""));
-
-    Result = Result.Replace(TEXT("\n"), TEXT(" "));
-    Result = Result.Replace(TEXT("\r"), TEXT(" "));
+    // Boundaries and field values are ASCII, so every character is one byte.
+    TArray<uint8> Payload;
+    Payload.SetNumUninitialized(Head.Len() + FileSize + Tail.Len());
+    uint8* Dest = Payload.GetData();
 
-    Result = Result.TrimStartAndEnd();
+    for (const TCHAR c : Head)
+    {
+        *Dest++ = static_cast<uint8>(c);
+    }
+    WriteFile(Dest);
+    Dest += FileSize;
+    for (const TCHAR c : Tail)
+    {
+        *Dest++ = static_cast<uint8>(c);
+    }
 
-    return Result;
+    return Payload;
 }
 
-bool UASRComponent::IsSpeechFrame(const float* Samples, int32 NumSamples, int32 SampleRate)
+float UASRComponent::GetSpeechRatio(const float* Samples, int32 NumSamples, int32 SampleRate)
 {
     switch (VadMode)
     {
     case EVadMode::Disabled:
-        return true;
+        return 1.0f;
 
     case EVadMode::EnergyBased:
     {
@@ -417,7 +738,8 @@ bool UASRComponent::IsSpeechFrame(const float* Samples, int32 NumSamples, int32
         }
         double Rms = FMath::Sqrt(SumSquares / FMath::Max(1, NumSamples));
 
-        return (Rms >= EnergyThreshold);
+        // The whole block is one frame here.
+        return UpdateVadState(Rms >= EnergyThreshold, 1000.0f * NumSamples / SampleRate) ? 1.0f : 0.0f;
     }
 
 #if PLATFORM_WINDOWS && PLATFORM_64BITS
@@ -428,61 +750,24 @@ bool UASRComponent::IsSpeechFrame(const float* Samples, int32 NumSamples, int32
         if (WebRtcInstance == nullptr)
         {
             UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | ASR | VAD] WebRTC instance not initialized!"));
-            return false;
+            return 0.0f;
         }
 
         const int32 FrameSize = WebRtcSampleRate * WebRtcFrameDurationMs / 1000;
 
-        if (SampleRate != WebRtcSampleRate)
-        {
-            Audio::VectorOps::FAlignedFloatBuffer InputBuffer(const_cast<float*>(Samples), NumSamples);
-
-            Audio::FResamplingParameters Params = {
-                Audio::EResamplingMethod::BestSinc,
-                1,
-                SampleRate,
-                WebRtcSampleRate,
-                InputBuffer
-            };
+        int32 NumResampled = 0;
+        const float* Resampled = ResampleBlock(WebRtcResampler, ResamplerQuality, Samples, NumSamples, SampleRate, WebRtcSampleRate, WebRtcResampledBuffer, NumResampled);
 
-            int32 OutBufferSize = Audio::GetOutputBufferSize(Params);
-            WebRtcResampledBuffer.Reset();
-            WebRtcResampledBuffer.AddZeroed(OutBufferSize);
-
-            Audio::FResamplerResults Results;
-            Results.OutBuffer = &WebRtcResampledBuffer;
-            Audio::Resample(Params, Results);
-        }
-        else
-        {
-            WebRtcResampledBuffer.Reset();
-            WebRtcResampledBuffer.Append(Samples, NumSamples);
-        }
-
-        for (float F : WebRtcResampledBuffer)
-        {
-            float Clamped = FMath::Clamp(F, -1.f, 1.f);
-            WebRtcInputBuffer.Add(static_cast<int16>(Clamped * 32767.f));
-        }
-
-        if (WebRtcInputBuffer.Num() < FrameSize)
-        {
-            return false;
-        }
-
-        TArray<int16> Frame;
-        Frame.Append(WebRtcInputBuffer.GetData(), FrameSize);
-        WebRtcInputBuffer.RemoveAt(0, FrameSize, EAllowShrinking::No);
-
-        int Result = fvad_process(WebRtcInstance, Frame.GetData(), FrameSize);
-
-        if (Result == -1)
-        {
-            UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | ASR | VAD] WebRTC VAD process failed!"));
-            return false;
-        }
+        return ClassifyFrames(Resampled, NumResampled, WebRtcInputBuffer, WebRtcInputFill, FrameSize, WebRtcSampleRate, [this, FrameSize](const int16* Frame)
+            {
+                int Result = fvad_process(WebRtcInstance, Frame, FrameSize);
 
-        return (Result == 1);
+                if (Result == -1)
+                {
+                    UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | ASR | VAD] WebRTC VAD process failed!"));
+                }
+                return Result;
+            });
     }
     case EVadMode::TEN:
     {
@@ -491,69 +776,106 @@ bool UASRComponent::IsSpeechFrame(const float* Samples, int32 NumSamples, int32
         if (TenVadHandle == nullptr)
         {
             UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | ASR | VAD] TEN VAD instance not initialized!"));
-            return false;
+            return 0.0f;
         }
 
-        if (SampleRate != TenVadSampleRate)
-        {
-            Audio::VectorOps::FAlignedFloatBuffer InputBuffer(const_cast<float*>(Samples), NumSamples);
+        int32 NumResampled = 0;
+        const float* Resampled = ResampleBlock(TenVadResampler, ResamplerQuality, Samples, NumSamples, SampleRate, TenVadSampleRate, TenVadResampledBuffer, NumResampled);
 
-            Audio::FResamplingParameters Params = {
-                Audio::EResamplingMethod::BestSinc,
-                1,
-                SampleRate,
-                TenVadSampleRate,
-                InputBuffer
-            };
+        return ClassifyFrames(Resampled, NumResampled, TenVadInputBuffer, TenVadInputFill, static_cast<int32>(TenVadHopSize), TenVadSampleRate, [this](const int16* Frame)
+            {
+                float Probability;
+                int Result;
 
-            int32 OutBufferSize = Audio::GetOutputBufferSize(Params);
-            TenVadResampledBuffer.Reset();
-            TenVadResampledBuffer.AddZeroed(OutBufferSize);
+                if (ten_vad_process(TenVadHandle, Frame, TenVadHopSize, &Probability, &Result) < 0)
+                {
+                    UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | ASR | VAD] TEN VAD process failed!"));
+                    return -1;
+                }
+                return Result;
+            });
+    }
+#endif
+    default:
+        return 1.0f;
+    }
+}
 
-            Audio::FResamplerResults Results;
-            Results.OutBuffer = &TenVadResampledBuffer;
-            Audio::Resample(Params, Results);
-        }
-        else
-        {
-            TenVadResampledBuffer.Reset();
-            TenVadResampledBuffer.Append(Samples, NumSamples);
-        }
+float UASRComponent::ClassifyFrames(const float* Samples, int32 NumSamples, TArray<int16>& FrameBuffer, int32& FrameFill, int32 FrameSize, int32 FrameRate, TFunctionRef<int32(const int16*)> ClassifyFrame)
+{
+    if (FrameBuffer.Num() != FrameSize)
+    {
+        FrameBuffer.SetNumZeroed(FrameSize);
+        FrameFill = 0;
+    }
 
-        for (float F : TenVadResampledBuffer)
+    // Every complete frame of the block is classified; a partial one waits in FrameBuffer for the next block.
+    const float FrameMs = 1000.0f * FrameSize / FrameRate;
+    int32 NumFrames = 0;
+    int32 NumSpeechFrames = 0;
+    for (int32 i = 0; i < NumSamples; i++)
+    {
+        FrameBuffer[FrameFill++] = static_cast<int16>(FMath::Clamp(Samples[i], -1.f, 1.f) * 32767.f);
+        if (FrameFill < FrameSize)
         {
-            float Clamped = FMath::Clamp(F, -1.f, 1.f);
-            TenVadInputBuffer.Add(static_cast<int16>(Clamped * 32767.f));
+            continue;
         }
+        FrameFill = 0;
 
-        if (TenVadInputBuffer.Num() < TenVadHopSize)
+        // A failed frame counts as silence.
+        NumFrames++;
+        if (UpdateVadState(ClassifyFrame(FrameBuffer.GetData()) == 1, FrameMs))
         {
-            return false;
+            NumSpeechFrames++;
         }
+    }
 
-        TArray<int16> Frame;
-        Frame.Append(TenVadInputBuffer.GetData(), TenVadHopSize);
-        TenVadInputBuffer.RemoveAt(0, TenVadHopSize, EAllowShrinking::No);
-
-        float Probability;
-        int Result;
+    if (NumFrames == 0)
+    {
+        return bVadInSpeech ? 1.0f : 0.0f;
+    }
+    return static_cast<float>(NumSpeechFrames) / NumFrames;
+}
 
-        if (ten_vad_process(TenVadHandle, Frame.GetData(), TenVadHopSize, &Probability, &Result) < 0)
+bool UASRComponent::UpdateVadState(bool bFrameIsSpeech, float FrameMs)
+{
+    if (bFrameIsSpeech)
+    {
+        VadOnsetCount++;
+        if (VadOnsetCount >= VadOnsetFrames)
         {
-            UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | ASR | VAD] TEN VAD process failed!"));
-            return false;
+            bVadInSpeech = true;
+        }
+        if (bVadInSpeech)
+        {
+            VadHangoverRemainingMs = VadHangoverMs;
         }
-
-        return (Result == 1);
     }
-#endif
-    default:
-        return true;
+    else
+    {
+        VadOnsetCount = 0;
+        if (bVadInSpeech)
+        {
+            VadHangoverRemainingMs -= FrameMs;
+            bVadInSpeech = VadHangoverRemainingMs > 0.0f;
+        }
     }
+    return bVadInSpeech;
+}
+
+void UASRComponent::ResetVadState()
+{
+    bVadInSpeech = false;
+    VadOnsetCount = 0;
+    VadHangoverRemainingMs = 0.0f;
+    WebRtcInputFill = 0;
+    TenVadInputFill = 0;
 }
 
 void UASRComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
+    GetCancellationToken()->Cancel();
+
     Super::EndPlay(EndPlayReason);
 
     if (AudioCapture.IsStreamOpen())
@@ -562,6 +884,8 @@ void UASRComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
         AudioCapture.CloseStream();
     }
 
+    StopCaptureWorker();
+
     if (!RecordedAudioFolder.IsEmpty() && IFileManager::Get().DirectoryExists(*RecordedAudioFolder))
     {
         TArray<FString> FilesToDelete;
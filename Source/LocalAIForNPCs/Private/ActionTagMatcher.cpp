@@ -0,0 +1,79 @@
+#include "ActionTagMatcher.h"
+
+namespace
+{
+    const TCHAR TagPrefix[] = TEXT("[[action: ");
+    constexpr int32 TagPrefixLen = UE_ARRAY_COUNT(TagPrefix) - 1;
+
+    /** Longer commands are treated as a malformed tag and dropped, so a stray opener cannot buffer a whole reply. */
+    constexpr int32 MaxCommandLen = 256;
+
+    bool IsLineTerminator(TCHAR c)
+    {
+        return c == '\n' || c == '\r' || c == 0x85 || c == 0x2028 || c == 0x2029;
+    }
+}
+
+FActionTagMatcher::FActionTagMatcher()
+{
+    Reset();
+}
+
+void FActionTagMatcher::Reset()
+{
+    PrefixMatched = 0;
+    bInCommand = false;
+    Command.Reset();
+}
+
+void FActionTagMatcher::Feed(FStringView Text, TArray<FString>& OutCommands)
+{
+    for (const TCHAR c : Text)
+    {
+        if (bInCommand)
+        {
+            if (IsLineTerminator(c) || Command.Len() >= MaxCommandLen)
+            {
+                Reset();
+                // The character may still open a new tag.
+            }
+            else if (c == ']' && Command.Len() >= 2 && Command[Command.Len() - 1] == ']')
+            {
+                Command.LeftChopInline(1, EAllowShrinking::No);
+                OutCommands.Add(Command);
+                Reset();
+                continue;
+            }
+            else
+            {
+                Command.AppendChar(c);
+                continue;
+            }
+        }
+
+        if (c == TagPrefix[PrefixMatched])
+        {
+            if (++PrefixMatched == TagPrefixLen)
+            {
+                PrefixMatched = 0;
+                bInCommand = true;
+            }
+        }
+        else if (c == '[')
+        {
+            // The prefix only repeats its opening bracket, so a mismatching '[' after "[[" keeps both brackets,
+            // and anywhere else it starts a new match.
+            PrefixMatched = PrefixMatched == 2 ? 2 : 1;
+        }
+        else
+        {
+            PrefixMatched = 0;
+        }
+    }
+}
+
+void FActionTagMatcher::FindAll(FStringView Text, TArray<FString>& OutCommands)
+{
+    FActionTagMatcher Matcher;
+    Matcher.Feed(Text, OutCommands);
+}
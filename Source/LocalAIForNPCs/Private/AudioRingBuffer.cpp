@@ -0,0 +1,56 @@
+#include "AudioRingBuffer.h"
+
+void FAudioRingBuffer::Init(int32 MinCapacity)
+{
+    const uint32 Capacity = FMath::RoundUpToPowerOfTwo(static_cast<uint32>(FMath::Max(MinCapacity, 2)));
+    Buffer.SetNumZeroed(Capacity);
+    Mask = Capacity - 1;
+    WriteIndex.store(0, std::memory_order_relaxed);
+    ReadIndex.store(0, std::memory_order_relaxed);
+}
+
+int32 FAudioRingBuffer::Write(const float* Samples, int32 NumSamples)
+{
+    const uint32 WritePos = WriteIndex.load(std::memory_order_relaxed);
+    const uint32 ReadPos = ReadIndex.load(std::memory_order_acquire);
+
+    const int32 Free = Buffer.Num() - static_cast<int32>(WritePos - ReadPos);
+    const int32 ToWrite = FMath::Min(NumSamples, Free);
+    if (ToWrite <= 0)
+    {
+        return 0;
+    }
+
+    const int32 Start = WritePos & Mask;
+    const int32 First = FMath::Min(ToWrite, Buffer.Num() - Start);
+    FMemory::Memcpy(Buffer.GetData() + Start, Samples, First * sizeof(float));
+    FMemory::Memcpy(Buffer.GetData(), Samples + First, (ToWrite - First) * sizeof(float));
+
+    WriteIndex.store(WritePos + ToWrite, std::memory_order_release);
+    return ToWrite;
+}
+
+int32 FAudioRingBuffer::Read(float* OutSamples, int32 MaxSamples)
+{
+    const uint32 ReadPos = ReadIndex.load(std::memory_order_relaxed);
+    const uint32 WritePos = WriteIndex.load(std::memory_order_acquire);
+
+    const int32 ToRead = FMath::Min(MaxSamples, static_cast<int32>(WritePos - ReadPos));
+    if (ToRead <= 0)
+    {
+        return 0;
+    }
+
+    const int32 Start = ReadPos & Mask;
+    const int32 First = FMath::Min(ToRead, Buffer.Num() - Start);
+    FMemory::Memcpy(OutSamples, Buffer.GetData() + Start, First * sizeof(float));
+    FMemory::Memcpy(OutSamples + First, Buffer.GetData(), (ToRead - First) * sizeof(float));
+
+    ReadIndex.store(ReadPos + ToRead, std::memory_order_release);
+    return ToRead;
+}
+
+int32 FAudioRingBuffer::Num() const
+{
+    return static_cast<int32>(WriteIndex.load(std::memory_order_acquire) - ReadIndex.load(std::memory_order_acquire));
+}
@@ -0,0 +1,65 @@
+#include "CancellationToken.h"
+
+void FCancellationToken::Cancel()
+{
+    TArray<TPair<uint32, TFunction<void()>>> ToRun;
+    {
+        FScopeLock Lock(&Mutex);
+        if (bCancelled)
+        {
+            return;
+        }
+        bCancelled = true;
+        ToRun = MoveTemp(Callbacks);
+    }
+
+    // Callbacks run outside the lock so they may remove themselves or cancel other work.
+    for (TPair<uint32, TFunction<void()>>& Entry : ToRun)
+    {
+        Entry.Value();
+    }
+}
+
+uint32 FCancellationToken::AddCallback(TFunction<void()> Callback)
+{
+    {
+        FScopeLock Lock(&Mutex);
+        if (!bCancelled)
+        {
+            const uint32 Handle = NextHandle++;
+            Callbacks.Emplace(Handle, MoveTemp(Callback));
+            return Handle;
+        }
+    }
+
+    Callback();
+    return 0;
+}
+
+void FCancellationToken::RemoveCallback(uint32 Handle)
+{
+    if (Handle == 0)
+    {
+        return;
+    }
+
+    FScopeLock Lock(&Mutex);
+    Callbacks.RemoveAll([Handle](const TPair<uint32, TFunction<void()>>& Entry) { return Entry.Key == Handle; });
+}
+
+FCancellationScope::FCancellationScope(const FCancellationTokenPtr& InToken, TFunction<void()> Callback)
+    : Token(InToken)
+{
+    if (Token.IsValid())
+    {
+        Handle = Token->AddCallback(MoveTemp(Callback));
+    }
+}
+
+FCancellationScope::~FCancellationScope()
+{
+    if (Token.IsValid())
+    {
+        Token->RemoveCallback(Handle);
+    }
+}
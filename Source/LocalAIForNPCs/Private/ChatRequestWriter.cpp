@@ -0,0 +1,194 @@
+#include "ChatRequestWriter.h"
+#include "LLMComponent.h"
+
+void FChatRequestWriter::Invalidate()
+{
+    CachedMessages.Reset();
+    NumCachedMessages = 0;
+    bHasCachedSystem = false;
+}
+
+void FChatRequestWriter::Write(TArray<uint8>& Out, const FChatRequestParams& Params, const FString& SystemMessage, const FString& HistoryPrefix, const TArray<FChatMessage>& History)
+{
+    if (!bHasCachedSystem
+        || History.Num() < NumCachedMessages
+        || !CachedSystemMessage.Equals(SystemMessage, ESearchCase::CaseSensitive)
+        || !CachedHistoryPrefix.Equals(HistoryPrefix, ESearchCase::CaseSensitive))
+    {
+        Invalidate();
+
+        CachedSystemMessage = SystemMessage;
+        CachedHistoryPrefix = HistoryPrefix;
+        bHasCachedSystem = true;
+
+        if (!SystemMessage.IsEmpty())
+        {
+            AppendMessage(TEXT("system"), FString(), SystemMessage);
+        }
+    }
+
+    const bool bHasTurnContext = Params.TurnContext && !Params.TurnContext->IsEmpty() && History.Num() > 0;
+    const int32 NumToCache = bHasTurnContext ? History.Num() - 1 : History.Num();
+
+    for (; NumCachedMessages < NumToCache; NumCachedMessages++)
+    {
+        const FChatMessage& Message = History[NumCachedMessages];
+        AppendMessage(Message.Role, NumCachedMessages == 0 ? HistoryPrefix : FString(), Message.Content);
+    }
+
+    Out.Reset();
+    Out.Reserve(CachedMessages.Num() + (bHasTurnContext ? (HistoryPrefix.Len() + Params.TurnContext->Len() + History.Last().Content.Len()) * 3 : 0)
+        + (Params.Grammar ? Params.Grammar->Len() * 3 : 0) + 96);
+
+    AppendRaw(Out, Params.bStream ? "{\"stream\":true" : "{\"stream\":false");
+    if (Params.bCachePrompt)
+    {
+        AppendRaw(Out, ",\"cache_prompt\":true");
+        if (Params.SlotId >= 0)
+        {
+            AppendRaw(Out, ",\"id_slot\":");
+            AppendInt(Out, Params.SlotId);
+        }
+    }
+
+    if (Params.Grammar && !Params.Grammar->IsEmpty())
+    {
+        AppendRaw(Out, ",\"grammar\":");
+        AppendString(Out, *Params.Grammar);
+    }
+
+    if (Params.MaxTokens >= 0)
+    {
+        AppendRaw(Out, ",\"n_predict\":");
+        AppendInt(Out, Params.MaxTokens);
+    }
+
+    AppendRaw(Out, ",\"messages\":[");
+    if (CachedMessages.Num() > 1)
+    {
+        Out.Append(CachedMessages.GetData() + 1, CachedMessages.Num() - 1);
+    }
+
+    if (bHasTurnContext)
+    {
+        const FChatMessage& Last = History.Last();
+        AppendRaw(Out, CachedMessages.Num() > 1 ? ",{\"role\":" : "{\"role\":");
+        AppendString(Out, Last.Role);
+        AppendRaw(Out, ",\"content\":\"");
+        if (History.Num() == 1)
+        {
+            AppendEscaped(Out, HistoryPrefix);
+        }
+        AppendEscaped(Out, *Params.TurnContext);
+        AppendEscaped(Out, Last.Content);
+        AppendRaw(Out, "\"}");
+    }
+
+    AppendRaw(Out, "]}");
+}
+
+void FChatRequestWriter::AppendMessage(const FString& Role, const FString& Prefix, const FString& Content)
+{
+    AppendRaw(CachedMessages, ",{\"role\":");
+    AppendString(CachedMessages, Role);
+    AppendRaw(CachedMessages, ",\"content\":\"");
+    AppendEscaped(CachedMessages, Prefix);
+    AppendEscaped(CachedMessages, Content);
+    AppendRaw(CachedMessages, "\"}");
+}
+
+void FChatRequestWriter::AppendRaw(TArray<uint8>& Out, const ANSICHAR* Str)
+{
+    Out.Append(reinterpret_cast<const uint8*>(Str), FCStringAnsi::Strlen(Str));
+}
+
+void FChatRequestWriter::AppendInt(TArray<uint8>& Out, int64 Value)
+{
+    ANSICHAR Digits[24];
+    const int32 Len = FCStringAnsi::Snprintf(Digits, UE_ARRAY_COUNT(Digits), "%lld", static_cast<long long>(Value));
+    Out.Append(reinterpret_cast<const uint8*>(Digits), Len);
+}
+
+void FChatRequestWriter::AppendString(TArray<uint8>& Out, const FString& Str)
+{
+    Out.Add('"');
+    AppendEscaped(Out, Str);
+    Out.Add('"');
+}
+
+void FChatRequestWriter::AppendEscaped(TArray<uint8>& Out, const FString& Str)
+{
+    static const ANSICHAR HexDigits[] = "0123456789abcdef";
+
+    const TCHAR* Ptr = *Str;
+    const TCHAR* End = Ptr + Str.Len();
+
+    // Worst case is three UTF-8 bytes per UTF-16 unit, control characters are rare enough to grow on demand.
+    Out.Reserve(Out.Num() + Str.Len() * 3);
+
+    while (Ptr < End)
+    {
+        uint32 CodePoint = static_cast<uint32>(*Ptr++);
+
+        if (CodePoint < 0x80)
+        {
+            switch (CodePoint)
+            {
+            case '"':  Out.Add('\\'); Out.Add('"'); break;
+            case '\\': Out.Add('\\'); Out.Add('\\'); break;
+            case '\n': Out.Add('\\'); Out.Add('n'); break;
+            case '\r': Out.Add('\\'); Out.Add('r'); break;
+            case '\t': Out.Add('\\'); Out.Add('t'); break;
+            case '\b': Out.Add('\\'); Out.Add('b'); break;
+            case '\f': Out.Add('\\'); Out.Add('f'); break;
+            default:
+                if (CodePoint < 0x20)
+                {
+                    const uint8 Escape[6] = { '\\', 'u', '0', '0', static_cast<uint8>(HexDigits[CodePoint >> 4]), static_cast<uint8>(HexDigits[CodePoint & 0xF]) };
+                    Out.Append(Escape, 6);
+                }
+                else
+                {
+                    Out.Add(static_cast<uint8>(CodePoint));
+                }
+                break;
+            }
+            continue;
+        }
+
+        if (CodePoint >= 0xD800 && CodePoint <= 0xDBFF)
+        {
+            if (Ptr < End && *Ptr >= 0xDC00 && *Ptr <= 0xDFFF)
+            {
+                CodePoint = 0x10000 + ((CodePoint - 0xD800) << 10) + (static_cast<uint32>(*Ptr++) - 0xDC00);
+            }
+            else
+            {
+                CodePoint = 0xFFFD;
+            }
+        }
+        else if ((CodePoint >= 0xDC00 && CodePoint <= 0xDFFF) || CodePoint > 0x10FFFF)
+        {
+            CodePoint = 0xFFFD;
+        }
+
+        if (CodePoint < 0x800)
+        {
+            Out.Add(static_cast<uint8>(0xC0 | (CodePoint >> 6)));
+            Out.Add(static_cast<uint8>(0x80 | (CodePoint & 0x3F)));
+        }
+        else if (CodePoint < 0x10000)
+        {
+            Out.Add(static_cast<uint8>(0xE0 | (CodePoint >> 12)));
+            Out.Add(static_cast<uint8>(0x80 | ((CodePoint >> 6) & 0x3F)));
+            Out.Add(static_cast<uint8>(0x80 | (CodePoint & 0x3F)));
+        }
+        else
+        {
+            Out.Add(static_cast<uint8>(0xF0 | (CodePoint >> 18)));
+            Out.Add(static_cast<uint8>(0x80 | ((CodePoint >> 12) & 0x3F)));
+            Out.Add(static_cast<uint8>(0x80 | ((CodePoint >> 6) & 0x3F)));
+            Out.Add(static_cast<uint8>(0x80 | (CodePoint & 0x3F)));
+        }
+    }
+}
@@ -0,0 +1,249 @@
+#include "EmbeddingCache.h"
+#include "HAL/FileManager.h"
+#include "Hash/xxhash.h"
+#include "Misc/Paths.h"
+
+FEmbeddingCache::FEmbeddingCache(int32 QueryCapacity)
+    : QueryCache(FMath::Max(1, QueryCapacity))
+{
+}
+
+uint64 FEmbeddingCache::MakeKey(const FString& ModelId, const FString& Text)
+{
+    const FTCHARToUTF8 ModelUtf8(*ModelId);
+    const FTCHARToUTF8 TextUtf8(*Text);
+    const uint8 Separator = 0;
+
+    FXxHash64Builder Builder;
+    Builder.Update(ModelUtf8.Get(), ModelUtf8.Length());
+    Builder.Update(&Separator, 1);
+    Builder.Update(TextUtf8.Get(), TextUtf8.Length());
+    return Builder.Finalize().Hash;
+}
+
+bool FEmbeddingCache::Load(const FString& FilePath)
+{
+    TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*FilePath));
+    if (!Reader)
+    {
+        return false;
+    }
+
+    uint32 Magic = 0;
+    uint32 Version = 0;
+    int32 FileDimension = 0;
+    int32 Count = 0;
+    *Reader << Magic << Version << FileDimension << Count;
+
+    // Version 1 files have no usage stamps; their rows count as least recently used.
+    const int64 StampSize = Version >= 2 ? sizeof(uint32) : 0;
+    const int64 ExpectedSize = 16 + static_cast<int64>(Count) * (sizeof(uint64) + StampSize + static_cast<int64>(FileDimension) * sizeof(float));
+    if (Magic != FileMagic || Version < 1 || Version > FileVersion || FileDimension <= 0 || Count < 0 || Reader->TotalSize() != ExpectedSize)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | LLM | RAG] Ignoring invalid embedding cache file: %s"), *FilePath);
+        return false;
+    }
+
+    FScopeLock Lock(&Mutex);
+
+    Dimension = FileDimension;
+    Keys.SetNumUninitialized(Count);
+    LastUsed.SetNumZeroed(Count);
+    Rows.SetNumUninitialized(Count * Dimension);
+    Reader->Serialize(Keys.GetData(), Keys.Num() * sizeof(uint64));
+    if (StampSize > 0)
+    {
+        Reader->Serialize(LastUsed.GetData(), LastUsed.Num() * sizeof(uint32));
+    }
+    Reader->Serialize(Rows.GetData(), Rows.Num() * sizeof(float));
+
+    RowByKey.Empty(Count);
+    Session = 1;
+    for (int32 i = 0; i < Count; i++)
+    {
+        RowByKey.Add(Keys[i], i);
+        Session = FMath::Max(Session, LastUsed[i] + 1);
+    }
+    bDirty = false;
+
+    return !Reader->IsError();
+}
+
+bool FEmbeddingCache::Save(const FString& FilePath)
+{
+    FScopeLock Lock(&Mutex);
+
+    if (!bDirty)
+    {
+        return true;
+    }
+
+    EvictLeastRecentlyUsed();
+
+    IFileManager& FileManager = IFileManager::Get();
+    FileManager.MakeDirectory(*FPaths::GetPath(FilePath), true);
+
+    const FString TempPath = FilePath + TEXT(".tmp");
+    {
+        TUniquePtr<FArchive> Writer(FileManager.CreateFileWriter(*TempPath));
+        if (!Writer)
+        {
+            UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | LLM | RAG] Failed to write embedding cache file: %s"), *TempPath);
+            return false;
+        }
+
+        uint32 Magic = FileMagic;
+        uint32 Version = FileVersion;
+        int32 Count = Keys.Num();
+        *Writer << Magic << Version << Dimension << Count;
+        Writer->Serialize(Keys.GetData(), Keys.Num() * sizeof(uint64));
+        Writer->Serialize(LastUsed.GetData(), LastUsed.Num() * sizeof(uint32));
+        Writer->Serialize(Rows.GetData(), Rows.Num() * sizeof(float));
+
+        if (!Writer->Close())
+        {
+            UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | LLM | RAG] Failed to write embedding cache file: %s"), *TempPath);
+            Writer.Reset();
+            FileManager.Delete(*TempPath);
+            return false;
+        }
+    }
+
+    if (!FileManager.Move(*FilePath, *TempPath, true, true))
+    {
+        UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | LLM | RAG] Failed to replace embedding cache file: %s"), *FilePath);
+        FileManager.Delete(*TempPath);
+        return false;
+    }
+
+    bDirty = false;
+    return true;
+}
+
+void FEmbeddingCache::SetMaxEntries(int32 InMaxEntries)
+{
+    FScopeLock Lock(&Mutex);
+    MaxEntries = FMath::Max(0, InMaxEntries);
+}
+
+void FEmbeddingCache::EvictLeastRecentlyUsed()
+{
+    const int32 Count = Keys.Num();
+    if (MaxEntries <= 0 || Count <= MaxEntries)
+    {
+        return;
+    }
+
+    // Keep the most recently used rows; among rows last used in the same session, the ones added later.
+    TArray<int32> Kept;
+    Kept.SetNumUninitialized(Count);
+    for (int32 i = 0; i < Count; i++)
+    {
+        Kept[i] = i;
+    }
+    Kept.Sort([this](int32 A, int32 B)
+        {
+            return LastUsed[A] != LastUsed[B] ? LastUsed[A] > LastUsed[B] : A > B;
+        });
+    Kept.SetNum(MaxEntries);
+    Kept.Sort();
+
+    TArray<uint64> NewKeys;
+    TArray<uint32> NewLastUsed;
+    TArray<float> NewRows;
+    NewKeys.Reserve(MaxEntries);
+    NewLastUsed.Reserve(MaxEntries);
+    NewRows.Reserve(MaxEntries * Dimension);
+    RowByKey.Reset();
+    for (int32 Row : Kept)
+    {
+        RowByKey.Add(Keys[Row], NewKeys.Num());
+        NewKeys.Add(Keys[Row]);
+        NewLastUsed.Add(LastUsed[Row]);
+        NewRows.Append(Rows.GetData() + static_cast<int64>(Row) * Dimension, Dimension);
+    }
+
+    Keys = MoveTemp(NewKeys);
+    LastUsed = MoveTemp(NewLastUsed);
+    Rows = MoveTemp(NewRows);
+
+    UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | RAG] Evicted %d least recently used embeddings from the cache."), Count - MaxEntries);
+}
+
+bool FEmbeddingCache::Find(uint64 Key, TArray<float>& OutEmbedding)
+{
+    FScopeLock Lock(&Mutex);
+
+    const int32* Row = RowByKey.Find(Key);
+    if (!Row)
+    {
+        return false;
+    }
+
+    // The stamps decide what eviction keeps, so a hit that advances one must reach the file even if nothing was added.
+    if (LastUsed[*Row] != Session)
+    {
+        LastUsed[*Row] = Session;
+        bDirty = true;
+    }
+    OutEmbedding.SetNumUninitialized(Dimension);
+    FMemory::Memcpy(OutEmbedding.GetData(), Rows.GetData() + static_cast<int64>(*Row) * Dimension, Dimension * sizeof(float));
+    return true;
+}
+
+void FEmbeddingCache::Add(uint64 Key, const TArray<float>& Embedding)
+{
+    FScopeLock Lock(&Mutex);
+
+    if (Embedding.Num() == 0 || RowByKey.Contains(Key))
+    {
+        return;
+    }
+
+    if (Dimension != Embedding.Num())
+    {
+        if (Keys.Num() > 0)
+        {
+            UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | LLM | RAG] Embedding dimension changed from %d to %d, discarding cached embeddings."), Dimension, Embedding.Num());
+        }
+        RowByKey.Reset();
+        Keys.Reset();
+        LastUsed.Reset();
+        Rows.Reset();
+        Dimension = Embedding.Num();
+    }
+
+    RowByKey.Add(Key, Keys.Num());
+    Keys.Add(Key);
+    LastUsed.Add(Session);
+    Rows.Append(Embedding);
+    bDirty = true;
+}
+
+int32 FEmbeddingCache::Num() const
+{
+    FScopeLock Lock(&Mutex);
+    return Keys.Num();
+}
+
+bool FEmbeddingCache::FindQuery(uint64 Key, TArray<float>& OutEmbedding)
+{
+    FScopeLock Lock(&Mutex);
+
+    if (const TArray<float>* Found = QueryCache.FindAndTouch(Key))
+    {
+        OutEmbedding = *Found;
+        return true;
+    }
+    return false;
+}
+
+void FEmbeddingCache::AddQuery(uint64 Key, const TArray<float>& Embedding)
+{
+    FScopeLock Lock(&Mutex);
+
+    if (Embedding.Num() > 0)
+    {
+        QueryCache.Add(Key, Embedding);
+    }
+}
@@ -0,0 +1,411 @@
+#include "HnswIndex.h"
+#include "KnowledgeIndex.h"
+#include "HAL/FileManager.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+    constexpr int32 MaxGraphLevel = 16;
+
+    struct FBestFirst
+    {
+        bool operator()(const FKnowledgeMatch& A, const FKnowledgeMatch& B) const { return A.Score > B.Score; }
+    };
+
+    struct FWorstFirst
+    {
+        bool operator()(const FKnowledgeMatch& A, const FKnowledgeMatch& B) const { return A.Score < B.Score; }
+    };
+}
+
+FHnswIndex::FHnswIndex(const FHnswParams& InParams)
+    : Params(InParams)
+    , Random(0x4C41494E)
+{
+    Params.M = FMath::Max(2, Params.M);
+    Params.EfConstruction = FMath::Max(Params.M, Params.EfConstruction);
+}
+
+int32* FHnswIndex::GetLinks(int32 Node, int32 Level, int32*& OutCount)
+{
+    if (Level == 0)
+    {
+        OutCount = &BaseLinkCounts[Node];
+        return BaseLinks.GetData() + static_cast<SIZE_T>(Node) * GetMaxLinks(0);
+    }
+
+    int32* Block = UpperLinks[Node].GetData() + (Level - 1) * (Params.M + 1);
+    OutCount = Block;
+    return Block + 1;
+}
+
+const int32* FHnswIndex::GetLinks(int32 Node, int32 Level, int32& OutCount) const
+{
+    int32* Count = nullptr;
+    const int32* Links = const_cast<FHnswIndex*>(this)->GetLinks(Node, Level, Count);
+    OutCount = *Count;
+    return Links;
+}
+
+int32 FHnswIndex::RandomLevel()
+{
+    const double LevelMultiplier = 1.0 / FMath::Loge(static_cast<double>(Params.M));
+    const double Uniform = 1.0 - Random.GetFraction();
+    return FMath::Min(MaxGraphLevel, FMath::FloorToInt32(-FMath::Loge(Uniform) * LevelMultiplier));
+}
+
+int32 FHnswIndex::GreedyClosest(const FKnowledgeIndex& Vectors, const float* Query, int32 Entry, int32 FromLevel, int32 ToLevel) const
+{
+    float BestScore = Vectors.ScoreRow(Query, Entry);
+
+    for (int32 Level = FromLevel; Level >= ToLevel; Level--)
+    {
+        bool bImproved = true;
+        while (bImproved)
+        {
+            bImproved = false;
+
+            int32 Count = 0;
+            const int32* Links = GetLinks(Entry, Level, Count);
+            for (int32 i = 0; i < Count; i++)
+            {
+                const float Score = Vectors.ScoreRow(Query, Links[i]);
+                if (Score > BestScore)
+                {
+                    BestScore = Score;
+                    Entry = Links[i];
+                    bImproved = true;
+                }
+            }
+        }
+    }
+
+    return Entry;
+}
+
+void FHnswIndex::SearchLayer(const FKnowledgeIndex& Vectors, const float* Query, int32 Entry, int32 Ef, int32 Level, TArray<FKnowledgeMatch>& OutNearest) const
+{
+    TBitArray<> Visited(false, Levels.Num());
+    TArray<FKnowledgeMatch> Candidates;
+    OutNearest.Reset();
+
+    const FKnowledgeMatch Start{ Entry, Vectors.ScoreRow(Query, Entry) };
+    Visited[Entry] = true;
+    Candidates.HeapPush(Start, FBestFirst());
+    OutNearest.HeapPush(Start, FWorstFirst());
+
+    while (Candidates.Num() > 0)
+    {
+        FKnowledgeMatch Current;
+        Candidates.HeapPop(Current, FBestFirst(), EAllowShrinking::No);
+
+        if (OutNearest.Num() >= Ef && Current.Score < OutNearest.HeapTop().Score)
+        {
+            break;
+        }
+
+        int32 Count = 0;
+        const int32* Links = GetLinks(Current.Index, Level, Count);
+        for (int32 i = 0; i < Count; i++)
+        {
+            const int32 Neighbor = Links[i];
+            if (Visited[Neighbor])
+            {
+                continue;
+            }
+            Visited[Neighbor] = true;
+
+            const float Score = Vectors.ScoreRow(Query, Neighbor);
+            if (OutNearest.Num() < Ef || Score > OutNearest.HeapTop().Score)
+            {
+                Candidates.HeapPush({ Neighbor, Score }, FBestFirst());
+                OutNearest.HeapPush({ Neighbor, Score }, FWorstFirst());
+                if (OutNearest.Num() > Ef)
+                {
+                    OutNearest.HeapPopDiscard(FWorstFirst(), EAllowShrinking::No);
+                }
+            }
+        }
+    }
+}
+
+void FHnswIndex::SelectNeighbors(const FKnowledgeIndex& Vectors, TArray<FKnowledgeMatch>& Candidates, int32 MaxLinks) const
+{
+    Candidates.Sort(FBestFirst());
+    if (Candidates.Num() <= MaxLinks)
+    {
+        return;
+    }
+
+    // Keep a candidate only if it is closer to the base node than to every neighbour already kept, which spreads links
+    // in different directions. Pruned candidates fill any remaining slots.
+    TArray<FKnowledgeMatch> Selected;
+    TArray<FKnowledgeMatch> Pruned;
+    Selected.Reserve(MaxLinks);
+
+    FKnowledgeIndex::FPreparedQuery Scratch;
+    for (const FKnowledgeMatch& Candidate : Candidates)
+    {
+        if (Selected.Num() >= MaxLinks)
+        {
+            break;
+        }
+
+        const float* CandidateRow = Vectors.GetRowQuery(Candidate.Index, Scratch);
+        bool bDiverse = true;
+        for (const FKnowledgeMatch& Kept : Selected)
+        {
+            if (Vectors.ScoreRow(CandidateRow, Kept.Index) > Candidate.Score)
+            {
+                bDiverse = false;
+                break;
+            }
+        }
+
+        if (bDiverse)
+        {
+            Selected.Add(Candidate);
+        }
+        else
+        {
+            Pruned.Add(Candidate);
+        }
+    }
+
+    for (int32 i = 0; i < Pruned.Num() && Selected.Num() < MaxLinks; i++)
+    {
+        Selected.Add(Pruned[i]);
+    }
+
+    Candidates = MoveTemp(Selected);
+}
+
+void FHnswIndex::Connect(const FKnowledgeIndex& Vectors, int32 Node, int32 Neighbor, int32 Level)
+{
+    const int32 MaxLinks = GetMaxLinks(Level);
+
+    int32* Count = nullptr;
+    int32* Links = GetLinks(Node, Level, Count);
+    if (*Count < MaxLinks)
+    {
+        Links[(*Count)++] = Neighbor;
+        return;
+    }
+
+    FKnowledgeIndex::FPreparedQuery Scratch;
+    const float* NodeRow = Vectors.GetRowQuery(Node, Scratch);
+    TArray<FKnowledgeMatch> Candidates;
+    Candidates.Reserve(MaxLinks + 1);
+    for (int32 i = 0; i < *Count; i++)
+    {
+        Candidates.Add({ Links[i], Vectors.ScoreRow(NodeRow, Links[i]) });
+    }
+    Candidates.Add({ Neighbor, Vectors.ScoreRow(NodeRow, Neighbor) });
+
+    SelectNeighbors(Vectors, Candidates, MaxLinks);
+
+    *Count = Candidates.Num();
+    for (int32 i = 0; i < Candidates.Num(); i++)
+    {
+        Links[i] = Candidates[i].Index;
+    }
+}
+
+void FHnswIndex::Insert(const FKnowledgeIndex& Vectors, int32 Row)
+{
+    check(Row == Levels.Num() && Row < Vectors.Num());
+
+    const int32 Level = RandomLevel();
+    Levels.Add(Level);
+    BaseLinks.AddUninitialized(GetMaxLinks(0));
+    BaseLinkCounts.Add(0);
+    UpperLinks.AddDefaulted_GetRef().SetNumZeroed(Level * (Params.M + 1));
+
+    if (EntryPoint < 0)
+    {
+        EntryPoint = Row;
+        MaxLevel = Level;
+        return;
+    }
+
+    FKnowledgeIndex::FPreparedQuery Scratch;
+    const float* Query = Vectors.GetRowQuery(Row, Scratch);
+    int32 Entry = GreedyClosest(Vectors, Query, EntryPoint, MaxLevel, Level + 1);
+
+    TArray<FKnowledgeMatch> Nearest;
+    for (int32 CurrentLevel = FMath::Min(Level, MaxLevel); CurrentLevel >= 0; CurrentLevel--)
+    {
+        SearchLayer(Vectors, Query, Entry, Params.EfConstruction, CurrentLevel, Nearest);
+
+        SelectNeighbors(Vectors, Nearest, Params.M);
+        Entry = Nearest[0].Index;
+
+        for (const FKnowledgeMatch& Neighbor : Nearest)
+        {
+            Connect(Vectors, Row, Neighbor.Index, CurrentLevel);
+            Connect(Vectors, Neighbor.Index, Row, CurrentLevel);
+        }
+    }
+
+    if (Level > MaxLevel)
+    {
+        EntryPoint = Row;
+        MaxLevel = Level;
+    }
+}
+
+void FHnswIndex::Search(const FKnowledgeIndex& Vectors, const float* Query, int32 K, int32 EfSearch, float MinScore, TArray<FKnowledgeMatch>& OutMatches) const
+{
+    OutMatches.Reset();
+
+    if (EntryPoint < 0 || K <= 0)
+    {
+        return;
+    }
+
+    const int32 Entry = GreedyClosest(Vectors, Query, EntryPoint, MaxLevel, 1);
+    SearchLayer(Vectors, Query, Entry, FMath::Max(EfSearch, K), 0, OutMatches);
+
+    OutMatches.RemoveAllSwap([MinScore](const FKnowledgeMatch& Match)
+        {
+            return Match.Score < MinScore;
+        }, EAllowShrinking::No);
+    OutMatches.Sort(FBestFirst());
+    if (OutMatches.Num() > K)
+    {
+        OutMatches.SetNum(K, EAllowShrinking::No);
+    }
+}
+
+bool FHnswIndex::Save(const FString& FilePath, uint64 ContentKey) const
+{
+    IFileManager::Get().MakeDirectory(*FPaths::GetPath(FilePath), true);
+
+    TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*FilePath));
+    if (!Writer)
+    {
+        return false;
+    }
+
+    uint32 Magic = FileMagic;
+    uint32 Version = FileVersion;
+    int32 M = Params.M;
+    int32 EfConstruction = Params.EfConstruction;
+    int32 NumNodes = Levels.Num();
+    int32 Entry = EntryPoint;
+    int32 TopLevel = MaxLevel;
+    *Writer << Magic << Version << ContentKey << M << EfConstruction << NumNodes << Entry << TopLevel;
+
+    Writer->Serialize(const_cast<int32*>(Levels.GetData()), Levels.Num() * sizeof(int32));
+    Writer->Serialize(const_cast<int32*>(BaseLinkCounts.GetData()), BaseLinkCounts.Num() * sizeof(int32));
+    Writer->Serialize(const_cast<int32*>(BaseLinks.GetData()), BaseLinks.Num() * sizeof(int32));
+    for (const TArray<int32>& Links : UpperLinks)
+    {
+        Writer->Serialize(const_cast<int32*>(Links.GetData()), Links.Num() * sizeof(int32));
+    }
+
+    return Writer->Close();
+}
+
+bool FHnswIndex::Load(const FString& FilePath, uint64 ContentKey, int32 ExpectedNodes)
+{
+    TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*FilePath));
+    if (!Reader)
+    {
+        return false;
+    }
+
+    uint32 Magic = 0;
+    uint32 Version = 0;
+    uint64 FileKey = 0;
+    int32 M = 0;
+    int32 EfConstruction = 0;
+    int32 NumNodes = 0;
+    int32 Entry = -1;
+    int32 TopLevel = -1;
+    *Reader << Magic << Version << FileKey << M << EfConstruction << NumNodes << Entry << TopLevel;
+
+    if (Reader->IsError() || Magic != FileMagic || Version != FileVersion || FileKey != ContentKey
+        || M != Params.M || EfConstruction != Params.EfConstruction || NumNodes != ExpectedNodes)
+    {
+        return false;
+    }
+
+    TArray<int32> NewLevels;
+    TArray<int32> NewCounts;
+    TArray<int32> NewLinks;
+    TArray<TArray<int32>> NewUpper;
+    NewLevels.SetNumUninitialized(NumNodes);
+    NewCounts.SetNumUninitialized(NumNodes);
+    NewLinks.SetNumUninitialized(NumNodes * GetMaxLinks(0));
+    Reader->Serialize(NewLevels.GetData(), NewLevels.Num() * sizeof(int32));
+    Reader->Serialize(NewCounts.GetData(), NewCounts.Num() * sizeof(int32));
+    Reader->Serialize(NewLinks.GetData(), NewLinks.Num() * sizeof(int32));
+
+    NewUpper.SetNum(NumNodes);
+    for (int32 Node = 0; Node < NumNodes; Node++)
+    {
+        if (NewLevels[Node] < 0 || NewLevels[Node] > MaxGraphLevel)
+        {
+            return false;
+        }
+        NewUpper[Node].SetNumUninitialized(NewLevels[Node] * (Params.M + 1));
+        Reader->Serialize(NewUpper[Node].GetData(), NewUpper[Node].Num() * sizeof(int32));
+    }
+
+    if (Reader->IsError())
+    {
+        return false;
+    }
+
+    // The file is trusted no further than its header: every link must name a node that exists on the link's layer,
+    // or a search would read out of bounds.
+    const auto AreLinksValid = [&NewLevels, NumNodes](const int32* Links, int32 Count, int32 MaxCount, int32 Level)
+        {
+            if (Count < 0 || Count > MaxCount)
+            {
+                return false;
+            }
+            for (int32 i = 0; i < Count; i++)
+            {
+                if (Links[i] < 0 || Links[i] >= NumNodes || NewLevels[Links[i]] < Level)
+                {
+                    return false;
+                }
+            }
+            return true;
+        };
+
+    int32 HighestLevel = -1;
+    for (int32 Node = 0; Node < NumNodes; Node++)
+    {
+        HighestLevel = FMath::Max(HighestLevel, NewLevels[Node]);
+
+        if (!AreLinksValid(NewLinks.GetData() + static_cast<SIZE_T>(Node) * GetMaxLinks(0), NewCounts[Node], GetMaxLinks(0), 0))
+        {
+            return false;
+        }
+        for (int32 Level = 1; Level <= NewLevels[Node]; Level++)
+        {
+            const int32* Block = NewUpper[Node].GetData() + (Level - 1) * (Params.M + 1);
+            if (!AreLinksValid(Block + 1, Block[0], Params.M, Level))
+            {
+                return false;
+            }
+        }
+    }
+
+    // Searches start at the entry point on the top layer, so it must be a node that reaches that layer.
+    if (TopLevel != HighestLevel || (NumNodes > 0 ? (Entry < 0 || Entry >= NumNodes || NewLevels[Entry] != TopLevel) : Entry != -1))
+    {
+        return false;
+    }
+
+    Levels = MoveTemp(NewLevels);
+    BaseLinkCounts = MoveTemp(NewCounts);
+    BaseLinks = MoveTemp(NewLinks);
+    UpperLinks = MoveTemp(NewUpper);
+    EntryPoint = Entry;
+    MaxLevel = TopLevel;
+    return true;
+}
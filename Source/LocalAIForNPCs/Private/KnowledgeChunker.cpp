@@ -0,0 +1,305 @@
+#include "KnowledgeChunker.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Async/ParallelFor.h"
+
+namespace
+{
+    /**
+     * Length at which a sentence is cut at the next whitespace, so text without terminators cannot grow one sentence
+     * without bound. Text without whitespace either is cut hard at twice this length.
+     */
+    constexpr int32 MaxSentenceLength = 4096;
+
+    bool IsSentenceTerminator(TCHAR c)
+    {
+        return c == '.' || c == '!' || c == '?';
+    }
+
+    bool IsSentenceBreak(TCHAR c)
+    {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+    }
+
+    /** Number of bytes at the end of Data that start a UTF-8 sequence not yet complete. */
+    int32 GetIncompleteUtf8Tail(const uint8* Data, int32 NumBytes)
+    {
+        for (int32 Back = 1; Back <= 3 && Back <= NumBytes; Back++)
+        {
+            const uint8 Byte = Data[NumBytes - Back];
+            if ((Byte & 0xC0) == 0x80)
+            {
+                continue;
+            }
+
+            int32 SequenceLength = 1;
+            if ((Byte & 0xE0) == 0xC0)
+            {
+                SequenceLength = 2;
+            }
+            else if ((Byte & 0xF0) == 0xE0)
+            {
+                SequenceLength = 3;
+            }
+            else if ((Byte & 0xF8) == 0xF0)
+            {
+                SequenceLength = 4;
+            }
+            return SequenceLength > Back ? Back : 0;
+        }
+        return 0;
+    }
+
+    /** Collects sentences as text arrives and emits a chunk whenever a sliding window of sentences is complete. */
+    class FSentenceWindow
+    {
+    public:
+        FSentenceWindow(int32 InSentencesPerChunk, int32 InStep, TArray<FString>& InChunks)
+            : SentencesPerChunk(InSentencesPerChunk)
+            , Step(InStep)
+            , Chunks(InChunks)
+        {
+        }
+
+        void Feed(const TCHAR* Text, int32 Len)
+        {
+            int32 SpanStart = 0;
+            for (int32 i = 0; i < Len; i++)
+            {
+                const int32 PendingLength = Sentence.Len() + i - SpanStart;
+                const bool bTooLong = PendingLength >= MaxSentenceLength
+                    && (IsSentenceBreak(Text[i]) || PendingLength >= MaxSentenceLength * 2)
+                    && !(Text[i] >= 0xDC00 && Text[i] <= 0xDFFF);
+
+                if ((bAfterTerminator && IsSentenceBreak(Text[i])) || bTooLong)
+                {
+                    Sentence.Append(Text + SpanStart, i - SpanStart);
+                    SpanStart = i;
+                    EndSentence();
+                }
+                bAfterTerminator = IsSentenceTerminator(Text[i]);
+            }
+            Sentence.Append(Text + SpanStart, Len - SpanStart);
+        }
+
+        void Finish()
+        {
+            EndSentence();
+
+            // Chunks starting in the last window that did not fill up are emitted with the sentences available.
+            const int32 FirstPending = FMath::Max(0, NumSentences - SentencesPerChunk + 1);
+            for (int32 Start = (FirstPending + Step - 1) / Step * Step; Start < NumSentences; Start += Step)
+            {
+                EmitChunk(Start, NumSentences);
+            }
+        }
+
+    private:
+        void EndSentence()
+        {
+            bAfterTerminator = false;
+
+            Sentence.TrimStartAndEndInline();
+            if (Sentence.IsEmpty())
+            {
+                return;
+            }
+
+            if (Window.Num() == SentencesPerChunk)
+            {
+                Window.RemoveAt(0, 1, EAllowShrinking::No);
+            }
+            Window.Add(MoveTemp(Sentence));
+            Sentence.Reset();
+            NumSentences++;
+
+            const int32 Start = NumSentences - SentencesPerChunk;
+            if (Start >= 0 && Start % Step == 0)
+            {
+                EmitChunk(Start, NumSentences);
+            }
+        }
+
+        /** Joins sentences [Start, End); the window holds the last Window.Num() sentences. */
+        void EmitChunk(int32 Start, int32 End)
+        {
+            const int32 WindowStart = NumSentences - Window.Num();
+
+            int32 Length = 0;
+            for (int32 i = Start; i < End; i++)
+            {
+                Length += Window[i - WindowStart].Len() + 1;
+            }
+
+            FString Chunk;
+            Chunk.Reserve(Length);
+            for (int32 i = Start; i < End; i++)
+            {
+                if (!Chunk.IsEmpty())
+                {
+                    Chunk.AppendChar(' ');
+                }
+                Chunk.Append(Window[i - WindowStart]);
+            }
+            Chunks.Add(MoveTemp(Chunk));
+        }
+
+        int32 SentencesPerChunk;
+        int32 Step;
+        TArray<FString>& Chunks;
+
+        TArray<FString> Window;
+        FString Sentence;
+        int32 NumSentences = 0;
+        bool bAfterTerminator = false;
+    };
+}
+
+FKnowledgeChunker::FKnowledgeChunker(int32 InSentencesPerChunk, int32 InSentenceOverlap)
+    : SentencesPerChunk(FMath::Max(1, InSentencesPerChunk))
+    , Step(FMath::Max(1, InSentencesPerChunk - InSentenceOverlap))
+{
+}
+
+TArray<FString> FKnowledgeChunker::FindKnowledgeFiles(const FString& KnowledgePath)
+{
+    TArray<FString> Files;
+
+    TArray<FString> Entries;
+    KnowledgePath.ParseIntoArray(Entries, TEXT(";"), true);
+
+    IFileManager& FileManager = IFileManager::Get();
+    for (FString& Entry : Entries)
+    {
+        Entry.TrimStartAndEndInline();
+        if (Entry.IsEmpty())
+        {
+            continue;
+        }
+
+        if (Entry.Contains(TEXT("*")) || Entry.Contains(TEXT("?")))
+        {
+            const FString Directory = FPaths::GetPath(Entry);
+            TArray<FString> Found;
+            FileManager.FindFiles(Found, *Entry, true, false);
+            for (const FString& Name : Found)
+            {
+                Files.Add(FPaths::Combine(Directory, Name));
+            }
+        }
+        else if (FileManager.DirectoryExists(*Entry))
+        {
+            TArray<FString> Found;
+            FileManager.FindFilesRecursive(Found, *Entry, TEXT("*.txt"), true, false);
+            FileManager.FindFilesRecursive(Found, *Entry, TEXT("*.md"), true, false, false);
+            Files.Append(Found);
+        }
+        else
+        {
+            Files.Add(Entry);
+        }
+    }
+
+    // A stable order keeps chunk order, and with it the embedding and index caches, identical between runs.
+    Files.Sort();
+    return Files;
+}
+
+TArray<FString> FKnowledgeChunker::ChunkFiles(const TArray<FString>& Files) const
+{
+    TArray<TArray<FString>> FileChunks;
+    FileChunks.SetNum(Files.Num());
+
+    ParallelFor(Files.Num(), [this, &Files, &FileChunks](int32 Index)
+        {
+            if (!ChunkFile(Files[Index], FileChunks[Index]))
+            {
+                UE_LOG(LogTemp, Error, TEXT("[LocalAIForNPCs | LLM | RAG] Failed to read document: %s"), *Files[Index]);
+            }
+        });
+
+    int32 NumChunks = 0;
+    for (const TArray<FString>& Chunks : FileChunks)
+    {
+        NumChunks += Chunks.Num();
+    }
+
+    TArray<FString> Result;
+    Result.Reserve(NumChunks);
+    for (TArray<FString>& Chunks : FileChunks)
+    {
+        for (FString& Chunk : Chunks)
+        {
+            Result.Add(MoveTemp(Chunk));
+        }
+    }
+    return Result;
+}
+
+bool FKnowledgeChunker::ChunkFile(const FString& FilePath, TArray<FString>& OutChunks) const
+{
+    TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*FilePath));
+    if (!Reader)
+    {
+        return false;
+    }
+
+    FSentenceWindow Window(SentencesPerChunk, Step, OutChunks);
+
+    const int64 TotalSize = Reader->TotalSize();
+    TArray<uint8> Block;
+    Block.SetNumUninitialized(BlockSize + 4);
+    int32 Carry = 0;
+    bool bFirstBlock = true;
+
+    for (int64 Offset = 0; Offset < TotalSize;)
+    {
+        const int32 ReadSize = static_cast<int32>(FMath::Min<int64>(BlockSize, TotalSize - Offset));
+        Reader->Serialize(Block.GetData() + Carry, ReadSize);
+        if (Reader->IsError())
+        {
+            return false;
+        }
+        Offset += ReadSize;
+
+        int32 Begin = 0;
+        int32 Available = Carry + ReadSize;
+        if (bFirstBlock)
+        {
+            bFirstBlock = false;
+
+            // UTF-16 files are rare for lore text; read them whole rather than streaming.
+            if (Available >= 2 && ((Block[0] == 0xFF && Block[1] == 0xFE) || (Block[0] == 0xFE && Block[1] == 0xFF)))
+            {
+                Reader.Reset();
+                FString Content;
+                if (!FFileHelper::LoadFileToString(Content, *FilePath))
+                {
+                    return false;
+                }
+                Window.Feed(*Content, Content.Len());
+                Window.Finish();
+                return true;
+            }
+
+            if (Available >= 3 && Block[0] == 0xEF && Block[1] == 0xBB && Block[2] == 0xBF)
+            {
+                Begin = 3;
+            }
+        }
+
+        // Hold back a multi-byte character split across blocks until the rest of it arrives.
+        const int32 Tail = Offset < TotalSize ? GetIncompleteUtf8Tail(Block.GetData() + Begin, Available - Begin) : 0;
+        const int32 Complete = Available - Begin - Tail;
+
+        const FUTF8ToTCHAR Converted(reinterpret_cast<const ANSICHAR*>(Block.GetData() + Begin), Complete);
+        Window.Feed(Converted.Get(), Converted.Length());
+
+        FMemory::Memmove(Block.GetData(), Block.GetData() + Available - Tail, Tail);
+        Carry = Tail;
+    }
+
+    Window.Finish();
+    return true;
+}
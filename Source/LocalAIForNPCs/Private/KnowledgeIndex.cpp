@@ -0,0 +1,611 @@
+#include "KnowledgeIndex.h"
+#include "Math/VectorRegister.h"
+#include "Hash/xxhash.h"
+
+namespace
+{
+    constexpr uint32 RowAlignment = 16;
+
+    auto WorstFirst = [](const FKnowledgeMatch& A, const FKnowledgeMatch& B)
+        {
+            return A.Score < B.Score;
+        };
+
+    auto BestFirst = [](const FKnowledgeMatch& A, const FKnowledgeMatch& B)
+        {
+            return A.Score > B.Score;
+        };
+
+    /** Keeps the K best matches in a min-heap whose top is the weakest kept match. */
+    FORCEINLINE void PushTopK(TArray<FKnowledgeMatch>& Heap, int32 K, int32 Index, float Score)
+    {
+        if (Heap.Num() < K)
+        {
+            Heap.HeapPush({ Index, Score }, WorstFirst);
+        }
+        else if (Score > Heap.HeapTop().Score)
+        {
+            Heap.HeapPopDiscard(WorstFirst, EAllowShrinking::No);
+            Heap.HeapPush({ Index, Score }, WorstFirst);
+        }
+    }
+
+    int32 DotInt8(const int8* RESTRICT A, const int8* RESTRICT B, int32 Num)
+    {
+        int32 Sum = 0;
+        for (int32 i = 0; i < Num; i++)
+        {
+            Sum += static_cast<int32>(A[i]) * static_cast<int32>(B[i]);
+        }
+        return Sum;
+    }
+
+    int32 HammingDistance(const uint64* RESTRICT A, const uint64* RESTRICT B, int32 NumWords)
+    {
+        int32 Distance = 0;
+        for (int32 i = 0; i < NumWords; i++)
+        {
+            Distance += static_cast<int32>(FPlatformMath::CountBits(A[i] ^ B[i]));
+        }
+        return Distance;
+    }
+
+    float QuantizeInt8(const float* Values, int32 Num, int8* Out)
+    {
+        float MaxAbs = 0.0f;
+        for (int32 i = 0; i < Num; i++)
+        {
+            MaxAbs = FMath::Max(MaxAbs, FMath::Abs(Values[i]));
+        }
+
+        const float Scale = MaxAbs > 0.0f ? MaxAbs / 127.0f : 1.0f;
+        const float InvScale = 1.0f / Scale;
+        for (int32 i = 0; i < Num; i++)
+        {
+            Out[i] = static_cast<int8>(FMath::Clamp(FMath::RoundToInt32(Values[i] * InvScale), -127, 127));
+        }
+        return Scale;
+    }
+
+    void QuantizeBinary(const float* Values, int32 Num, uint64* Out)
+    {
+        for (int32 Word = 0; Word * 64 < Num; Word++)
+        {
+            uint64 Bits = 0;
+            const int32 End = FMath::Min(64, Num - Word * 64);
+            for (int32 Bit = 0; Bit < End; Bit++)
+            {
+                Bits |= static_cast<uint64>(Values[Word * 64 + Bit] > 0.0f) << Bit;
+            }
+            Out[Word] = Bits;
+        }
+    }
+}
+
+FKnowledgeIndex::FKnowledgeIndex(EEmbeddingStorage InStorage)
+    : Storage(InStorage)
+{
+}
+
+FKnowledgeIndex::~FKnowledgeIndex()
+{
+    FMemory::Free(Rows);
+}
+
+void FKnowledgeIndex::SetDimension(int32 InDimension)
+{
+    Dimension = InDimension;
+    Stride = GetStride(InDimension);
+    WordsPerRow = (InDimension + 63) / 64;
+    Capacity = 0;
+}
+
+void FKnowledgeIndex::Reserve(int32 InDimension, int32 InNumRows)
+{
+    if (NumRows == 0 && Dimension != InDimension)
+    {
+        SetDimension(InDimension);
+    }
+
+    switch (Storage)
+    {
+    case EEmbeddingStorage::Float:
+        if (InNumRows > Capacity)
+        {
+            Grow(InNumRows);
+        }
+        break;
+    case EEmbeddingStorage::Int8:
+        Int8Rows.Reserve(InNumRows * Stride);
+        RowScales.Reserve(InNumRows);
+        break;
+    case EEmbeddingStorage::Binary:
+        BinaryRows.Reserve(InNumRows * WordsPerRow);
+        RowScales.Reserve(InNumRows);
+        break;
+    }
+    TextOffsets.Reserve(InNumRows + 1);
+}
+
+void FKnowledgeIndex::Grow(int32 NewCapacity)
+{
+    Rows = static_cast<float*>(FMemory::Realloc(Rows, static_cast<SIZE_T>(NewCapacity) * Stride * sizeof(float), RowAlignment));
+    Capacity = NewCapacity;
+}
+
+bool FKnowledgeIndex::Add(const FString& Text, const TArray<float>& Embedding)
+{
+    if (Embedding.Num() == 0)
+    {
+        return false;
+    }
+
+    if (NumRows == 0 && Dimension != Embedding.Num())
+    {
+        SetDimension(Embedding.Num());
+    }
+
+    if (Embedding.Num() != Dimension)
+    {
+        return false;
+    }
+
+    FPreparedQuery Normalized;
+    if (!PrepareQuery(Embedding, Normalized))
+    {
+        return false;
+    }
+
+    EncodeRow(Normalized.GetData());
+    AddText(Text);
+    return true;
+}
+
+void FKnowledgeIndex::AddText(const FString& Text)
+{
+    if (TextOffsets.Num() == 0)
+    {
+        TextOffsets.Add(0);
+    }
+    TextPool.Append(*Text, Text.Len());
+    TextOffsets.Add(TextPool.Num());
+
+    NumRows++;
+}
+
+void FKnowledgeIndex::EncodeRow(const float* Normalized)
+{
+    switch (Storage)
+    {
+    case EEmbeddingStorage::Float:
+        if (NumRows == Capacity)
+        {
+            Grow(FMath::Max(16, Capacity * 2));
+        }
+        FMemory::Memcpy(Rows + static_cast<SIZE_T>(NumRows) * Stride, Normalized, Stride * sizeof(float));
+        break;
+    case EEmbeddingStorage::Int8:
+        Int8Rows.AddZeroed(Stride);
+        RowScales.Add(QuantizeInt8(Normalized, Dimension, Int8Rows.GetData() + static_cast<SIZE_T>(NumRows) * Stride));
+        break;
+    case EEmbeddingStorage::Binary:
+    {
+        BinaryRows.AddUninitialized(WordsPerRow);
+        QuantizeBinary(Normalized, Dimension, BinaryRows.GetData() + static_cast<SIZE_T>(NumRows) * WordsPerRow);
+
+        // Scale the sign vector so its dot product with the original row is 1, which keeps rescored similarities on
+        // the same scale as float cosine similarity and SimilarityThreshold meaningful.
+        float SumAbs = 0.0f;
+        for (int32 i = 0; i < Dimension; i++)
+        {
+            SumAbs += FMath::Abs(Normalized[i]);
+        }
+        RowScales.Add(1.0f / SumAbs);
+        break;
+    }
+    }
+}
+
+SIZE_T FKnowledgeIndex::GetVectorBytes() const
+{
+    switch (Storage)
+    {
+    case EEmbeddingStorage::Int8:
+        return Int8Rows.GetAllocatedSize() + RowScales.GetAllocatedSize();
+    case EEmbeddingStorage::Binary:
+        return BinaryRows.GetAllocatedSize() + RowScales.GetAllocatedSize();
+    default:
+        return static_cast<SIZE_T>(Capacity) * Stride * sizeof(float);
+    }
+}
+
+const float* FKnowledgeIndex::GetRowQuery(int32 Index, FPreparedQuery& Scratch) const
+{
+    switch (Storage)
+    {
+    case EEmbeddingStorage::Int8:
+    {
+        Scratch.SetNumUninitialized(Stride, EAllowShrinking::No);
+        const int8* Row = Int8Rows.GetData() + static_cast<SIZE_T>(Index) * Stride;
+        const float Scale = RowScales[Index];
+        for (int32 i = 0; i < Stride; i++)
+        {
+            Scratch[i] = Row[i] * Scale;
+        }
+        return Scratch.GetData();
+    }
+    case EEmbeddingStorage::Binary:
+    {
+        Scratch.SetNumZeroed(Stride, EAllowShrinking::No);
+        const uint64* Row = BinaryRows.GetData() + static_cast<SIZE_T>(Index) * WordsPerRow;
+        const float Magnitude = RowScales[Index];
+        for (int32 i = 0; i < Dimension; i++)
+        {
+            Scratch[i] = (Row[i >> 6] >> (i & 63)) & 1 ? Magnitude : -Magnitude;
+        }
+        return Scratch.GetData();
+    }
+    default:
+        return Rows + static_cast<SIZE_T>(Index) * Stride;
+    }
+}
+
+float FKnowledgeIndex::ScoreRow(const float* PreparedQuery, int32 Index) const
+{
+    switch (Storage)
+    {
+    case EEmbeddingStorage::Int8:
+    {
+        const int8* Row = Int8Rows.GetData() + static_cast<SIZE_T>(Index) * Stride;
+        float Sum = 0.0f;
+        for (int32 i = 0; i < Dimension; i++)
+        {
+            Sum += PreparedQuery[i] * Row[i];
+        }
+        return Sum * RowScales[Index];
+    }
+    case EEmbeddingStorage::Binary:
+    {
+        // Dequantized rows are +-RowScales[Index] per component.
+        const uint64* Row = BinaryRows.GetData() + static_cast<SIZE_T>(Index) * WordsPerRow;
+        float Positive = 0.0f;
+        float Total = 0.0f;
+        for (int32 i = 0; i < Dimension; i++)
+        {
+            Total += PreparedQuery[i];
+            Positive += (Row[i >> 6] >> (i & 63)) & 1 ? PreparedQuery[i] : 0.0f;
+        }
+        return (2.0f * Positive - Total) * RowScales[Index];
+    }
+    default:
+        return Dot(PreparedQuery, Rows + static_cast<SIZE_T>(Index) * Stride, Stride);
+    }
+}
+
+FStringView FKnowledgeIndex::GetText(int32 Index) const
+{
+    check(Index >= 0 && Index < NumRows);
+    return FStringView(TextPool.GetData() + TextOffsets[Index], TextOffsets[Index + 1] - TextOffsets[Index]);
+}
+
+float FKnowledgeIndex::Dot(const float* RESTRICT A, const float* RESTRICT B, int32 InStride)
+{
+    VectorRegister4Float Sum0 = VectorZeroFloat();
+    VectorRegister4Float Sum1 = VectorZeroFloat();
+
+    int32 i = 0;
+    for (; i + 8 <= InStride; i += 8)
+    {
+        Sum0 = VectorMultiplyAdd(VectorLoadAligned(A + i), VectorLoadAligned(B + i), Sum0);
+        Sum1 = VectorMultiplyAdd(VectorLoadAligned(A + i + 4), VectorLoadAligned(B + i + 4), Sum1);
+    }
+    if (i < InStride)
+    {
+        Sum0 = VectorMultiplyAdd(VectorLoadAligned(A + i), VectorLoadAligned(B + i), Sum0);
+    }
+
+    alignas(16) float Lanes[4];
+    VectorStoreAligned(VectorAdd(Sum0, Sum1), Lanes);
+    return (Lanes[0] + Lanes[1]) + (Lanes[2] + Lanes[3]);
+}
+
+bool FKnowledgeIndex::PrepareQuery(const TArray<float>& Query, FPreparedQuery& OutPrepared) const
+{
+    if (Query.Num() != Dimension)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | LLM | RAG] Query embedding has %d dimensions, knowledge has %d."), Query.Num(), Dimension);
+        return false;
+    }
+
+    double SquaredNorm = 0.0;
+    for (float Value : Query)
+    {
+        SquaredNorm += static_cast<double>(Value) * Value;
+    }
+    if (SquaredNorm <= UE_SMALL_NUMBER)
+    {
+        return false;
+    }
+
+    OutPrepared.SetNumZeroed(Stride);
+    const float InvNorm = static_cast<float>(1.0 / FMath::Sqrt(SquaredNorm));
+    for (int32 i = 0; i < Dimension; i++)
+    {
+        OutPrepared[i] = Query[i] * InvNorm;
+    }
+    return true;
+}
+
+void FKnowledgeIndex::Search(const TArray<float>& Query, int32 K, float MinScore, TArray<FKnowledgeMatch>& OutMatches, int32 EfSearch, int32 RescoreFactor) const
+{
+    OutMatches.Reset();
+
+    FPreparedQuery Prepared;
+    if (NumRows == 0 || K <= 0 || !PrepareQuery(Query, Prepared))
+    {
+        return;
+    }
+
+    SearchPrepared(Prepared.GetData(), K, MinScore, OutMatches, EfSearch, RescoreFactor);
+}
+
+void FKnowledgeIndex::SearchPrepared(const float* PreparedQuery, int32 K, float MinScore, TArray<FKnowledgeMatch>& OutMatches, int32 EfSearch, int32 RescoreFactor) const
+{
+    if (Graph.IsValid())
+    {
+        Graph->Search(*this, PreparedQuery, K, EfSearch, MinScore, OutMatches);
+    }
+    else
+    {
+        SearchExact(PreparedQuery, K, MinScore, OutMatches, RescoreFactor);
+    }
+}
+
+void FKnowledgeIndex::BuildLexicalIndex()
+{
+    Lexical = MakeUnique<FLexicalIndex>();
+    for (int32 Row = 0; Row < NumRows; Row++)
+    {
+        Lexical->Add(GetText(Row));
+    }
+    Lexical->Finalize();
+}
+
+void FKnowledgeIndex::SearchLexical(FStringView Query, int32 K, float MinScore, TArray<FKnowledgeMatch>& OutMatches) const
+{
+    OutMatches.Reset();
+
+    if (Lexical.IsValid())
+    {
+        Lexical->Search(Query, K, MinScore, OutMatches);
+    }
+}
+
+void FKnowledgeIndex::SearchHybrid(const TArray<float>& QueryEmbedding, FStringView QueryText, int32 K, float LexicalWeight, float MinSimilarity, float MinLexicalScore, TArray<FKnowledgeMatch>& OutMatches, int32 EfSearch, int32 RescoreFactor) const
+{
+    OutMatches.Reset();
+
+    if (NumRows == 0 || K <= 0)
+    {
+        return;
+    }
+
+    // Pull a few more candidates than needed from each side, since fusion can reorder them.
+    const int32 NumCandidates = K * 4;
+    LexicalWeight = FMath::Clamp(LexicalWeight, 0.0f, 1.0f);
+
+    FPreparedQuery Prepared;
+    const bool bHasQueryVector = HasVectors() && PrepareQuery(QueryEmbedding, Prepared);
+
+    TArray<FKnowledgeMatch> VectorMatches;
+    if (bHasQueryVector)
+    {
+        SearchPrepared(Prepared.GetData(), NumCandidates, -1.0f, VectorMatches, EfSearch, RescoreFactor);
+    }
+
+    TArray<FKnowledgeMatch> LexicalMatches;
+    SearchLexical(QueryText, NumCandidates, 0.0f, LexicalMatches);
+
+    // Lexical scores are on a fixed scale, so each side is held to its own threshold: a chunk is relevant if it is
+    // semantically close or matches the query's words well, and the weights only decide the order.
+    TMap<int32, float> LexicalScores;
+    LexicalScores.Reserve(LexicalMatches.Num());
+    for (const FKnowledgeMatch& Match : LexicalMatches)
+    {
+        LexicalScores.Add(Match.Index, Match.Score);
+    }
+
+    auto AddFused = [&](int32 Index, float VectorScore)
+        {
+            const float* Found = LexicalScores.Find(Index);
+            const float LexicalScore = Found ? *Found : 0.0f;
+            if (VectorScore < MinSimilarity && LexicalScore < MinLexicalScore)
+            {
+                return;
+            }
+            PushTopK(OutMatches, K, Index, (1.0f - LexicalWeight) * FMath::Max(0.0f, VectorScore) + LexicalWeight * LexicalScore);
+        };
+
+    for (const FKnowledgeMatch& Match : VectorMatches)
+    {
+        AddFused(Match.Index, Match.Score);
+        LexicalScores.Remove(Match.Index);
+    }
+
+    // Lexical hits the vector search missed are scored exactly against the query vector.
+    for (const FKnowledgeMatch& Match : LexicalMatches)
+    {
+        if (LexicalScores.Contains(Match.Index))
+        {
+            AddFused(Match.Index, bHasQueryVector ? ScoreRow(Prepared.GetData(), Match.Index) : 0.0f);
+        }
+    }
+
+    OutMatches.Sort(BestFirst);
+}
+
+void FKnowledgeIndex::SearchExact(const float* PreparedQuery, int32 K, float MinScore, TArray<FKnowledgeMatch>& OutMatches, int32 RescoreFactor) const
+{
+    OutMatches.Reset();
+
+    if (NumRows == 0 || K <= 0)
+    {
+        return;
+    }
+
+    if (Storage != EEmbeddingStorage::Float)
+    {
+        SearchQuantized(PreparedQuery, K, MinScore, OutMatches, RescoreFactor);
+        return;
+    }
+
+    OutMatches.Reserve(K);
+    const float* Row = Rows;
+    for (int32 RowIndex = 0; RowIndex < NumRows; RowIndex++, Row += Stride)
+    {
+        const float Score = Dot(PreparedQuery, Row, Stride);
+        if (Score >= MinScore)
+        {
+            PushTopK(OutMatches, K, RowIndex, Score);
+        }
+    }
+
+    OutMatches.Sort(BestFirst);
+}
+
+void FKnowledgeIndex::SearchQuantized(const float* PreparedQuery, int32 K, float MinScore, TArray<FKnowledgeMatch>& OutMatches, int32 RescoreFactor) const
+{
+    // First pass: rank every row by a cheap score against the quantized query. The scores are only used for
+    // ordering, so the similarity threshold is applied after rescoring.
+    const int32 NumCandidates = FMath::Min(NumRows, K * FMath::Max(1, RescoreFactor));
+    TArray<FKnowledgeMatch> Candidates;
+    Candidates.Reserve(NumCandidates);
+
+    if (Storage == EEmbeddingStorage::Int8)
+    {
+        TArray<int8> QueryCodes;
+        QueryCodes.SetNumZeroed(Stride);
+        QuantizeInt8(PreparedQuery, Dimension, QueryCodes.GetData());
+
+        const int8* Row = Int8Rows.GetData();
+        for (int32 RowIndex = 0; RowIndex < NumRows; RowIndex++, Row += Stride)
+        {
+            PushTopK(Candidates, NumCandidates, RowIndex, DotInt8(QueryCodes.GetData(), Row, Stride) * RowScales[RowIndex]);
+        }
+    }
+    else
+    {
+        TArray<uint64> QueryBits;
+        QueryBits.SetNumUninitialized(WordsPerRow);
+        QuantizeBinary(PreparedQuery, Dimension, QueryBits.GetData());
+
+        const uint64* Row = BinaryRows.GetData();
+        for (int32 RowIndex = 0; RowIndex < NumRows; RowIndex++, Row += WordsPerRow)
+        {
+            PushTopK(Candidates, NumCandidates, RowIndex, -static_cast<float>(HammingDistance(QueryBits.GetData(), Row, WordsPerRow)));
+        }
+    }
+
+    // Second pass: rescore the candidates with the float query against their dequantized rows. This is not an exact
+    // rescore; only the query is full precision.
+    OutMatches.Reserve(K);
+    for (const FKnowledgeMatch& Candidate : Candidates)
+    {
+        const float Score = ScoreRow(PreparedQuery, Candidate.Index);
+        if (Score >= MinScore)
+        {
+            PushTopK(OutMatches, K, Candidate.Index, Score);
+        }
+    }
+
+    OutMatches.Sort(BestFirst);
+}
+
+void FKnowledgeIndex::BuildGraph(const FHnswParams& Params)
+{
+    if (!Graph.IsValid())
+    {
+        Graph = MakeUnique<FHnswIndex>(Params);
+    }
+
+    for (int32 Row = Graph->Num(); Row < NumRows; Row++)
+    {
+        Graph->Insert(*this, Row);
+    }
+}
+
+bool FKnowledgeIndex::SaveGraph(const FString& FilePath) const
+{
+    return Graph.IsValid() && Graph->Save(FilePath, GetContentKey());
+}
+
+bool FKnowledgeIndex::LoadGraph(const FString& FilePath, const FHnswParams& Params)
+{
+    TUniquePtr<FHnswIndex> Loaded = MakeUnique<FHnswIndex>(Params);
+    if (!Loaded->Load(FilePath, GetContentKey(), NumRows))
+    {
+        return false;
+    }
+
+    Graph = MoveTemp(Loaded);
+    return true;
+}
+
+float FKnowledgeIndex::MeasureGraphRecall(int32 K, int32 NumQueries, int32 EfSearch) const
+{
+    if (!Graph.IsValid() || NumRows == 0 || K <= 0)
+    {
+        return 0.0f;
+    }
+
+    NumQueries = FMath::Min(NumQueries, NumRows);
+    const int32 QueryStep = FMath::Max(1, NumRows / FMath::Max(1, NumQueries));
+
+    // A row used as its own query is an exact match and overstates recall. Real queries only resemble a chunk, so
+    // each row is moved away by noise of about 0.75 of its length (cosine ~0.8). Seeded, so repeated measurements agree.
+    FRandomStream Noise(0x52454341);
+    const float NoiseAmplitude = 0.75f * UE_SQRT_3 / FMath::Sqrt(static_cast<float>(Dimension));
+
+    int32 Found = 0;
+    int32 Expected = 0;
+    TArray<FKnowledgeMatch> Exact;
+    TArray<FKnowledgeMatch> Approximate;
+    FPreparedQuery Scratch;
+    TArray<float> Perturbed;
+    FPreparedQuery Query;
+    for (int32 Row = 0, Done = 0; Row < NumRows && Done < NumQueries; Row += QueryStep, Done++)
+    {
+        const float* RowQuery = GetRowQuery(Row, Scratch);
+        Perturbed.SetNumUninitialized(Dimension, EAllowShrinking::No);
+        for (int32 i = 0; i < Dimension; i++)
+        {
+            Perturbed[i] = RowQuery[i] + Noise.FRandRange(-NoiseAmplitude, NoiseAmplitude);
+        }
+        if (!PrepareQuery(Perturbed, Query))
+        {
+            continue;
+        }
+
+        SearchExact(Query.GetData(), K, -1.0f, Exact);
+        Graph->Search(*this, Query.GetData(), K, EfSearch, -1.0f, Approximate);
+
+        Expected += Exact.Num();
+        for (const FKnowledgeMatch& Match : Exact)
+        {
+            Found += Approximate.ContainsByPredicate([&Match](const FKnowledgeMatch& Other) { return Other.Index == Match.Index; }) ? 1 : 0;
+        }
+    }
+
+    return Expected > 0 ? static_cast<float>(Found) / Expected : 1.0f;
+}
+
+uint64 FKnowledgeIndex::GetContentKey() const
+{
+    FXxHash64Builder Builder;
+    Builder.Update(&Storage, sizeof(Storage));
+    Builder.Update(&Dimension, sizeof(Dimension));
+    Builder.Update(&NumRows, sizeof(NumRows));
+    Builder.Update(TextOffsets.GetData(), TextOffsets.Num() * sizeof(int32));
+    Builder.Update(TextPool.GetData(), TextPool.Num() * sizeof(TCHAR));
+    return Builder.Finalize().Hash;
+}
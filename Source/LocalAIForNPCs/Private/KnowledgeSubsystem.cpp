@@ -0,0 +1,118 @@
+#include "KnowledgeSubsystem.h"
+
+void FKnowledgeRegistry::AddReference(const FString& Key)
+{
+    FScopeLock Lock(&Mutex);
+
+    if (FKnowledgeEntry* Entry = Entries.Find(Key))
+    {
+        Entry->References++;
+    }
+    else
+    {
+        FKnowledgeEntry& NewEntry = Entries.Add(Key);
+        NewEntry.References = 1;
+    }
+}
+
+void FKnowledgeRegistry::Release(const FString& Key)
+{
+    FScopeLock Lock(&Mutex);
+
+    FKnowledgeEntry* Entry = Entries.Find(Key);
+    if (Entry && --Entry->References <= 0)
+    {
+        Entries.Remove(Key);
+        UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | RAG] Released shared knowledge: %s"), *Key);
+    }
+}
+
+FKnowledgeHandle FKnowledgeRegistry::GetOrBuild(const FString& Key, TFunctionRef<FKnowledgeHandle()> Build)
+{
+    // Each caller builds at most once. A caller whose wait ends in a failed build tries again, so it either finds a
+    // newer build in flight or becomes the builder itself.
+    for (;;)
+    {
+        TSharedPtr<TPromise<FKnowledgeHandle>> Promise;
+        TSharedFuture<FKnowledgeHandle> Index;
+        uint32 BuildId = 0;
+        {
+            FScopeLock Lock(&Mutex);
+
+            // Only referenced keys have entries; a key released before its build started is not built at all.
+            FKnowledgeEntry* Entry = Entries.Find(Key);
+            if (!Entry)
+            {
+                UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | RAG] Knowledge released before it was built: %s"), *Key);
+                return nullptr;
+            }
+
+            if (!Entry->Index.IsValid())
+            {
+                Promise = MakeShared<TPromise<FKnowledgeHandle>>();
+                Entry->Index = Promise->GetFuture().Share();
+                Entry->BuildId = ++NextBuildId;
+            }
+            Index = Entry->Index;
+            BuildId = Entry->BuildId;
+        }
+
+        if (!Promise.IsValid())
+        {
+            FKnowledgeHandle Shared = Index.Get();
+            if (Shared.IsValid() && Shared->Num() > 0)
+            {
+                UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | RAG] Using shared knowledge: %s"), *Key);
+                return Shared;
+            }
+
+            UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | LLM | RAG] Shared knowledge build failed, retrying: %s"), *Key);
+            continue;
+        }
+
+        FKnowledgeHandle Built = Build();
+        if (!Built.IsValid() || Built->Num() == 0)
+        {
+            // Clear the failed build before waking the waiters, so the first of them to retry starts a new one.
+            FScopeLock Lock(&Mutex);
+            FKnowledgeEntry* Entry = Entries.Find(Key);
+            if (Entry && Entry->BuildId == BuildId)
+            {
+                Entry->Index = TSharedFuture<FKnowledgeHandle>();
+            }
+        }
+        Promise->SetValue(Built);
+
+        return Built;
+    }
+}
+
+TSharedRef<FEmbeddingCache, ESPMode::ThreadSafe> FKnowledgeRegistry::GetEmbeddingStore(const FString& FilePath, int32 MaxEntries)
+{
+    FScopeLock Lock(&Mutex);
+
+    if (TSharedPtr<FEmbeddingCache, ESPMode::ThreadSafe> Existing = EmbeddingStores.FindRef(FilePath).Pin())
+    {
+        return Existing.ToSharedRef();
+    }
+
+    TSharedRef<FEmbeddingCache, ESPMode::ThreadSafe> Store = MakeShared<FEmbeddingCache, ESPMode::ThreadSafe>();
+    Store->SetMaxEntries(MaxEntries);
+    Store->Load(FilePath);
+    EmbeddingStores.Add(FilePath, Store);
+    return Store;
+}
+
+void FKnowledgeRegistry::Empty()
+{
+    FScopeLock Lock(&Mutex);
+    Entries.Empty();
+    EmbeddingStores.Empty();
+}
+
+void UKnowledgeSubsystem::Deinitialize()
+{
+    Registry->Empty();
+
+    Super::Deinitialize();
+}
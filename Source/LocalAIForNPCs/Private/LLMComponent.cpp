@@ -9,6 +9,29 @@
 #include "Serialization/JsonSerializer.h"
 #include "SocketSubsystem.h"
 #include "Sockets.h"
+#include "LLMStreamParser.h"
+#include "ActionTagMatcher.h"
+#include "LLMSlotRegistry.h"
+#include "TextSanitizer.h"
+#include "KnowledgeChunker.h"
+#include "KnowledgeSubsystem.h"
+#include "Engine/GameInstance.h"
+
+namespace
+{
+    struct FEmbeddingBatchState
+    {
+        TArray<TArray<float>> Embeddings;
+        FThreadSafeCounter InFlight;
+        FThreadSafeCounter Completed;
+        FEvent* BatchDone = FPlatformProcess::GetSynchEventFromPool(false);
+
+        ~FEmbeddingBatchState()
+        {
+            FPlatformProcess::ReturnSynchEventToPool(BatchDone);
+        }
+    };
+}
 
 ULLMComponent::ULLMComponent()
 {
@@ -21,19 +44,93 @@ void ULLMComponent::BeginPlay()
 {
     Super::BeginPlay();
 
+    ConversationId = FGuid::NewGuid();
+
+    // Pinning only helps once the server has several slots to choose from, or the user asked for a specific one.
+    // Otherwise id_slot is left out and the server picks a slot, which still reuses the cached prompt.
+    if (bCachePrompt && (NumServerSlots > 1 || SlotId >= 0))
+    {
+        AssignedSlot = FLLMSlotRegistry::Get().AcquireSlot(Port, NumServerSlots, SlotId);
+        UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM] Conversation pinned to server slot %d on port %d."), AssignedSlot, Port);
+    }
+
     if (RagMode != ERagMode::Disabled)
     {
         UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | RAG] RAG mode enabled, generating knowledge..."));
 
-        Async(EAsyncExecution::Thread, [this]()
+        EmbeddingCache = MakeShared<FEmbeddingCache, ESPMode::ThreadSafe>(QueryEmbeddingCacheSize);
+
+        UKnowledgeSubsystem* Subsystem = nullptr;
+        if (UGameInstance* GameInstance = GetWorld() ? GetWorld()->GetGameInstance() : nullptr)
+        {
+            Subsystem = GameInstance->GetSubsystem<UKnowledgeSubsystem>();
+        }
+        if (Subsystem)
+        {
+            KnowledgeKey = BuildKnowledgeKey();
+            KnowledgeSubsystem = Subsystem;
+            Subsystem->AddKnowledgeReference(KnowledgeKey);
+        }
+
+        // The worker only sees copies and the thread-safe registry; the component and subsystem are checked again on
+        // the game thread before the result is handed over.
+        TWeakObjectPtr<ULLMComponent> WeakThis(this);
+        TWeakObjectPtr<UKnowledgeSubsystem> WeakSubsystem(Subsystem);
+        Async(EAsyncExecution::Thread, [WeakThis, WeakSubsystem, Key = KnowledgeKey, Rag = MakeRagContext()]() mutable
             {
-                GenerateKnowledge();
+                if (Rag.RagMode != ERagMode::Lexical && (Rag.bUseEmbeddingCache || Rag.KnowledgeIndexType == EKnowledgeIndexType::HNSW))
+                {
+                    Rag.EmbeddingModelId = ResolveEmbeddingModelId(Rag);
+                }
+
+                TFunction<void(int32, int32)> OnProgress = [WeakThis](int32 Done, int32 Total)
+                    {
+                        AsyncTask(ENamedThreads::GameThread, [WeakThis, Done, Total]()
+                            {
+                                if (ULLMComponent* This = WeakThis.Get())
+                                {
+                                    This->OnKnowledgeProgress.Broadcast(Done, Total);
+                                }
+                            });
+                    };
+
+                FKnowledgeHandle NewIndex;
+                if (Rag.Registry.IsValid())
+                {
+                    NewIndex = Rag.Registry->GetOrBuild(Key, [&Rag, &OnProgress]()
+                        {
+                            return BuildKnowledge(Rag, OnProgress);
+                        });
+                }
+                else
+                {
+                    NewIndex = BuildKnowledge(Rag, OnProgress);
+                }
                 UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | RAG] Knowledge generation complete."));
+
+                AsyncTask(ENamedThreads::GameThread, [WeakThis, WeakSubsystem, bShared = Rag.Registry.IsValid(), NewIndex, ModelId = Rag.EmbeddingModelId]()
+                    {
+                        ULLMComponent* This = WeakThis.Get();
+                        if (!This || (bShared && !WeakSubsystem.IsValid()))
+                        {
+                            return;
+                        }
+
+                        This->KnowledgeIndex = NewIndex;
+                        This->EmbeddingModelId = ModelId;
+                        This->OnKnowledgeReady.Broadcast(NewIndex.IsValid() ? NewIndex->Num() : 0);
+                    });
             });
     }
 
     if (!KnownActions.IsEmpty())
     {
+        if (bConstrainActionGrammar)
+        {
+            ActionGrammar = BuildActionGrammar();
+            UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | Actions] Action grammar: %s"), *ActionGrammar);
+        }
+
         SystemMessage += TEXT("\n\n") + BuildActionsSystemMessage();
         UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | Actions] SystemMessage updated with known actions and objects."));
     }
@@ -41,8 +138,32 @@ void ULLMComponent::BeginPlay()
     if (RagMode != ERagMode::Disabled)
     {
         SystemMessage.Append(TEXT("\n\n"));
-        SystemMessage.Append(TEXT("Answer questions using the provided context: \n"));
+        SystemMessage.Append(TEXT("Answer questions using the context provided before the user's message, if it is relevant."));
+    }
+}
+
+void ULLMComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    if (CancellationToken)
+    {
+        CancellationToken->Cancel();
+    }
+
+    CancelWarmUp();
+
+    if (AssignedSlot >= 0)
+    {
+        FLLMSlotRegistry::Get().ReleaseSlot(Port, AssignedSlot);
+        AssignedSlot = -1;
+    }
+
+    if (UKnowledgeSubsystem* Subsystem = KnowledgeSubsystem.Get())
+    {
+        Subsystem->ReleaseKnowledge(KnowledgeKey);
+        KnowledgeSubsystem.Reset();
     }
+
+    Super::EndPlay(EndPlayReason);
 }
 
 void ULLMComponent::SendChatMessage(FString Message)
@@ -56,29 +177,45 @@ void ULLMComponent::SendChatMessage(FString Message)
         return;
     }
 
-    FChatMessage NewMessage;
-    NewMessage.Role = "user";
-    NewMessage.Content = Message;
-    ChatHistory.Add(NewMessage);
+    AddToHistory(TEXT("user"), Message);
+    EnforceHistoryBudget();
 
     if (RagMode != ERagMode::Disabled)
     {
         UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | RAG] Starting RAG process"));
 
-        Async(EAsyncExecution::Thread, [this, Message]()
+        // Reuse the embedding if the message was just embedded for a response cache lookup.
+        TArray<float> QueryEmbedding;
+        if (Message == LastQueryText)
+        {
+            QueryEmbedding = MoveTemp(LastQueryEmbedding);
+        }
+        LastQueryText.Reset();
+        LastQueryEmbedding.Reset();
+
+        Async(EAsyncExecution::Thread, [WeakThis = TWeakObjectPtr<ULLMComponent>(this), Rag = MakeRagContext(), Message, Embedding = MoveTemp(QueryEmbedding), Token = GetCancellationToken()]() mutable
             {
-                TArray<float> Embedding = EmbedText(Message);
+                if (Rag.RagMode != ERagMode::Lexical && Embedding.IsEmpty())
+                {
+                    Embedding = EmbedText(Rag, Message, Token);
+                }
+
+                if (Token->IsCancelled())
+                {
+                    UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | RAG] Turn cancelled, skipping retrieval."));
+                    return;
+                }
 
-                TArray<FString> RagDocuments = GetTopKDocuments(Embedding);
+                TArray<FString> RagDocuments = GetTopKDocuments(Rag, Message, Embedding);
 
                 for (const FString& Doc : RagDocuments)
                 {
-                    UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | RAG] Embedding selected document: %s"), *Doc);
+                    UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | RAG] Retrieval selected document: %s"), *Doc);
                 }
 
-                if (RagMode == ERagMode::EmbeddingPlusReranker)
+                if (Rag.RagMode == ERagMode::EmbeddingPlusReranker)
                 {
-                    RagDocuments = RerankDocuments(Message, RagDocuments);
+                    RagDocuments = RerankDocuments(Rag, Message, RagDocuments, Token);
 
                     for (const FString& Doc : RagDocuments)
                     {
@@ -86,24 +223,17 @@ void ULLMComponent::SendChatMessage(FString Message)
                     }
                 }
 
-                AsyncTask(ENamedThreads::GameThread, [this, RagDocuments]()
+                AsyncTaskForTurn(WeakThis, Token, [RagDocuments](ULLMComponent* This)
                     {
-                        for (const FString& Doc : RagDocuments)
-                        {
-                            if (!SystemMessage.Contains(Doc))
-                            {
-                                SystemMessage.Append(Doc);
-                                SystemMessage.Append(TEXT("\n"));
-                            }
-                        }
+                        This->BuildTurnContext(RagDocuments);
 
-                        if (!bStream)
+                        if (!This->bStream)
                         {
-                            SendRequest();
+                            This->SendRequest();
                         }
                         else
                         {
-                            SendRequestStreaming();
+                            This->SendRequestStreaming();
                         }
                     });
             });
@@ -124,21 +254,35 @@ void ULLMComponent::SendChatMessage(FString Message)
 void ULLMComponent::SendRequest()
 {
     FString Url = FString::Printf(TEXT("http://localhost:%d/v1/chat/completions"), Port);
-    FString Content = CreateJsonRequest();
+    BuildRequestBody();
+    MarkSlotServed();
 
+    const FCancellationTokenPtr Token = GetCancellationToken();
     TSharedRef<IHttpRequest, ESPMode::ThreadSafe> Request = FHttpModule::Get().CreateRequest();
     Request->SetURL(Url);
     Request->SetVerb("POST");
     Request->SetHeader("Content-Type", "application/json");
-    Request->SetContentAsString(Content);
+    Request->SetContent(RequestBody);
 
-    Request->OnProcessRequestComplete().BindLambda([this](FHttpRequestPtr Req, FHttpResponsePtr Response, bool bWasSuccessful)
+    const uint32 CancelHandle = Token->AddCallback([Request]()
         {
+            Request->CancelRequest();
+        });
+
+    Request->OnProcessRequestComplete().BindLambda([this, WeakThis = TWeakObjectPtr<ULLMComponent>(this), Token, CancelHandle](FHttpRequestPtr Req, FHttpResponsePtr Response, bool bWasSuccessful)
+        {
+            Token->RemoveCallback(CancelHandle);
+            if (!WeakThis.IsValid() || Token->IsCancelled())
+            {
+                UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM] Request cancelled."));
+                return;
+            }
+
             if (!bWasSuccessful || !Response.IsValid())
             {
                 UE_LOG(LogTemp, Error, TEXT("[LocalAIForNPCs | LLM] Request failed."));
 
-                AsyncTask(ENamedThreads::GameThread, [this]()
+                AsyncTaskForTurn(WeakThis, Token, [this]()
                     {
                         OnResponseReceived.Broadcast(TEXT(""));
                     });
@@ -151,7 +295,7 @@ void ULLMComponent::SendRequest()
             {
                 UE_LOG(LogTemp, Error, TEXT("[LocalAIForNPCs | LLM] HTTP %d: %s"), Code, *Response->GetContentAsString());
 
-                AsyncTask(ENamedThreads::GameThread, [this]()
+                AsyncTaskForTurn(WeakThis, Token, [this]()
                     {
                         OnResponseReceived.Broadcast(TEXT(""));
                     });
@@ -167,7 +311,7 @@ void ULLMComponent::SendRequest()
                 UE_LOG(LogTemp, Error, TEXT("[LocalAIForNPCs | LLM] Failed to parse JSON response"));
                 UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM] Response: %s"), *JsonResponse);
 
-                AsyncTask(ENamedThreads::GameThread, [this]()
+                AsyncTaskForTurn(WeakThis, Token, [this]()
                     {
                         OnResponseReceived.Broadcast(TEXT(""));
                     });
@@ -180,7 +324,7 @@ void ULLMComponent::SendRequest()
                 UE_LOG(LogTemp, Error, TEXT("[LocalAIForNPCs | LLM] No choices found in response"));
                 UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM] Response: %s"), *JsonResponse);
 
-                AsyncTask(ENamedThreads::GameThread, [this]()
+                AsyncTaskForTurn(WeakThis, Token, [this]()
                     {
                         OnResponseReceived.Broadcast(TEXT(""));
                     });
@@ -193,7 +337,7 @@ void ULLMComponent::SendRequest()
                 UE_LOG(LogTemp, Error, TEXT("[LocalAIForNPCs | LLM] Invalid choice object in response"));
                 UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM] Response: %s"), *JsonResponse);
 
-                AsyncTask(ENamedThreads::GameThread, [this]()
+                AsyncTaskForTurn(WeakThis, Token, [this]()
                     {
                         OnResponseReceived.Broadcast(TEXT(""));
                     });
@@ -206,7 +350,7 @@ void ULLMComponent::SendRequest()
                 UE_LOG(LogTemp, Error, TEXT("[LocalAIForNPCs | LLM] No message object found in choice"));
                 UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM] Response: %s"), *JsonResponse);
 
-                AsyncTask(ENamedThreads::GameThread, [this]()
+                AsyncTaskForTurn(WeakThis, Token, [this]()
                     {
                         OnResponseReceived.Broadcast(TEXT(""));
                     });
@@ -219,7 +363,7 @@ void ULLMComponent::SendRequest()
                 UE_LOG(LogTemp, Error, TEXT("[LocalAIForNPCs | LLM] No content field found in message"));
                 UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM] Response: %s"), *JsonResponse);
 
-                AsyncTask(ENamedThreads::GameThread, [this]()
+                AsyncTaskForTurn(WeakThis, Token, [this]()
                     {
                         OnResponseReceived.Broadcast(TEXT(""));
                     });
@@ -227,25 +371,21 @@ void ULLMComponent::SendRequest()
                 return;
             }
 
-            FString SanitizedResponse = SanitizeString(ResponseContent);
+            FString SanitizedResponse = FTextSanitizer::Sanitize(ResponseContent, ETextSanitizeFlags::LLM);
             UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM] Response received."));
             UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM] Response: %s"), *ResponseContent);
 
-            AsyncTask(ENamedThreads::GameThread, [this, SanitizedResponse]()
+            AsyncTaskForTurn(WeakThis, Token, [this, SanitizedResponse]()
                 {
                     OnResponseReceived.Broadcast(SanitizedResponse);
                 });
 
-            FChatMessage NewResponse;
-            NewResponse.Role = "assistant";
-            NewResponse.Content = SanitizedResponse;
-            ChatHistory.Add(NewResponse);
+            AddToHistory(TEXT("assistant"), SanitizedResponse);
 
-            FRegexPattern ActionPattern(TEXT("\\[\\[action: (.+?)\\]\\]"));
-            FRegexMatcher Matcher(ActionPattern, ResponseContent);
-            while (Matcher.FindNext())
+            TArray<FString> ActionCommands;
+            FActionTagMatcher::FindAll(ResponseContent, ActionCommands);
+            for (const FString& ActionCommand : ActionCommands)
             {
-                FString ActionCommand = Matcher.GetCaptureGroup(1);
                 HandleNpcAction(ActionCommand);
             }
         });
@@ -256,36 +396,45 @@ void ULLMComponent::SendRequest()
 
 void ULLMComponent::SendRequestStreaming()
 {
-    FString Url = FString::Printf(TEXT("http://localhost:%d/v1/chat/completions"), Port);
-    FString Content = CreateJsonRequest();
+    BuildRequestBody();
+    MarkSlotServed();
 
-    FTCHARToUTF8 Utf8Content(*Content);
-    FString RequestHeaders = FString::Printf(
-        TEXT("POST /v1/chat/completions HTTP/1.1\r\n")
-        TEXT("Host: localhost:%d\r\n")
-        TEXT("Content-Type: application/json\r\n")
-        TEXT("Accept: text/event-stream\r\n")
-        TEXT("Content-Length: %d\r\n")
-        TEXT("Connection: close\r\n\r\n"),
-        Port, Utf8Content.Length());
-
-    FString FullRequest = RequestHeaders + Content;
+    {
+        // A cancelled turn never delivers its final chunk, so drop whatever it left behind.
+        FScopeLock Lock(&ChunkMutex);
+        SentenceSegmenter.Reset();
+    }
 
-    Async(EAsyncExecution::Thread, [this, FullRequest = MoveTemp(FullRequest)]()
+    ANSICHAR RequestHeaders[256];
+    const int32 HeadersLen = FCStringAnsi::Snprintf(RequestHeaders, UE_ARRAY_COUNT(RequestHeaders),
+        "POST /v1/chat/completions HTTP/1.1\r\n"
+        "Host: localhost:%d\r\n"
+        "Content-Type: application/json\r\n"
+        "Accept: text/event-stream\r\n"
+        "Content-Length: %d\r\n"
+        "Connection: close\r\n\r\n",
+        Port, RequestBody.Num());
+
+    TArray<uint8> FullRequest;
+    FullRequest.Reserve(HeadersLen + RequestBody.Num());
+    FullRequest.Append(reinterpret_cast<const uint8*>(RequestHeaders), HeadersLen);
+    FullRequest.Append(RequestBody);
+
+    Async(EAsyncExecution::Thread, [WeakThis = TWeakObjectPtr<ULLMComponent>(this), ServerPort = Port, FullRequest = MoveTemp(FullRequest), Token = GetCancellationToken()]()
         {
             ISocketSubsystem* SocketSubsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
             TSharedRef<FInternetAddr> Addr = SocketSubsystem->CreateInternetAddr();
             bool bIsValid;
             Addr->SetIp(TEXT("127.0.0.1"), bIsValid);
-            Addr->SetPort(Port);
+            Addr->SetPort(ServerPort);
 
             if (!bIsValid)
             {
                 UE_LOG(LogTemp, Error, TEXT("[LocalAIForNPCs | LLM] Invalid IP address"));
 
-                AsyncTask(ENamedThreads::GameThread, [this]()
+                AsyncTaskForTurn(WeakThis, Token, [](ULLMComponent* This)
                     {
-                        OnResponseReceived.Broadcast(TEXT(""));
+                        This->OnResponseReceived.Broadcast(TEXT(""));
                     });
 
                 return;
@@ -294,129 +443,143 @@ void ULLMComponent::SendRequestStreaming()
             FSocket* Socket = SocketSubsystem->CreateSocket(NAME_Stream, TEXT("LLMStreamSocket"), false);
             if (!Socket || !Socket->Connect(*Addr))
             {
-                UE_LOG(LogTemp, Error, TEXT("[LocalAIForNPCs | LLM] Failed to connect to LLM server on port %d"), Port);
+                UE_LOG(LogTemp, Error, TEXT("[LocalAIForNPCs | LLM] Failed to connect to LLM server on port %d"), ServerPort);
 
-                AsyncTask(ENamedThreads::GameThread, [this]()
+                AsyncTaskForTurn(WeakThis, Token, [](ULLMComponent* This)
                     {
-                        OnResponseReceived.Broadcast(TEXT(""));
+                        This->OnResponseReceived.Broadcast(TEXT(""));
                     });
 
                 return;
             }
 
             int32 BytesSent = 0;
-            auto ConvertedRequest = StringCast<UTF8CHAR>(*FullRequest);
-            Socket->Send((const uint8*)ConvertedRequest.Get(), ConvertedRequest.Length(), BytesSent);
+            Socket->Send(FullRequest.GetData(), FullRequest.Num(), BytesSent);
 
             UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM] Sent streaming request, waiting for response..."));
 
             constexpr int32 BufferSize = 8192;
             uint8 Buffer[BufferSize];
-            FString StreamedData;
             bool bDone = false;
 
+            bool bFailed = false;
             FString FullResponse;
 
+            FLLMStreamParser Parser;
+            TArray<FString> Tokens;
+
+            FActionTagMatcher ActionMatcher;
+            TArray<FString> ActionCommands;
+
             const double TimeoutSeconds = 60.0;
             double StartTime = FPlatformTime::Seconds();
 
-            while (!bDone && (FPlatformTime::Seconds() - StartTime) < TimeoutSeconds)
+            while (!bDone && !Token->IsCancelled() && (FPlatformTime::Seconds() - StartTime) < TimeoutSeconds)
             {
-                if (Socket->Wait(ESocketWaitConditions::WaitForRead, FTimespan::FromSeconds(1.0f)))
+                // Short waits so a cancelled turn releases the socket promptly.
+                if (Socket->Wait(ESocketWaitConditions::WaitForRead, FTimespan::FromMilliseconds(100.0)))
                 {
                     int32 BytesRead = 0;
-                    if (Socket->Recv(Buffer, BufferSize, BytesRead))
+                    if (Socket->Recv(Buffer, BufferSize, BytesRead) && BytesRead > 0)
                     {
-                        FString Chunk = FString(StringCast<TCHAR>((const UTF8CHAR*)Buffer, BytesRead).Get(), BytesRead);
-                        StreamedData += Chunk;
+                        Tokens.Reset();
+                        Parser.Feed(Buffer, BytesRead, Tokens);
 
-                        TArray<FString> Lines;
-                        Chunk.ParseIntoArrayLines(Lines);
-                        for (const FString& Line : Lines)
+                        for (FString& PartialText : Tokens)
                         {
-                            if (Line.StartsWith("data: "))
-                            {
-                                FString Payload = Line.Mid(6).TrimStartAndEnd();
-                                if (Payload == TEXT("[DONE]"))
+                            UE_LOG(LogTemp, Verbose, TEXT("[LocalAIForNPCs | LLM] Token received."));
+                            FullResponse.Append(PartialText);
+                            ActionMatcher.Feed(PartialText, ActionCommands);
+                            AsyncTaskForTurn(WeakThis, Token, [PartialText = MoveTemp(PartialText)](ULLMComponent* This)
                                 {
-                                    UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM] Response received."));
-                                    bDone = true;
-                                    AsyncTask(ENamedThreads::GameThread, [this, bDone]()
-                                        {
-                                            OnStreamTokenReceived.Broadcast(TEXT(""), bDone);
-                                        });
-                                    break;
-                                }
+                                    This->OnStreamTokenReceived.Broadcast(PartialText, false);
+                                    UE_LOG(LogTemp, Verbose, TEXT("[LocalAIForNPCs | LLM] Streamed token: %s"), *PartialText);
+                                });
+                        }
 
-                                TSharedPtr<FJsonObject> JsonObject;
-                                TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Payload);
-                                if (FJsonSerializer::Deserialize(Reader, JsonObject) && JsonObject.IsValid())
+                        if (ActionCommands.Num() > 0)
+                        {
+                            AsyncTaskForTurn(WeakThis, Token, [ActionCommands = MoveTemp(ActionCommands)](ULLMComponent* This)
                                 {
-                                    const TArray<TSharedPtr<FJsonValue>>* Choices;
-                                    if (JsonObject->TryGetArrayField(TEXT("choices"), Choices) && Choices->Num() > 0)
-                                    {
-                                        const TSharedPtr<FJsonObject>* Delta;
-                                        if ((*Choices)[0]->AsObject()->TryGetObjectField(TEXT("delta"), Delta))
-                                        {
-                                            FString PartialText;
-                                            if ((*Delta)->TryGetStringField(TEXT("content"), PartialText))
-                                            {
-                                                UE_LOG(LogTemp, Verbose, TEXT("[LocalAIForNPCs | LLM] Token received."));
-                                                FullResponse.Append(PartialText);
-                                                AsyncTask(ENamedThreads::GameThread, [this, PartialText, bDone]()
-                                                    {
-                                                        OnStreamTokenReceived.Broadcast(PartialText, bDone);
-                                                        UE_LOG(LogTemp, Verbose, TEXT("[LocalAIForNPCs | LLM] Streamed token: %s"), *PartialText);
-                                                    });
-                                            }
-                                            else
-                                            {
-                                                UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | LLM] No content field in delta"));
-                                                UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM] Payload: %s"), *Payload);
-                                            }
-                                        }
-                                        else
-                                        {
-                                            UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | LLM] No delta field in choice"));
-                                            UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM] Payload: %s"), *Payload);
-                                        }
-                                    }
-                                    else
+                                    for (const FString& ActionCommand : ActionCommands)
                                     {
-                                        UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | LLM] No choices found in streamed data"));
-                                        UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM] Payload: %s"), *Payload);
+                                        This->HandleNpcAction(ActionCommand);
                                     }
-                                }
-                                else
-                                {
-                                    UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | LLM] Failed to parse JSON from streamed data: %s"), *Payload);
-                                }
-                            }
-                            else
+                                });
+                            ActionCommands.Reset();
+                        }
+
+                        // A chunked error response also ends with a zero-size chunk, so check for an error first.
+                        if (Parser.HasError())
+                        {
+                            if (Parser.IsDone())
                             {
-                                UE_LOG(LogTemp, Verbose, TEXT("[LocalAIForNPCs | LLM] Ignoring line: %s"), *Line);
+                                UE_LOG(LogTemp, Error, TEXT("[LocalAIForNPCs | LLM] HTTP %d: %s"), Parser.GetStatusCode(), *Parser.GetErrorBody());
+                                bDone = true;
+                                bFailed = true;
                             }
                         }
+                        else if (Parser.IsDone())
+                        {
+                            UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM] Response received."));
+                            bDone = true;
+                        }
                     }
                     else
                     {
-                        UE_LOG(LogTemp, Error, TEXT("[LocalAIForNPCs | LLM] Failed to read data from socket"));
+                        if (Parser.HasError())
+                        {
+                            UE_LOG(LogTemp, Error, TEXT("[LocalAIForNPCs | LLM] HTTP %d: %s"), Parser.GetStatusCode(), *Parser.GetErrorBody());
+                            bFailed = true;
+                        }
+                        else if (BytesRead == 0)
+                        {
+                            UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | LLM] Connection closed by server before the stream finished"));
+                        }
+                        else
+                        {
+                            UE_LOG(LogTemp, Error, TEXT("[LocalAIForNPCs | LLM] Failed to read data from socket"));
+                        }
                         bDone = true;
                     }
+
+                    if (bDone)
+                    {
+                        AsyncTaskForTurn(WeakThis, Token, [](ULLMComponent* This)
+                            {
+                                This->OnStreamTokenReceived.Broadcast(TEXT(""), true);
+                            });
+                    }
                 }
                 else
                 {
                     UE_LOG(LogTemp, Verbose, TEXT("[LocalAIForNPCs | LLM] No data ready to read yet..."));
                 }
             }
-            if (!bDone)
+            if (Token->IsCancelled())
+            {
+                Socket->Close();
+                ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(Socket);
+                UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM] Streaming cancelled, socket closed."));
+                return;
+            }
+
+            if (!bDone || bFailed)
             {
-                UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | LLM] Streaming timed out after %.2f seconds"), TimeoutSeconds);
+                if (!bDone)
+                {
+                    UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | LLM] Streaming timed out after %.2f seconds"), TimeoutSeconds);
+                }
+
+                Socket->Close();
+                ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(Socket);
 
-                AsyncTask(ENamedThreads::GameThread, [this]()
+                AsyncTaskForTurn(WeakThis, Token, [](ULLMComponent* This)
                     {
-                        OnResponseReceived.Broadcast(TEXT(""));
+                        This->OnResponseReceived.Broadcast(TEXT(""));
                     });
+
+                return;
             }
 
             Socket->Close();
@@ -428,199 +591,540 @@ void ULLMComponent::SendRequestStreaming()
             {
                 UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | LLM] No response received from server"));
 
-                AsyncTask(ENamedThreads::GameThread, [this]()
+                AsyncTaskForTurn(WeakThis, Token, [](ULLMComponent* This)
                     {
-                        OnResponseReceived.Broadcast(TEXT(""));
+                        This->OnResponseReceived.Broadcast(TEXT(""));
                     });
 
                 return;
             }
 
-            AsyncTask(ENamedThreads::GameThread, [this, FullResponse]()
+            AsyncTaskForTurn(WeakThis, Token, [FullResponse](ULLMComponent* This)
                 {
-                    FString SanitizedResponse = SanitizeString(FullResponse);
-                    OnResponseReceived.Broadcast(SanitizedResponse);
-
-                    FChatMessage NewResponse;
-                    NewResponse.Role = "assistant";
-                    NewResponse.Content = SanitizedResponse;
-                    ChatHistory.Add(NewResponse);
+                    FString SanitizedResponse = FTextSanitizer::Sanitize(FullResponse, ETextSanitizeFlags::LLM);
+                    This->OnResponseReceived.Broadcast(SanitizedResponse);
 
-                    FRegexPattern ActionPattern(TEXT("\\[\\[action: (.+?)\\]\\]"));
-                    FRegexMatcher Matcher(ActionPattern, FullResponse);
-                    while (Matcher.FindNext())
-                    {
-                        FString ActionCommand = Matcher.GetCaptureGroup(1);
-                        HandleNpcAction(ActionCommand);
-                    }
+                    This->AddToHistory(TEXT("assistant"), SanitizedResponse);
                 });
         });
 }
 
-FString ULLMComponent::CreateJsonRequest()
+FCancellationTokenPtr ULLMComponent::GetCancellationToken()
 {
-    TSharedPtr<FJsonObject> RootObject = MakeShared<FJsonObject>();
-    RootObject->SetBoolField("stream", bStream);
-
-    TArray<TSharedPtr<FJsonValue>> JsonMessages;
-    if (!SystemMessage.IsEmpty())
-    {
-        TSharedPtr<FJsonObject> SystemObj = MakeShared<FJsonObject>();
-        SystemObj->SetStringField("role", "system");
-        SystemObj->SetStringField("content", SystemMessage);
-        JsonMessages.Add(MakeShared<FJsonValueObject>(SystemObj));
-    }
-    for (const FChatMessage& Msg : ChatHistory)
+    if (!CancellationToken)
     {
-        TSharedPtr<FJsonObject> MsgObj = MakeShared<FJsonObject>();
-        MsgObj->SetStringField("role", Msg.Role);
-        MsgObj->SetStringField("content", Msg.Content);
-        JsonMessages.Add(MakeShared<FJsonValueObject>(MsgObj));
+        CancellationToken = MakeShared<FCancellationToken, ESPMode::ThreadSafe>();
     }
-    RootObject->SetArrayField("messages", JsonMessages);
+    return CancellationToken;
+}
 
-    FString OutputString;
-    TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&OutputString);
-    FJsonSerializer::Serialize(RootObject.ToSharedRef(), Writer);
+void ULLMComponent::BuildRequestBody()
+{
+    FChatRequestParams Params;
+    Params.bStream = bStream;
+    Params.bCachePrompt = bCachePrompt;
+    Params.SlotId = AssignedSlot;
+
+    Params.TurnContext = &TurnContext;
+    Params.Grammar = &ActionGrammar;
 
-    return OutputString;
+    RequestWriter.Write(RequestBody, Params, SystemMessage, GetHistoryPrefix(), ChatHistory);
+
+    TurnContext.Reset();
 }
 
-void ULLMComponent::HandleStreamChunk(const FString& Token, bool bDone)
+void ULLMComponent::BuildTurnContext(const TArray<FString>& Documents)
 {
-    FScopeLock Lock(&ChunkMutex);
-
-    AccumulatedChunk += Token;
+    TurnContext.Reset();
 
-    if (bDone)
+    TSet<uint32> SeenDocuments;
+    for (const FString& Doc : Documents)
     {
-        FString SanitizedChunk = SanitizeString(AccumulatedChunk);
-        if (SanitizedChunk.Len() > 1)
+        bool bAlreadyAdded = false;
+        SeenDocuments.Add(FCrc::StrCrc32(*Doc), &bAlreadyAdded);
+        if (bAlreadyAdded)
         {
-            OnStreamChunkReceived.Broadcast(SanitizedChunk, bDone);
-            UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM] Chunk: %s"), *SanitizedChunk);
+            continue;
         }
-        else
+
+        if (TurnContext.Len() + Doc.Len() > MaxRagContextCharacters)
         {
-            OnStreamChunkReceived.Broadcast(TEXT(""), bDone);
+            UE_LOG(LogTemp, Verbose, TEXT("[LocalAIForNPCs | LLM | RAG] Context budget reached, skipping remaining documents."));
+            break;
         }
 
-        AccumulatedChunk.Empty();
-        return;
+        if (TurnContext.IsEmpty())
+        {
+            TurnContext.Append(TEXT("Context:\n"));
+        }
+        TurnContext.Append(TEXT("- "));
+        TurnContext.Append(Doc);
+        TurnContext.Append(TEXT("\n"));
     }
 
-    TSet<FString> AbbreviationWhitelist = {
-    TEXT("Mr."), TEXT("Mrs."), TEXT("Ms."), TEXT("Dr."), TEXT("Jr.")
-    };
+    if (!TurnContext.IsEmpty())
+    {
+        TurnContext.Append(TEXT("\n"));
+    }
+}
 
-    int32 LastDelimiterIndex = -1;
+void ULLMComponent::AddToHistory(const FString& Role, const FString& Content)
+{
+    FChatMessage NewMessage;
+    NewMessage.Role = Role;
+    NewMessage.Content = Content;
 
-    for (int32 i = 0; i < AccumulatedChunk.Len(); ++i)
+    if (MaxHistoryTokens > 0)
     {
-        TCHAR CurrentChar = AccumulatedChunk[i];
-        if (CurrentChar == '.' || CurrentChar == '!' || CurrentChar == '?' || CurrentChar == ';' || CurrentChar == '\n' || CurrentChar == '\r')
-        {
-            bool bIsAbbreviation = false;
-            if (CurrentChar == '.')
-            {
-                int32 Lookbehind = 8;
-                int32 Start = FMath::Max(0, i - Lookbehind + 1);
-                FString Sub = AccumulatedChunk.Mid(Start, i - Start + 1);
-                for (const FString& Abbr : AbbreviationWhitelist)
-                {
-                    if (Sub.EndsWith(Abbr))
-                    {
-                        bIsAbbreviation = true;
-                        break;
-                    }
-                }
-            }
-            if (!bIsAbbreviation)
+        // Counts live on the history entries only, so they go away with the messages. A repeated message reuses one.
+        const FChatMessage* Counted = ChatHistory.FindByPredicate([&Content](const FChatMessage& Message)
             {
-                LastDelimiterIndex = i;
-            }
+                return Message.TokenCount >= 0 && Message.Content == Content;
+            });
+        if (Counted)
+        {
+            NewMessage.TokenCount = Counted->TokenCount;
+        }
+        else
+        {
+            RequestTokenCount(Content);
         }
     }
 
-    if (LastDelimiterIndex == -1)
+    ChatHistory.Add(NewMessage);
+}
+
+void ULLMComponent::RequestTokenCount(const FString& Content)
+{
+    if (PendingTokenCounts.Contains(Content))
     {
         return;
     }
+    PendingTokenCounts.Add(Content);
 
-    FString Chunk = AccumulatedChunk.Left(LastDelimiterIndex + 1);
-    AccumulatedChunk = AccumulatedChunk.Mid(LastDelimiterIndex + 1);
-
-    Chunk = SanitizeString(Chunk);
+    TSharedPtr<FJsonObject> JsonRequest = MakeShared<FJsonObject>();
+    JsonRequest->SetStringField("content", Content);
 
-    if (Chunk.Len() > 1)
-    {
-        OnStreamChunkReceived.Broadcast(Chunk, bDone);
-        UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM] Chunk: %s"), *Chunk);
-    }
-    else
-    {
-        UE_LOG(LogTemp, Verbose, TEXT("[LocalAIForNPCs | LLM] Empty chunk received, ignoring"));
-    }
-}
+    FString RequestString;
+    TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&RequestString);
+    FJsonSerializer::Serialize(JsonRequest.ToSharedRef(), Writer);
 
-FString ULLMComponent::SanitizeString(const FString& String)
-{
-    FString Result = String;
+    FString Url = FString::Printf(TEXT("http://localhost:%d/tokenize"), Port);
+    TSharedRef<IHttpRequest, ESPMode::ThreadSafe> Request = FHttpModule::Get().CreateRequest();
+    Request->SetURL(Url);
+    Request->SetVerb(TEXT("POST"));
+    Request->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
+    Request->SetContentAsString(RequestString);
 
-    auto RegexReplace = [](const FString& InputStr, const FString& PatternStr) -> FString
+    Request->OnProcessRequestComplete().BindLambda([this, WeakThis = TWeakObjectPtr<ULLMComponent>(this), Content](FHttpRequestPtr Req, FHttpResponsePtr Res, bool bConnected)
         {
-            FRegexPattern Pattern(PatternStr);
-            FString Output = InputStr;
+            if (!WeakThis.IsValid())
+            {
+                return;
+            }
 
-            FRegexMatcher Matcher(Pattern, Output);
-            while (Matcher.FindNext())
+            PendingTokenCounts.Remove(Content);
+
+            if (!bConnected || !Res.IsValid() || !EHttpResponseCodes::IsOk(Res->GetResponseCode()))
             {
-                int32 Start = Matcher.GetMatchBeginning();
-                int32 Length = Matcher.GetMatchEnding() - Start;
-                Output.RemoveAt(Start, Length);
+                UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | LLM | History] Tokenize request failed: %s"), Res.IsValid() ? *Res->GetContentAsString() : TEXT("No response"));
+                return;
+            }
 
-                Matcher = FRegexMatcher(Pattern, Output);
+            TSharedPtr<FJsonObject> JsonObject;
+            TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Res->GetContentAsString());
+            const TArray<TSharedPtr<FJsonValue>>* Tokens;
+            if (!FJsonSerializer::Deserialize(Reader, JsonObject) || !JsonObject.IsValid() || !JsonObject->TryGetArrayField(TEXT("tokens"), Tokens))
+            {
+                UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | LLM | History] Invalid tokenize response: %s"), *Res->GetContentAsString());
+                return;
             }
 
-            return Output;
-        };
+            const int32 Count = Tokens->Num();
+            for (FChatMessage& Message : ChatHistory)
+            {
+                if (Message.TokenCount < 0 && Message.Content == Content)
+                {
+                    Message.TokenCount = Count;
+                }
+            }
+        });
+
+    Request->ProcessRequest();
+}
+
+int32 ULLMComponent::GetMessageTokens(const FChatMessage& Message) const
+{
+    // Role markers and separators added by the chat template.
+    constexpr int32 TemplateOverhead = 4;
+
+    if (Message.TokenCount >= 0)
+    {
+        return Message.TokenCount + TemplateOverhead;
+    }
 
-    Result = RegexReplace(Result, TEXT("\\[\\[action: .*?\\]\\]"));
+    // Not counted by the server yet, assume roughly four characters per token.
+    return Message.Content.Len() / 4 + 1 + TemplateOverhead;
+}
 
-    Result = RegexReplace(Result, TEXT("\\[[^\\]]*\\]"));
+void ULLMComponent::EnforceHistoryBudget()
+{
+    if (MaxHistoryTokens <= 0)
+    {
+        return;
+    }
 
-    Result = RegexReplace(Result, TEXT("\\*[^\\*]*\\*"));
+    int32 TotalTokens = 0;
+    for (const FChatMessage& Message : ChatHistory)
+    {
+        TotalTokens += GetMessageTokens(Message);
+    }
 
-    Result = RegexReplace(Result, TEXT("<[^>]*>"));
+    int32 NumEvicted = 0;
+    while (TotalTokens > MaxHistoryTokens && NumEvicted < ChatHistory.Num() - 1)
+    {
+        // Drop whole turns so the remaining history still starts with a user message.
+        TotalTokens -= GetMessageTokens(ChatHistory[NumEvicted]);
+        NumEvicted++;
+        while (NumEvicted < ChatHistory.Num() - 1 && ChatHistory[NumEvicted].Role != TEXT("user"))
+        {
+            TotalTokens -= GetMessageTokens(ChatHistory[NumEvicted]);
+            NumEvicted++;
+        }
+    }
 
-    Result = Result.Replace(TEXT("\""), TEXT(""));
+    if (NumEvicted == 0)
+    {
+        return;
+    }
 
-    Result = Result.Replace(TEXT("\n"), TEXT(" "));
-    Result = Result.Replace(TEXT("\r"), TEXT(" "));
+    if (bSummarizeEvictedHistory)
+    {
+        EvictedHistory.Append(ChatHistory.GetData(), NumEvicted);
+    }
+    ChatHistory.RemoveAt(0, NumEvicted);
+    RequestWriter.Invalidate();
 
-    Result = Result.TrimStartAndEnd();
+    UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | History] Dropped %d messages to stay within %d tokens of history."), NumEvicted, MaxHistoryTokens);
 
-    return Result;
+    if (bSummarizeEvictedHistory)
+    {
+        SummarizeEvictedHistory();
+    }
 }
 
-void ULLMComponent::ClearChatHistory()
+void ULLMComponent::SummarizeEvictedHistory()
 {
-    ChatHistory.Empty();
-    UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM] Chat history cleared"));
-}
+    if (bIsSummarizing || EvictedHistory.Num() == 0)
+    {
+        return;
+    }
+    bIsSummarizing = true;
 
-TArray<float> ULLMComponent::EmbedText(const FString& Text)
-{
-    TArray<float> EmbeddingResult;
+    FString Transcript;
+    if (!HistorySummary.IsEmpty())
+    {
+        Transcript += TEXT("Summary so far:\n") + HistorySummary + TEXT("\n\n");
+    }
+    Transcript += TEXT("New conversation:\n");
+    for (const FChatMessage& Message : EvictedHistory)
+    {
+        Transcript += Message.Role + TEXT(": ") + Message.Content + TEXT("\n");
+    }
+    const int32 NumSummarized = EvictedHistory.Num();
 
-    TSharedPtr<FJsonObject> JsonRequest = MakeShared<FJsonObject>();
-    JsonRequest->SetStringField("input", Text);
+    TSharedPtr<FJsonObject> RootObject = MakeShared<FJsonObject>();
+    RootObject->SetBoolField("stream", false);
+
+    TArray<TSharedPtr<FJsonValue>> JsonMessages;
+    TSharedPtr<FJsonObject> SystemObj = MakeShared<FJsonObject>();
+    SystemObj->SetStringField("role", "system");
+    SystemObj->SetStringField("content", TEXT("Summarize the conversation between the user and the assistant in a few sentences. Keep names, facts, promises and anything the assistant should remember. Reply with the summary only."));
+    JsonMessages.Add(MakeShared<FJsonValueObject>(SystemObj));
+    TSharedPtr<FJsonObject> UserObj = MakeShared<FJsonObject>();
+    UserObj->SetStringField("role", "user");
+    UserObj->SetStringField("content", Transcript);
+    JsonMessages.Add(MakeShared<FJsonValueObject>(UserObj));
+    RootObject->SetArrayField("messages", JsonMessages);
 
     FString RequestString;
     TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&RequestString);
-    FJsonSerializer::Serialize(JsonRequest.ToSharedRef(), Writer);
+    FJsonSerializer::Serialize(RootObject.ToSharedRef(), Writer);
+
+    FString Url = FString::Printf(TEXT("http://localhost:%d/v1/chat/completions"), Port);
+    TSharedRef<IHttpRequest, ESPMode::ThreadSafe> Request = FHttpModule::Get().CreateRequest();
+    Request->SetURL(Url);
+    Request->SetVerb(TEXT("POST"));
+    Request->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
+    Request->SetContentAsString(RequestString);
+
+    Request->OnProcessRequestComplete().BindLambda([this, WeakThis = TWeakObjectPtr<ULLMComponent>(this), NumSummarized](FHttpRequestPtr Req, FHttpResponsePtr Res, bool bConnected)
+        {
+            if (!WeakThis.IsValid())
+            {
+                return;
+            }
+
+            bIsSummarizing = false;
+
+            FString Summary;
+            if (bConnected && Res.IsValid() && EHttpResponseCodes::IsOk(Res->GetResponseCode()))
+            {
+                TSharedPtr<FJsonObject> JsonObject;
+                TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Res->GetContentAsString());
+                const TArray<TSharedPtr<FJsonValue>>* Choices;
+                const TSharedPtr<FJsonObject>* MessageObj;
+                if (FJsonSerializer::Deserialize(Reader, JsonObject) && JsonObject.IsValid()
+                    && JsonObject->TryGetArrayField(TEXT("choices"), Choices) && Choices->Num() > 0
+                    && (*Choices)[0]->AsObject().IsValid() && (*Choices)[0]->AsObject()->TryGetObjectField(TEXT("message"), MessageObj))
+                {
+                    (*MessageObj)->TryGetStringField(TEXT("content"), Summary);
+                }
+            }
+
+            if (Summary.TrimStartAndEnd().IsEmpty())
+            {
+                UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | LLM | History] Failed to summarize evicted history: %s"), Res.IsValid() ? *Res->GetContentAsString() : TEXT("No response"));
+                return;
+            }
+
+            HistorySummary = FTextSanitizer::Sanitize(Summary, ETextSanitizeFlags::LLM);
+            EvictedHistory.RemoveAt(0, FMath::Min(NumSummarized, EvictedHistory.Num()));
+            UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | History] History summary updated: %s"), *HistorySummary);
+
+            SummarizeEvictedHistory();
+        });
+
+    Request->ProcessRequest();
+    UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | History] Summarizing %d evicted messages..."), NumSummarized);
+}
+
+FString ULLMComponent::GetHistoryPrefix() const
+{
+    // Kept out of the system prompt so a new summary does not invalidate the server's cached system prefix.
+    static const FString SummaryHeader = TEXT("Summary of the earlier conversation:\n");
+    return HistorySummary.IsEmpty() ? FString() : SummaryHeader + HistorySummary + TEXT("\n\n");
+}
+
+void ULLMComponent::WarmUpPrompt()
+{
+    if (!bCachePrompt || AssignedSlot < 0 || WarmUpToken.IsValid())
+    {
+        return;
+    }
+
+    const double Now = FPlatformTime::Seconds();
+    if (Now - LastWarmUpTime < WarmUpCooldownSeconds)
+    {
+        UE_LOG(LogTemp, Verbose, TEXT("[LocalAIForNPCs | LLM] Prompt warm-up skipped, cooling down."));
+        return;
+    }
+
+    if (FLLMSlotRegistry::Get().IsServing(Port, AssignedSlot, ConversationId))
+    {
+        UE_LOG(LogTemp, Verbose, TEXT("[LocalAIForNPCs | LLM] Prompt warm-up skipped, slot %d already holds this conversation."), AssignedSlot);
+        return;
+    }
+
+    if (!FLLMSlotRegistry::Get().TryBeginWarmUp(Port, MaxConcurrentWarmUps))
+    {
+        UE_LOG(LogTemp, Verbose, TEXT("[LocalAIForNPCs | LLM] Prompt warm-up skipped, %d already in flight."), MaxConcurrentWarmUps);
+        return;
+    }
+    LastWarmUpTime = Now;
+
+    // Generating nothing makes the server only prefill the prompt into the slot's KV cache.
+    FChatRequestParams Params;
+    Params.bCachePrompt = true;
+    Params.SlotId = AssignedSlot;
+    Params.MaxTokens = 0;
+
+    TArray<uint8> WarmUpBody;
+    RequestWriter.Write(WarmUpBody, Params, SystemMessage, GetHistoryPrefix(), ChatHistory);
+
+    FString Url = FString::Printf(TEXT("http://localhost:%d/v1/chat/completions"), Port);
+    TSharedRef<IHttpRequest, ESPMode::ThreadSafe> Request = FHttpModule::Get().CreateRequest();
+    Request->SetURL(Url);
+    Request->SetVerb(TEXT("POST"));
+    Request->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
+    Request->SetContent(MoveTemp(WarmUpBody));
+
+    WarmUpToken = MakeShared<FCancellationToken, ESPMode::ThreadSafe>();
+    const uint32 CancelHandle = WarmUpToken->AddCallback([Request]()
+        {
+            Request->CancelRequest();
+        });
+
+    Request->OnProcessRequestComplete().BindLambda([this, WeakThis = TWeakObjectPtr<ULLMComponent>(this), Token = WarmUpToken, CancelHandle, ServerPort = Port, Now](FHttpRequestPtr Req, FHttpResponsePtr Res, bool bConnected)
+        {
+            Token->RemoveCallback(CancelHandle);
+            FLLMSlotRegistry::Get().EndWarmUp(ServerPort);
+
+            if (!WeakThis.IsValid())
+            {
+                return;
+            }
+            if (WarmUpToken == Token)
+            {
+                WarmUpToken.Reset();
+            }
+
+            if (Token->IsCancelled())
+            {
+                UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM] Prompt warm-up cancelled."));
+            }
+            else if (bConnected && Res.IsValid() && EHttpResponseCodes::IsOk(Res->GetResponseCode()))
+            {
+                // Only a completed prefill leaves the conversation in the slot; a cancelled or failed one may not.
+                MarkSlotServed();
+                UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM] Prompt warmed up on slot %d in %.2f seconds."), AssignedSlot, FPlatformTime::Seconds() - Now);
+            }
+            else
+            {
+                UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | LLM] Prompt warm-up failed: %s"), Res.IsValid() ? *Res->GetContentAsString() : TEXT("No response"));
+            }
+        });
+
+    Request->ProcessRequest();
+    UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM] Warming up prompt on slot %d."), AssignedSlot);
+}
+
+void ULLMComponent::CancelWarmUp()
+{
+    if (WarmUpToken.IsValid())
+    {
+        WarmUpToken->Cancel();
+    }
+}
+
+void ULLMComponent::MarkSlotServed()
+{
+    if (AssignedSlot < 0)
+    {
+        return;
+    }
+
+    if (FLLMSlotRegistry::Get().MarkServed(Port, AssignedSlot, ConversationId))
+    {
+        UE_LOG(LogTemp, Verbose, TEXT("[LocalAIForNPCs | LLM] Slot %d still holds this conversation, only new tokens will be prefilled."), AssignedSlot);
+    }
+    else
+    {
+        UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM] Slot %d last served another conversation, the full prompt will be prefilled."), AssignedSlot);
+    }
+}
+
+void ULLMComponent::HandleStreamChunk(const FString& Token, bool bDone)
+{
+    FScopeLock Lock(&ChunkMutex);
+
+    SentenceSegmenter.Append(Token);
+
+    if (bDone)
+    {
+        FString Remaining;
+        SentenceSegmenter.Flush(Remaining);
+
+        FString SanitizedChunk = FTextSanitizer::Sanitize(Remaining, ETextSanitizeFlags::LLM);
+        if (SanitizedChunk.Len() > 1)
+        {
+            OnStreamChunkReceived.Broadcast(SanitizedChunk, bDone);
+            UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM] Chunk: %s"), *SanitizedChunk);
+        }
+        else
+        {
+            OnStreamChunkReceived.Broadcast(TEXT(""), bDone);
+        }
+        return;
+    }
+
+    FString Chunk;
+    if (!SentenceSegmenter.PopSentences(Chunk))
+    {
+        return;
+    }
+
+    Chunk = FTextSanitizer::Sanitize(Chunk, ETextSanitizeFlags::LLM);
+
+    if (Chunk.Len() > 1)
+    {
+        OnStreamChunkReceived.Broadcast(Chunk, bDone);
+        UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM] Chunk: %s"), *Chunk);
+    }
+    else
+    {
+        UE_LOG(LogTemp, Verbose, TEXT("[LocalAIForNPCs | LLM] Empty chunk received, ignoring"));
+    }
+}
+
+void ULLMComponent::ClearChatHistory()
+{
+    ChatHistory.Empty();
+    RequestWriter.Invalidate();
+    EvictedHistory.Empty();
+    HistorySummary.Empty();
+    PendingTokenCounts.Empty();
+    UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM] Chat history cleared"));
+}
+
+void ULLMComponent::EmbedQuery(const FString& Text, TFunction<void(const TArray<float>&)> OnComplete)
+{
+    Async(EAsyncExecution::Thread, [WeakThis = TWeakObjectPtr<ULLMComponent>(this), Rag = MakeRagContext(), Text, OnComplete = MoveTemp(OnComplete), Token = GetCancellationToken()]()
+        {
+            TArray<float> Embedding = EmbedText(Rag, Text, Token);
+
+            AsyncTaskForTurn(WeakThis, Token, [Text, Embedding = MoveTemp(Embedding), OnComplete](ULLMComponent* This)
+                {
+                    This->LastQueryText = Text;
+                    This->LastQueryEmbedding = Embedding;
+                    OnComplete(Embedding);
+                });
+        });
+}
+
+uint32 ULLMComponent::GetConversationHash(int32 NumTurns) const
+{
+    uint32 Hash = FCrc::StrCrc32(*SystemMessage);
+    for (int32 i = FMath::Max(0, ChatHistory.Num() - NumTurns * 2); i < ChatHistory.Num(); i++)
+    {
+        Hash = FCrc::StrCrc32(*ChatHistory[i].Role, Hash);
+        Hash = FCrc::StrCrc32(*ChatHistory[i].Content, Hash);
+    }
+    return Hash;
+}
+
+void ULLMComponent::AppendExchange(const FString& Message, const FString& Response)
+{
+    AddToHistory(TEXT("user"), Message);
+    AddToHistory(TEXT("assistant"), Response);
+    EnforceHistoryBudget();
+}
+
+TArray<float> ULLMComponent::EmbedText(const FRagContext& Rag, const FString& Text, const FCancellationTokenPtr& Token)
+{
+    TArray<float> EmbeddingResult;
+
+    if (Token && Token->IsCancelled())
+    {
+        return EmbeddingResult;
+    }
 
-    FString Url = FString::Printf(TEXT("http://localhost:%d/v1/embeddings"), EmbeddingPort);
+    const bool bCacheQuery = Rag.bUseEmbeddingCache && !Rag.EmbeddingModelId.IsEmpty() && Rag.EmbeddingCache.IsValid();
+    const uint64 QueryKey = bCacheQuery ? FEmbeddingCache::MakeKey(Rag.EmbeddingModelId, Text) : 0;
+    if (bCacheQuery && Rag.EmbeddingCache->FindQuery(QueryKey, EmbeddingResult))
+    {
+        UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | RAG] Query embedding served from cache."));
+        return EmbeddingResult;
+    }
+
+    TSharedPtr<FJsonObject> JsonRequest = MakeShared<FJsonObject>();
+    JsonRequest->SetStringField("input", Text);
+
+    FString RequestString;
+    TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&RequestString);
+    FJsonSerializer::Serialize(JsonRequest.ToSharedRef(), Writer);
+
+    FString Url = FString::Printf(TEXT("http://localhost:%d/v1/embeddings"), Rag.EmbeddingPort);
     TSharedRef<IHttpRequest, ESPMode::ThreadSafe> Request = FHttpModule::Get().CreateRequest();
     Request->SetURL(Url);
     Request->SetVerb(TEXT("POST"));
@@ -674,146 +1178,449 @@ TArray<float> ULLMComponent::EmbedText(const FString& Text)
             CompletionEvent->Trigger();
         });
 
+    {
+        // Cancelling completes the request as failed, which triggers the event.
+        FCancellationScope CancelScope(Token, [Request]()
+            {
+                Request->CancelRequest();
+            });
+
+        Request->ProcessRequest();
+        UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | RAG] Embedding request sent to %s"), *Url);
+
+        CompletionEvent->Wait();
+    }
+    FPlatformProcess::ReturnSynchEventToPool(CompletionEvent);
+
+    if (bCacheQuery && EmbeddingResult.Num() > 0)
+    {
+        Rag.EmbeddingCache->AddQuery(QueryKey, EmbeddingResult);
+    }
+
+    return EmbeddingResult;
+}
+
+FString ULLMComponent::ResolveEmbeddingModelId(const FRagContext& Rag)
+{
+    if (!Rag.EmbeddingModelName.IsEmpty())
+    {
+        return Rag.EmbeddingModelName;
+    }
+
+    FString ModelId;
+
+    FString Url = FString::Printf(TEXT("http://localhost:%d/v1/models"), Rag.EmbeddingPort);
+    TSharedRef<IHttpRequest, ESPMode::ThreadSafe> Request = FHttpModule::Get().CreateRequest();
+    Request->SetURL(Url);
+    Request->SetVerb(TEXT("GET"));
+
+    FEvent* CompletionEvent = FPlatformProcess::GetSynchEventFromPool(true);
+
+    Request->OnProcessRequestComplete().BindLambda([&](FHttpRequestPtr Req, FHttpResponsePtr Res, bool bConnected)
+        {
+            if (bConnected && Res.IsValid() && EHttpResponseCodes::IsOk(Res->GetResponseCode()))
+            {
+                TSharedPtr<FJsonObject> JsonObject;
+                TSharedRef<TJsonReader<>> JsonReader = TJsonReaderFactory<>::Create(Res->GetContentAsString());
+                const TArray<TSharedPtr<FJsonValue>>* Data;
+                if (FJsonSerializer::Deserialize(JsonReader, JsonObject) && JsonObject.IsValid()
+                    && JsonObject->TryGetArrayField(TEXT("data"), Data) && Data->Num() > 0 && (*Data)[0]->AsObject().IsValid())
+                {
+                    (*Data)[0]->AsObject()->TryGetStringField(TEXT("id"), ModelId);
+                }
+            }
+
+            CompletionEvent->Trigger();
+        });
+
     Request->ProcessRequest();
-    UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | RAG] Embedding request sent to %s"), *Url);
 
     CompletionEvent->Wait();
     FPlatformProcess::ReturnSynchEventToPool(CompletionEvent);
 
-    return EmbeddingResult;
+    if (ModelId.IsEmpty())
+    {
+        ModelId = FString::Printf(TEXT("localhost:%d"), Rag.EmbeddingPort);
+        UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | LLM | RAG] Could not query the embedding model name, caching embeddings under \"%s\". Set EmbeddingModelName to keep the cache valid when switching models."), *ModelId);
+    }
+    else
+    {
+        UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | RAG] Embedding model: %s"), *ModelId);
+    }
+
+    return ModelId;
+}
+
+FString ULLMComponent::GetEmbeddingCacheFile(const FString& ModelId)
+{
+    const uint32 ModelHash = FCrc::StrCrc32(*ModelId);
+    return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("LocalAIForNPCs"), TEXT("EmbeddingCache"), FString::Printf(TEXT("%08x.bin"), ModelHash));
 }
 
-void ULLMComponent::GenerateKnowledge()
+FString ULLMComponent::GetKnowledgeGraphFile(const FString& ModelId, const FKnowledgeIndex& Index)
 {
-    Knowledge.Empty();
+    const uint32 ModelHash = FCrc::StrCrc32(*ModelId);
+    return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("LocalAIForNPCs"), TEXT("KnowledgeIndex"), FString::Printf(TEXT("%08x_%016llx.hnsw"), ModelHash, Index.GetContentKey()));
+}
 
-    FString FileContent;
-    if (!FFileHelper::LoadFileToString(FileContent, *KnowledgePath))
+void ULLMComponent::RequestEmbeddings(const FRagContext& Rag, const TArray<FString>& Texts, TFunction<void(TArray<TArray<float>>&)> OnComplete)
+{
+    TArray<uint8> RequestBytes;
+    FChatRequestWriter::AppendRaw(RequestBytes, "{\"input\":[");
+    for (int32 i = 0; i < Texts.Num(); i++)
     {
-        UE_LOG(LogTemp, Error, TEXT("[LocalAIForNPCs | LLM | RAG] Failed to read document: %s"), *KnowledgePath);
-        return;
+        if (i > 0)
+        {
+            RequestBytes.Add(',');
+        }
+        FChatRequestWriter::AppendString(RequestBytes, Texts[i]);
+    }
+    FChatRequestWriter::AppendRaw(RequestBytes, "]}");
+
+    FString Url = FString::Printf(TEXT("http://localhost:%d/v1/embeddings"), Rag.EmbeddingPort);
+    TSharedRef<IHttpRequest, ESPMode::ThreadSafe> Request = FHttpModule::Get().CreateRequest();
+    Request->SetURL(Url);
+    Request->SetVerb(TEXT("POST"));
+    Request->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
+    Request->SetContent(MoveTemp(RequestBytes));
+
+    const int32 NumTexts = Texts.Num();
+    Request->OnProcessRequestComplete().BindLambda([NumTexts, OnComplete = MoveTemp(OnComplete)](FHttpRequestPtr Req, FHttpResponsePtr Res, bool bConnected)
+        {
+            TArray<TArray<float>> Results;
+            Results.SetNum(NumTexts);
+
+            if (bConnected && Res.IsValid() && EHttpResponseCodes::IsOk(Res->GetResponseCode()))
+            {
+                TSharedPtr<FJsonObject> JsonObject;
+                FString Content = Res->GetContentAsString();
+                TSharedRef<TJsonReader<>> JsonReader = TJsonReaderFactory<>::Create(Content);
+                const TArray<TSharedPtr<FJsonValue>>* Data;
+                if (FJsonSerializer::Deserialize(JsonReader, JsonObject) && JsonObject.IsValid() && JsonObject->TryGetArrayField(TEXT("data"), Data))
+                {
+                    for (int32 i = 0; i < Data->Num(); i++)
+                    {
+                        TSharedPtr<FJsonObject> Item = (*Data)[i]->AsObject();
+                        const TArray<TSharedPtr<FJsonValue>>* Embedding;
+                        if (!Item.IsValid() || !Item->TryGetArrayField(TEXT("embedding"), Embedding))
+                        {
+                            continue;
+                        }
+
+                        int32 Index = i;
+                        Item->TryGetNumberField(TEXT("index"), Index);
+                        if (!Results.IsValidIndex(Index))
+                        {
+                            continue;
+                        }
+
+                        Results[Index].Reserve(Embedding->Num());
+                        for (const TSharedPtr<FJsonValue>& Value : *Embedding)
+                        {
+                            Results[Index].Add(Value->AsNumber());
+                        }
+                    }
+
+                    UE_LOG(LogTemp, Verbose, TEXT("[LocalAIForNPCs | LLM | RAG] Batch of %d embeddings received."), NumTexts);
+                }
+                else
+                {
+                    UE_LOG(LogTemp, Error, TEXT("[LocalAIForNPCs | LLM | RAG] Invalid embedding batch response: %s"), *Content);
+                }
+            }
+            else
+            {
+                UE_LOG(LogTemp, Error, TEXT("[LocalAIForNPCs | LLM | RAG] Embedding batch request failed: %s"), Res.IsValid() ? *Res->GetContentAsString() : TEXT("No response"));
+            }
+
+            OnComplete(Results);
+        });
+
+    Request->ProcessRequest();
+}
+
+FString ULLMComponent::BuildKnowledgeKey() const
+{
+    // Everything that changes which chunks exist or how they are embedded and stored. Query-time settings such as
+    // EfSearch and the quantized rescore factor are passed with each search instead, so they do not split otherwise
+    // identical indices.
+    return FString::Printf(TEXT("%s|%d|%d|%d|%d|%s|%d|%d|%d|%d"),
+        *KnowledgePath, static_cast<int32>(RagMode), SentencesPerChunk, SentenceOverlap, EmbeddingPort, *EmbeddingModelName,
+        static_cast<int32>(EmbeddingQuantization),
+        static_cast<int32>(KnowledgeIndexType), HnswM, HnswEfConstruction);
+}
+
+FKnowledgeHandle ULLMComponent::BuildKnowledge(const FRagContext& Rag, const TFunction<void(int32, int32)>& OnProgress)
+{
+    const TArray<FString> Files = FKnowledgeChunker::FindKnowledgeFiles(Rag.KnowledgePath);
+    if (Files.Num() == 0)
+    {
+        UE_LOG(LogTemp, Error, TEXT("[LocalAIForNPCs | LLM | RAG] No documents found at: %s"), *Rag.KnowledgePath);
+        return nullptr;
+    }
+
+    TArray<FString> ChunkTexts = FKnowledgeChunker(Rag.SentencesPerChunk, Rag.SentenceOverlap).ChunkFiles(Files);
+    UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | RAG] Split %d document(s) into %d chunks."), Files.Num(), ChunkTexts.Num());
+
+    if (Rag.RagMode == ERagMode::Lexical)
+    {
+        TSharedPtr<FKnowledgeIndex, ESPMode::ThreadSafe> TextIndex = MakeShared<FKnowledgeIndex, ESPMode::ThreadSafe>();
+        for (const FString& Chunk : ChunkTexts)
+        {
+            TextIndex->AddText(Chunk);
+        }
+        TextIndex->BuildLexicalIndex();
+        return TextIndex;
     }
 
-    TArray<FString> Sentences;
-    FString AccumulatedSentence;
-    for (int32 i = 0; i < FileContent.Len(); ++i)
+    TSharedRef<FEmbeddingBatchState, ESPMode::ThreadSafe> State = MakeShared<FEmbeddingBatchState, ESPMode::ThreadSafe>();
+    State->Embeddings.SetNum(ChunkTexts.Num());
+
+    const int32 BatchSize = FMath::Max(1, Rag.EmbeddingBatchSize);
+    const int32 MaxInFlight = FMath::Max(1, Rag.MaxConcurrentEmbeddingRequests);
+    const int32 TotalChunks = ChunkTexts.Num();
+
+    // Only chunks whose (model, text) key is not in the persistent cache go to the embedding server.
+    TArray<uint64> ChunkKeys;
+    TArray<int32> MissingChunks;
+    FString CacheFile;
+    TSharedPtr<FEmbeddingCache, ESPMode::ThreadSafe> Store;
+    if (Rag.bUseEmbeddingCache)
     {
-        const TCHAR c = FileContent[i];
-        AccumulatedSentence.AppendChar(c);
-        if ((c == '.' || c == '!' || c == '?') && (i + 1 >= FileContent.Len() || FileContent[i + 1] == ' '
-            || FileContent[i + 1] == '\n' || FileContent[i + 1] == '\r' || FileContent[i + 1] == '\t'))
+        // Builds sharing the cache file share one store through the registry, so none of them overwrites the others.
+        CacheFile = GetEmbeddingCacheFile(Rag.EmbeddingModelId);
+        if (Rag.Registry.IsValid())
         {
-            FString S = AccumulatedSentence.TrimStartAndEnd();
-            if (!S.IsEmpty())
+            Store = Rag.Registry->GetEmbeddingStore(CacheFile, Rag.MaxEmbeddingCacheEntries);
+        }
+        else
+        {
+            Store = MakeShared<FEmbeddingCache, ESPMode::ThreadSafe>();
+            Store->SetMaxEntries(Rag.MaxEmbeddingCacheEntries);
+            Store->Load(CacheFile);
+        }
+
+        ChunkKeys.SetNumUninitialized(TotalChunks);
+        for (int32 i = 0; i < TotalChunks; i++)
+        {
+            ChunkKeys[i] = FEmbeddingCache::MakeKey(Rag.EmbeddingModelId, ChunkTexts[i]);
+            if (!Store->Find(ChunkKeys[i], State->Embeddings[i]))
             {
-                Sentences.Add(S);
+                MissingChunks.Add(i);
             }
-            AccumulatedSentence.Empty();
         }
+
+        UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | RAG] %d of %d chunks found in embedding cache."), TotalChunks - MissingChunks.Num(), TotalChunks);
     }
-    if (!AccumulatedSentence.TrimStartAndEnd().IsEmpty())
+    else
     {
-        Sentences.Add(AccumulatedSentence.TrimStartAndEnd());
+        MissingChunks.SetNumUninitialized(TotalChunks);
+        for (int32 i = 0; i < TotalChunks; i++)
+        {
+            MissingChunks[i] = i;
+        }
     }
 
-    int32 Step = FMath::Max(1, SentencesPerChunk - SentenceOverlap);
-    for (int32 i = 0; i < Sentences.Num(); i += Step)
+    const int32 NumMissing = MissingChunks.Num();
+    State->Completed.Set(TotalChunks - NumMissing);
+
+    for (int32 Start = 0; Start < NumMissing; Start += BatchSize)
     {
-        int32 EndIdx = FMath::Min(i + SentencesPerChunk, Sentences.Num());
+        while (State->InFlight.GetValue() >= MaxInFlight)
+        {
+            State->BatchDone->Wait();
+        }
 
-        FString ChunkText;
-        for (int32 j = i; j < EndIdx; j++)
+        const int32 Count = FMath::Min(BatchSize, NumMissing - Start);
+        TArray<int32> BatchIndices(MissingChunks.GetData() + Start, Count);
+        TArray<FString> Batch;
+        Batch.Reserve(Count);
+        for (int32 ChunkIndex : BatchIndices)
         {
-            if (!ChunkText.IsEmpty())
-                ChunkText += TEXT(" ");
-            ChunkText += Sentences[j];
+            Batch.Add(ChunkTexts[ChunkIndex]);
         }
 
-        TArray<float> Emb = EmbedText(ChunkText);
+        State->InFlight.Increment();
+        RequestEmbeddings(Rag, Batch, [State, OnProgress, BatchIndices = MoveTemp(BatchIndices), Count, TotalChunks](TArray<TArray<float>>& Results)
+            {
+                for (int32 i = 0; i < Results.Num() && i < Count; i++)
+                {
+                    State->Embeddings[BatchIndices[i]] = MoveTemp(Results[i]);
+                }
+
+                const int32 Done = State->Completed.Add(Count) + Count;
+                OnProgress(Done, TotalChunks);
 
-        FKnowledgeEntry Chunk;
-        Chunk.Text = ChunkText;
-        Chunk.Embedding = Emb;
-        Knowledge.Add(Chunk);
+                State->InFlight.Decrement();
+                State->BatchDone->Trigger();
+            });
     }
-    UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | RAG] Generated knowledge."));
-}
 
-float ULLMComponent::ComputeCosineSimilarity(const TArray<float>& A, const TArray<float>& B)
-{
-    if (A.Num() == 0 || B.Num() == 0 || A.Num() != B.Num())
+    while (State->InFlight.GetValue() > 0)
     {
-        UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | LLM | RAG] Invalid vectors for cosine similarity calculation"));
-        return 0;
+        State->BatchDone->Wait();
     }
-    double DotProduct = 0.0;
-    double NormA = 0.0;
-    double NormB = 0.0;
 
-    for (int32 i = 0; i < A.Num(); i++)
+    if (Store.IsValid() && NumMissing > 0)
     {
-        DotProduct += A[i] * B[i];
-        NormA += A[i] * A[i];
-        NormB += B[i] * B[i];
+        for (int32 ChunkIndex : MissingChunks)
+        {
+            Store->Add(ChunkKeys[ChunkIndex], State->Embeddings[ChunkIndex]);
+        }
+        Store->Save(CacheFile);
     }
 
-    double Denom = FMath::Sqrt(NormA) * FMath::Sqrt(NormB);
-    if (Denom <= KINDA_SMALL_NUMBER)
+    // The index now holds the vectors; the store is freed once no other build holds it, so they are not kept twice.
+    Store.Reset();
+
+    // Build into a fresh index and publish it in one step so queries never see a half-built matrix.
+    EEmbeddingStorage Storage = EEmbeddingStorage::Float;
+    if (Rag.EmbeddingQuantization == EEmbeddingQuantization::Int8)
+    {
+        Storage = EEmbeddingStorage::Int8;
+    }
+    else if (Rag.EmbeddingQuantization == EEmbeddingQuantization::Binary)
+    {
+        Storage = EEmbeddingStorage::Binary;
+    }
+
+    TSharedPtr<FKnowledgeIndex, ESPMode::ThreadSafe> NewIndex = MakeShared<FKnowledgeIndex, ESPMode::ThreadSafe>(Storage);
+    for (int32 i = 0; i < TotalChunks; i++)
+    {
+        if (State->Embeddings[i].Num() == 0)
+        {
+            UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | LLM | RAG] No embedding for chunk %d, skipping it."), i);
+            continue;
+        }
+
+        if (NewIndex->Num() == 0)
+        {
+            NewIndex->Reserve(State->Embeddings[i].Num(), TotalChunks);
+        }
+
+        if (!NewIndex->Add(ChunkTexts[i], State->Embeddings[i]))
+        {
+            UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | LLM | RAG] Invalid embedding for chunk %d, skipping it."), i);
+        }
+    }
+
+    UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | RAG] Knowledge vectors use %.1f KB for %d chunks."), NewIndex->GetVectorBytes() / 1024.0, NewIndex->Num());
+
+    if (Rag.KnowledgeIndexType == EKnowledgeIndexType::HNSW && NewIndex->Num() > 0)
+    {
+        const FString GraphFile = GetKnowledgeGraphFile(Rag.EmbeddingModelId, *NewIndex);
+        if (NewIndex->LoadGraph(GraphFile, Rag.Hnsw))
+        {
+            UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | RAG] Loaded HNSW index for %d chunks from %s"), NewIndex->Num(), *GraphFile);
+        }
+        else
+        {
+            const double StartTime = FPlatformTime::Seconds();
+            NewIndex->BuildGraph(Rag.Hnsw);
+            UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | RAG] Built HNSW index for %d chunks in %.2f s."), NewIndex->Num(), FPlatformTime::Seconds() - StartTime);
+
+            if (!NewIndex->SaveGraph(GraphFile))
+            {
+                UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | LLM | RAG] Failed to save HNSW index to %s"), *GraphFile);
+            }
+        }
+
+        if (Rag.HnswRecallQueries > 0)
+        {
+            const float Recall = NewIndex->MeasureGraphRecall(Rag.EmbeddingTopK, Rag.HnswRecallQueries, Rag.HnswEfSearch);
+            UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | RAG] HNSW recall@%d over %d queries: %.3f (EfSearch %d)"), Rag.EmbeddingTopK, FMath::Min(Rag.HnswRecallQueries, NewIndex->Num()), Recall, Rag.HnswEfSearch);
+        }
+    }
+
+    if (Rag.RagMode == ERagMode::Hybrid)
     {
-        return 0.0f;
+        NewIndex->BuildLexicalIndex();
     }
 
-    return static_cast<float>(DotProduct / Denom);
+    return NewIndex;
 }
 
-TArray<FString> ULLMComponent::GetTopKDocuments(const TArray<float>& QueryEmbedding)
+ULLMComponent::FRagContext ULLMComponent::MakeRagContext() const
+{
+    FRagContext Rag;
+    Rag.RagMode = RagMode;
+    Rag.EmbeddingPort = EmbeddingPort;
+    Rag.RerankerPort = RerankerPort;
+    Rag.KnowledgePath = KnowledgePath;
+    Rag.EmbeddingTopK = EmbeddingTopK;
+    Rag.RerankingTopN = RerankingTopN;
+    Rag.SentencesPerChunk = SentencesPerChunk;
+    Rag.SentenceOverlap = SentenceOverlap;
+    Rag.SimilarityThreshold = SimilarityThreshold;
+    Rag.LexicalScoreThreshold = LexicalScoreThreshold;
+    Rag.LexicalWeight = LexicalWeight;
+    Rag.EmbeddingBatchSize = EmbeddingBatchSize;
+    Rag.MaxConcurrentEmbeddingRequests = MaxConcurrentEmbeddingRequests;
+    Rag.KnowledgeIndexType = KnowledgeIndexType;
+    Rag.Hnsw.M = HnswM;
+    Rag.Hnsw.EfConstruction = HnswEfConstruction;
+    Rag.HnswEfSearch = FMath::Max(1, HnswEfSearch);
+    Rag.HnswRecallQueries = HnswRecallQueries;
+    Rag.EmbeddingQuantization = EmbeddingQuantization;
+    Rag.QuantizedRescoreFactor = QuantizedRescoreFactor;
+    Rag.bUseEmbeddingCache = bUseEmbeddingCache;
+    Rag.EmbeddingModelName = EmbeddingModelName;
+    Rag.EmbeddingModelId = EmbeddingModelId;
+    Rag.MaxEmbeddingCacheEntries = MaxEmbeddingCacheEntries;
+    Rag.EmbeddingCache = EmbeddingCache;
+    Rag.KnowledgeIndex = KnowledgeIndex;
+    if (UKnowledgeSubsystem* Subsystem = KnowledgeSubsystem.Get())
+    {
+        Rag.Registry = Subsystem->GetRegistry();
+    }
+    return Rag;
+}
+
+TArray<FString> ULLMComponent::GetTopKDocuments(const FRagContext& Rag, const FString& Query, const TArray<float>& QueryEmbedding)
 {
     TArray<FString> TopChunks;
 
-    if (Knowledge.Num() == 0 || QueryEmbedding.Num() == 0)
+    const FKnowledgeHandle& Index = Rag.KnowledgeIndex;
+    if (!Index.IsValid() || Index->Num() == 0 || (Rag.RagMode != ERagMode::Lexical && QueryEmbedding.Num() == 0))
     {
         UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | LLM | RAG] No knowledge available or query embedding is empty."));
         return TopChunks;
     }
 
-    struct FScoredChunk
+    TArray<FKnowledgeMatch> Matches;
+    switch (Rag.RagMode)
     {
-        float Score;
-        FString Text;
-    };
-
-    TArray<FScoredChunk> ScoredChunks;
-    ScoredChunks.Reserve(Knowledge.Num());
-
-    for (const FKnowledgeEntry& Entry : Knowledge)
-    {
-        float Similarity = ComputeCosineSimilarity(QueryEmbedding, Entry.Embedding);
-        ScoredChunks.Add({ Similarity, Entry.Text });
+    case ERagMode::Lexical:
+        Index->SearchLexical(Query, Rag.EmbeddingTopK, Rag.LexicalScoreThreshold, Matches);
+        break;
+    case ERagMode::Hybrid:
+        Index->SearchHybrid(QueryEmbedding, Query, Rag.EmbeddingTopK, Rag.LexicalWeight, Rag.SimilarityThreshold, Rag.LexicalScoreThreshold, Matches, Rag.HnswEfSearch, Rag.QuantizedRescoreFactor);
+        break;
+    default:
+        Index->Search(QueryEmbedding, Rag.EmbeddingTopK, Rag.SimilarityThreshold, Matches, Rag.HnswEfSearch, Rag.QuantizedRescoreFactor);
+        break;
     }
 
-    ScoredChunks.Sort([](const FScoredChunk& A, const FScoredChunk& B)
-        {
-            return A.Score > B.Score;
-        });
-
-    int32 Count = FMath::Min(EmbeddingTopK, ScoredChunks.Num());
-    for (int32 i = 0; i < Count; i++)
+    TopChunks.Reserve(Matches.Num());
+    for (const FKnowledgeMatch& Match : Matches)
     {
-        if (ScoredChunks[i].Score >= SimilarityThreshold)
-        {
-            TopChunks.Add(ScoredChunks[i].Text);
-        }
+        TopChunks.Emplace(Index->GetText(Match.Index));
     }
 
-    UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | RAG] Selected top-%d chunks out of %d knowledge entries."), Count, ScoredChunks.Num());
+    UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | RAG] Selected top-%d chunks out of %d knowledge entries."), TopChunks.Num(), Index->Num());
 
     return TopChunks;
 }
 
-TArray<FString> ULLMComponent::RerankDocuments(const FString& Query, const TArray<FString>& Documents)
+TArray<FString> ULLMComponent::RerankDocuments(const FRagContext& Rag, const FString& Query, const TArray<FString>& Documents, const FCancellationTokenPtr& Token)
 {
     TArray<FString> RerankedDocs;
 
+    if (Token && Token->IsCancelled())
+    {
+        return RerankedDocs;
+    }
+
     if (Documents.Num() == 0)
     {
         UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | LLM | RAG] No documents provided for reranking."));
@@ -822,7 +1629,7 @@ TArray<FString> ULLMComponent::RerankDocuments(const FString& Query, const TArra
 
     TSharedPtr<FJsonObject> JsonRequest = MakeShared<FJsonObject>();
     JsonRequest->SetStringField("query", Query);
-    JsonRequest->SetNumberField("top_n", RerankingTopN);
+    JsonRequest->SetNumberField("top_n", Rag.RerankingTopN);
 
     TArray<TSharedPtr<FJsonValue>> JsonDocs;
     for (const FString& Doc : Documents)
@@ -835,7 +1642,7 @@ TArray<FString> ULLMComponent::RerankDocuments(const FString& Query, const TArra
     TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&RequestString);
     FJsonSerializer::Serialize(JsonRequest.ToSharedRef(), Writer);
 
-    FString Url = FString::Printf(TEXT("http://localhost:%d/v1/rerank"), RerankerPort);
+    FString Url = FString::Printf(TEXT("http://localhost:%d/v1/rerank"), Rag.RerankerPort);
     TSharedRef<IHttpRequest, ESPMode::ThreadSafe> Request = FHttpModule::Get().CreateRequest();
     Request->SetURL(Url);
     Request->SetVerb(TEXT("POST"));
@@ -884,7 +1691,7 @@ TArray<FString> ULLMComponent::RerankDocuments(const FString& Query, const TArra
                                 return A.Score > B.Score;
                             });
 
-                        int32 Count = FMath::Min(RerankingTopN, ScoredDocs.Num());
+                        int32 Count = FMath::Min(Rag.RerankingTopN, ScoredDocs.Num());
                         for (int32 i = 0; i < Count; i++)
                         {
                             int32 DocIdx = ScoredDocs[i].Index;
@@ -918,16 +1725,23 @@ TArray<FString> ULLMComponent::RerankDocuments(const FString& Query, const TArra
             CompletionEvent->Trigger();
         });
 
-    Request->ProcessRequest();
-    UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | RAG] Rerank request sent to %s"), *Url);
+    {
+        FCancellationScope CancelScope(Token, [Request]()
+            {
+                Request->CancelRequest();
+            });
 
-    CompletionEvent->Wait();
+        Request->ProcessRequest();
+        UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | LLM | RAG] Rerank request sent to %s"), *Url);
+
+        CompletionEvent->Wait();
+    }
     FPlatformProcess::ReturnSynchEventToPool(CompletionEvent);
 
     if (RerankedDocs.Num() == 0)
     {
         UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | LLM | RAG] No documents returned from reranker. Returning embedding mode results."));
-        for (int i = 0; i < FMath::Min(RerankingTopN, Documents.Num()); i++)
+        for (int i = 0; i < FMath::Min(Rag.RerankingTopN, Documents.Num()); i++)
         {
             RerankedDocs.Add(Documents[i]);
         }
@@ -984,6 +1798,26 @@ void ULLMComponent::HandleNpcAction(const FString& ActionCommand)
 FString ULLMComponent::BuildActionsSystemMessage()
 {
     FString Message;
+
+    if (!ActionGrammar.IsEmpty())
+    {
+        // The grammar already enforces the tag format and the valid names, so only their meaning is needed.
+        Message += TEXT("You can perform actions by inserting [[action: <action> <object>]] tags into your dialogue when suitable.\n");
+        Message += TEXT("Actions:\n");
+        for (const auto& Action : KnownActions)
+        {
+            Message += FString::Printf(TEXT("- %s%s: %s\n"), *Action.Name, Action.bHasTargetObject ? TEXT(" <object>") : TEXT(""), *Action.Description);
+        }
+
+        Message += TEXT("Objects:\n");
+        for (const auto& Object : KnownObjects)
+        {
+            Message += FString::Printf(TEXT("- %s: %s\n"), *Object.Name, *Object.Description);
+        }
+
+        return Message;
+    }
+
     Message += TEXT("You can do two things:\n");
     Message += TEXT("1. Speak normally as dialogue with the user.\n");
     Message += TEXT("2. Perform actions by inserting action tags directly into your dialogue, if suitable in the current context.\n\n");
@@ -1013,4 +1847,75 @@ FString ULLMComponent::BuildActionsSystemMessage()
     }
 
     return Message;
+}
+
+FString ULLMComponent::BuildActionGrammar() const
+{
+    auto AppendLiteral = [](FString& Out, const FString& Text)
+        {
+            Out.AppendChar('"');
+            for (const TCHAR c : Text)
+            {
+                switch (c)
+                {
+                case '"':  Out += TEXT("\\\""); break;
+                case '\\': Out += TEXT("\\\\"); break;
+                case '\n': Out += TEXT("\\n"); break;
+                case '\r': Out += TEXT("\\r"); break;
+                default:   Out.AppendChar(c); break;
+                }
+            }
+            Out.AppendChar('"');
+        };
+
+    FString Objects;
+    for (const FNpcObject& Object : KnownObjects)
+    {
+        if (Object.Name.IsEmpty())
+        {
+            continue;
+        }
+        if (!Objects.IsEmpty())
+        {
+            Objects += TEXT(" | ");
+        }
+        AppendLiteral(Objects, Object.Name);
+    }
+
+    FString Commands;
+    for (const FNpcAction& Action : KnownActions)
+    {
+        if (Action.Name.IsEmpty() || (Action.bHasTargetObject && Objects.IsEmpty()))
+        {
+            continue;
+        }
+        if (!Commands.IsEmpty())
+        {
+            Commands += TEXT(" | ");
+        }
+        AppendLiteral(Commands, Action.bHasTargetObject ? Action.Name + TEXT(" ") : Action.Name);
+        if (Action.bHasTargetObject)
+        {
+            Commands += TEXT(" object");
+        }
+    }
+
+    if (Commands.IsEmpty())
+    {
+        UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | LLM | Actions] No action can be expressed with the known objects, generation will not be constrained."));
+        return FString();
+    }
+
+    // Dialogue may not contain '[', '*' or '<', so the only bracketed text the model can produce is a valid
+    // action tag, and stage directions the sanitizer would strip are never generated.
+    FString Grammar;
+    Grammar += TEXT("root ::= text (action text)*\n");
+    Grammar += TEXT("text ::= [^\\[*<]*\n");
+    Grammar += TEXT("action ::= \"[[action: \" command \"]]\"\n");
+    Grammar += TEXT("command ::= ") + Commands + TEXT("\n");
+    if (!Objects.IsEmpty())
+    {
+        Grammar += TEXT("object ::= ") + Objects + TEXT("\n");
+    }
+    return Grammar;
 }
\ No newline at end of file
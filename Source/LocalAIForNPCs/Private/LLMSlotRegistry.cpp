@@ -0,0 +1,95 @@
+#include "LLMSlotRegistry.h"
+
+FLLMSlotRegistry& FLLMSlotRegistry::Get()
+{
+    static FLLMSlotRegistry Instance;
+    return Instance;
+}
+
+int32 FLLMSlotRegistry::AcquireSlot(int32 Port, int32 NumSlots, int32 PreferredSlot)
+{
+    FScopeLock Lock(&Mutex);
+
+    TArray<FSlotState>& Slots = SlotsByPort.FindOrAdd(Port);
+    const int32 RequiredSlots = FMath::Max3(1, NumSlots, PreferredSlot + 1);
+    if (Slots.Num() < RequiredSlots)
+    {
+        Slots.SetNum(RequiredSlots);
+    }
+
+    int32 Slot = PreferredSlot;
+    if (Slot < 0)
+    {
+        Slot = 0;
+        for (int32 i = 1; i < FMath::Max(1, NumSlots); i++)
+        {
+            if (Slots[i].NumUsers < Slots[Slot].NumUsers)
+            {
+                Slot = i;
+            }
+        }
+    }
+
+    Slots[Slot].NumUsers++;
+    return Slot;
+}
+
+void FLLMSlotRegistry::ReleaseSlot(int32 Port, int32 Slot)
+{
+    FScopeLock Lock(&Mutex);
+
+    if (TArray<FSlotState>* Slots = SlotsByPort.Find(Port))
+    {
+        if (Slots->IsValidIndex(Slot) && (*Slots)[Slot].NumUsers > 0)
+        {
+            (*Slots)[Slot].NumUsers--;
+        }
+    }
+}
+
+bool FLLMSlotRegistry::MarkServed(int32 Port, int32 Slot, const FGuid& ConversationId)
+{
+    FScopeLock Lock(&Mutex);
+
+    TArray<FSlotState>* Slots = SlotsByPort.Find(Port);
+    if (!Slots || !Slots->IsValidIndex(Slot))
+    {
+        return false;
+    }
+
+    const bool bWarm = (*Slots)[Slot].LastConversation == ConversationId;
+    (*Slots)[Slot].LastConversation = ConversationId;
+    return bWarm;
+}
+
+bool FLLMSlotRegistry::IsServing(int32 Port, int32 Slot, const FGuid& ConversationId)
+{
+    FScopeLock Lock(&Mutex);
+
+    const TArray<FSlotState>* Slots = SlotsByPort.Find(Port);
+    return Slots && Slots->IsValidIndex(Slot) && (*Slots)[Slot].LastConversation == ConversationId;
+}
+
+bool FLLMSlotRegistry::TryBeginWarmUp(int32 Port, int32 MaxInFlight)
+{
+    FScopeLock Lock(&Mutex);
+
+    int32& InFlight = WarmUpsByPort.FindOrAdd(Port);
+    if (InFlight >= MaxInFlight)
+    {
+        return false;
+    }
+
+    InFlight++;
+    return true;
+}
+
+void FLLMSlotRegistry::EndWarmUp(int32 Port)
+{
+    FScopeLock Lock(&Mutex);
+
+    if (int32* InFlight = WarmUpsByPort.Find(Port))
+    {
+        *InFlight = FMath::Max(0, *InFlight - 1);
+    }
+}
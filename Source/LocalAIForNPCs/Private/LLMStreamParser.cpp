@@ -0,0 +1,572 @@
+#include "LLMStreamParser.h"
+
+namespace
+{
+    constexpr int32 MaxErrorBodySize = 4096;
+
+    struct FJsonCursor
+    {
+        const ANSICHAR* Ptr;
+        const ANSICHAR* End;
+    };
+
+    void SkipWhitespace(FJsonCursor& C)
+    {
+        while (C.Ptr < C.End && (*C.Ptr == ' ' || *C.Ptr == '\t' || *C.Ptr == '\n' || *C.Ptr == '\r'))
+        {
+            ++C.Ptr;
+        }
+    }
+
+    bool SkipString(FJsonCursor& C)
+    {
+        ++C.Ptr;
+        while (C.Ptr < C.End)
+        {
+            if (*C.Ptr == '\\')
+            {
+                C.Ptr += 2;
+            }
+            else if (*C.Ptr == '"')
+            {
+                ++C.Ptr;
+                return true;
+            }
+            else
+            {
+                ++C.Ptr;
+            }
+        }
+        return false;
+    }
+
+    bool SkipValue(FJsonCursor& C)
+    {
+        if (C.Ptr >= C.End)
+        {
+            return false;
+        }
+
+        if (*C.Ptr == '"')
+        {
+            return SkipString(C);
+        }
+
+        if (*C.Ptr == '{' || *C.Ptr == '[')
+        {
+            int32 Depth = 0;
+            while (C.Ptr < C.End)
+            {
+                const ANSICHAR Ch = *C.Ptr;
+                if (Ch == '"')
+                {
+                    if (!SkipString(C))
+                    {
+                        return false;
+                    }
+                    continue;
+                }
+                if (Ch == '{' || Ch == '[')
+                {
+                    ++Depth;
+                }
+                else if (Ch == '}' || Ch == ']')
+                {
+                    if (--Depth == 0)
+                    {
+                        ++C.Ptr;
+                        return true;
+                    }
+                }
+                ++C.Ptr;
+            }
+            return false;
+        }
+
+        while (C.Ptr < C.End && *C.Ptr != ',' && *C.Ptr != '}' && *C.Ptr != ']'
+            && *C.Ptr != ' ' && *C.Ptr != '\t' && *C.Ptr != '\n' && *C.Ptr != '\r')
+        {
+            ++C.Ptr;
+        }
+        return true;
+    }
+
+    // Positions the cursor on the value of Key inside the object starting at the cursor.
+    bool FindObjectField(FJsonCursor& C, const ANSICHAR* Key, int32 KeyLen)
+    {
+        SkipWhitespace(C);
+        if (C.Ptr >= C.End || *C.Ptr != '{')
+        {
+            return false;
+        }
+        ++C.Ptr;
+
+        while (true)
+        {
+            SkipWhitespace(C);
+            if (C.Ptr >= C.End || *C.Ptr != '"')
+            {
+                return false;
+            }
+
+            const ANSICHAR* KeyStart = C.Ptr + 1;
+            if (!SkipString(C))
+            {
+                return false;
+            }
+            const int32 FoundLen = static_cast<int32>(C.Ptr - 1 - KeyStart);
+
+            SkipWhitespace(C);
+            if (C.Ptr >= C.End || *C.Ptr != ':')
+            {
+                return false;
+            }
+            ++C.Ptr;
+            SkipWhitespace(C);
+
+            if (FoundLen == KeyLen && FMemory::Memcmp(KeyStart, Key, KeyLen) == 0)
+            {
+                return true;
+            }
+
+            if (!SkipValue(C))
+            {
+                return false;
+            }
+
+            SkipWhitespace(C);
+            if (C.Ptr < C.End && *C.Ptr == ',')
+            {
+                ++C.Ptr;
+                continue;
+            }
+            return false;
+        }
+    }
+
+    void AppendCodePoint(TArray<ANSICHAR>& Out, uint32 CodePoint)
+    {
+        if (CodePoint < 0x80)
+        {
+            Out.Add(static_cast<ANSICHAR>(CodePoint));
+        }
+        else if (CodePoint < 0x800)
+        {
+            Out.Add(static_cast<ANSICHAR>(0xC0 | (CodePoint >> 6)));
+            Out.Add(static_cast<ANSICHAR>(0x80 | (CodePoint & 0x3F)));
+        }
+        else if (CodePoint < 0x10000)
+        {
+            Out.Add(static_cast<ANSICHAR>(0xE0 | (CodePoint >> 12)));
+            Out.Add(static_cast<ANSICHAR>(0x80 | ((CodePoint >> 6) & 0x3F)));
+            Out.Add(static_cast<ANSICHAR>(0x80 | (CodePoint & 0x3F)));
+        }
+        else
+        {
+            Out.Add(static_cast<ANSICHAR>(0xF0 | (CodePoint >> 18)));
+            Out.Add(static_cast<ANSICHAR>(0x80 | ((CodePoint >> 12) & 0x3F)));
+            Out.Add(static_cast<ANSICHAR>(0x80 | ((CodePoint >> 6) & 0x3F)));
+            Out.Add(static_cast<ANSICHAR>(0x80 | (CodePoint & 0x3F)));
+        }
+    }
+
+    bool ParseHex4(const ANSICHAR* Ptr, const ANSICHAR* End, uint32& OutValue)
+    {
+        if (End - Ptr < 4)
+        {
+            return false;
+        }
+
+        OutValue = 0;
+        for (int32 i = 0; i < 4; i++)
+        {
+            const ANSICHAR Ch = Ptr[i];
+            OutValue <<= 4;
+            if (Ch >= '0' && Ch <= '9')
+            {
+                OutValue |= Ch - '0';
+            }
+            else if (Ch >= 'a' && Ch <= 'f')
+            {
+                OutValue |= Ch - 'a' + 10;
+            }
+            else if (Ch >= 'A' && Ch <= 'F')
+            {
+                OutValue |= Ch - 'A' + 10;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Decodes the JSON string at the cursor into UTF-8, resolving escape sequences.
+    bool DecodeString(FJsonCursor& C, TArray<ANSICHAR>& Out)
+    {
+        if (C.Ptr >= C.End || *C.Ptr != '"')
+        {
+            return false;
+        }
+        ++C.Ptr;
+
+        while (C.Ptr < C.End)
+        {
+            const ANSICHAR* RunStart = C.Ptr;
+            while (C.Ptr < C.End && *C.Ptr != '"' && *C.Ptr != '\\')
+            {
+                ++C.Ptr;
+            }
+            Out.Append(RunStart, static_cast<int32>(C.Ptr - RunStart));
+
+            if (C.Ptr >= C.End)
+            {
+                return false;
+            }
+
+            if (*C.Ptr == '"')
+            {
+                ++C.Ptr;
+                return true;
+            }
+
+            if (C.Ptr + 1 >= C.End)
+            {
+                return false;
+            }
+
+            const ANSICHAR Escape = C.Ptr[1];
+            C.Ptr += 2;
+            switch (Escape)
+            {
+            case '"':  Out.Add('"'); break;
+            case '\\': Out.Add('\\'); break;
+            case '/':  Out.Add('/'); break;
+            case 'b':  Out.Add('\b'); break;
+            case 'f':  Out.Add('\f'); break;
+            case 'n':  Out.Add('\n'); break;
+            case 'r':  Out.Add('\r'); break;
+            case 't':  Out.Add('\t'); break;
+            case 'u':
+            {
+                uint32 CodePoint;
+                if (!ParseHex4(C.Ptr, C.End, CodePoint))
+                {
+                    return false;
+                }
+                C.Ptr += 4;
+
+                if (CodePoint >= 0xD800 && CodePoint <= 0xDBFF)
+                {
+                    uint32 Low;
+                    if (C.End - C.Ptr >= 6 && C.Ptr[0] == '\\' && C.Ptr[1] == 'u' && ParseHex4(C.Ptr + 2, C.End, Low)
+                        && Low >= 0xDC00 && Low <= 0xDFFF)
+                    {
+                        CodePoint = 0x10000 + ((CodePoint - 0xD800) << 10) + (Low - 0xDC00);
+                        C.Ptr += 6;
+                    }
+                    else
+                    {
+                        CodePoint = 0xFFFD;
+                    }
+                }
+                else if (CodePoint >= 0xDC00 && CodePoint <= 0xDFFF)
+                {
+                    CodePoint = 0xFFFD;
+                }
+
+                AppendCodePoint(Out, CodePoint);
+                break;
+            }
+            default:
+                return false;
+            }
+        }
+
+        return false;
+    }
+
+    bool StartsWith(const ANSICHAR* Line, int32 Len, const ANSICHAR* Prefix, int32 PrefixLen)
+    {
+        return Len >= PrefixLen && FCStringAnsi::Strnicmp(Line, Prefix, PrefixLen) == 0;
+    }
+}
+
+FLLMStreamParser::FLLMStreamParser()
+{
+    Reset();
+}
+
+void FLLMStreamParser::Reset()
+{
+    State = EState::StatusLine;
+    bChunked = false;
+    bDone = false;
+    bError = false;
+    StatusCode = 0;
+    ChunkRemaining = 0;
+
+    ProtocolLine.Reset();
+    EventLine.Reset();
+    TokenUtf8.Reset();
+    ErrorBody.Reset();
+}
+
+bool FLLMStreamParser::Feed(const uint8* Data, int32 NumBytes, TArray<FString>& OutTokens)
+{
+    int32 Pos = 0;
+
+    while (Pos < NumBytes && State != EState::Finished)
+    {
+        switch (State)
+        {
+        case EState::StatusLine:
+        case EState::Headers:
+        case EState::ChunkSize:
+        case EState::ChunkDataEnd:
+        {
+            int32 LineEnd = Pos;
+            while (LineEnd < NumBytes && Data[LineEnd] != '\n')
+            {
+                ++LineEnd;
+            }
+
+            ProtocolLine.Append(reinterpret_cast<const ANSICHAR*>(Data + Pos), LineEnd - Pos);
+            if (LineEnd >= NumBytes)
+            {
+                Pos = NumBytes;
+                break;
+            }
+            Pos = LineEnd + 1;
+
+            if (ProtocolLine.Num() > 0 && ProtocolLine.Last() == '\r')
+            {
+                ProtocolLine.Pop(EAllowShrinking::No);
+            }
+            const int32 LineLen = ProtocolLine.Num();
+            ProtocolLine.Add('\0');
+
+            if (State == EState::StatusLine)
+            {
+                const ANSICHAR* Space = FCStringAnsi::Strchr(ProtocolLine.GetData(), ' ');
+                StatusCode = Space ? FCStringAnsi::Atoi(Space + 1) : 0;
+                bError = StatusCode != 200;
+                State = EState::Headers;
+            }
+            else if (State == EState::Headers)
+            {
+                if (LineLen == 0)
+                {
+                    State = bChunked ? EState::ChunkSize : EState::Body;
+                }
+                else
+                {
+                    ProcessHeaderLine(ProtocolLine.GetData(), LineLen);
+                }
+            }
+            else if (State == EState::ChunkSize)
+            {
+                if (LineLen > 0)
+                {
+                    ChunkRemaining = FCStringAnsi::Strtoi64(ProtocolLine.GetData(), nullptr, 16);
+                    if (ChunkRemaining <= 0)
+                    {
+                        ConsumeBody(reinterpret_cast<const uint8*>("\n"), 1, OutTokens);
+                        State = EState::Finished;
+                        bDone = true;
+                    }
+                    else
+                    {
+                        State = EState::ChunkData;
+                    }
+                }
+            }
+            else
+            {
+                State = EState::ChunkSize;
+            }
+
+            ProtocolLine.Reset();
+            break;
+        }
+        case EState::ChunkData:
+        {
+            const int32 Count = static_cast<int32>(FMath::Min<int64>(ChunkRemaining, NumBytes - Pos));
+            ConsumeBody(Data + Pos, Count, OutTokens);
+            Pos += Count;
+            ChunkRemaining -= Count;
+            if (ChunkRemaining == 0 && State == EState::ChunkData)
+            {
+                State = EState::ChunkDataEnd;
+            }
+            break;
+        }
+        case EState::Body:
+        {
+            ConsumeBody(Data + Pos, NumBytes - Pos, OutTokens);
+            Pos = NumBytes;
+            break;
+        }
+        default:
+            Pos = NumBytes;
+            break;
+        }
+    }
+
+    return bDone;
+}
+
+void FLLMStreamParser::ProcessHeaderLine(const ANSICHAR* Line, int32 Len)
+{
+    static const ANSICHAR TransferEncoding[] = "Transfer-Encoding:";
+    constexpr int32 TransferEncodingLen = UE_ARRAY_COUNT(TransferEncoding) - 1;
+
+    if (StartsWith(Line, Len, TransferEncoding, TransferEncodingLen))
+    {
+        for (int32 i = TransferEncodingLen; i + 7 <= Len; i++)
+        {
+            if (FCStringAnsi::Strnicmp(Line + i, "chunked", 7) == 0)
+            {
+                bChunked = true;
+                break;
+            }
+        }
+    }
+}
+
+void FLLMStreamParser::ConsumeBody(const uint8* Data, int32 NumBytes, TArray<FString>& OutTokens)
+{
+    const ANSICHAR* Bytes = reinterpret_cast<const ANSICHAR*>(Data);
+
+    if (bError)
+    {
+        const int32 Count = FMath::Min(NumBytes, MaxErrorBodySize - ErrorBody.Num());
+        if (Count > 0)
+        {
+            ErrorBody.Append(Bytes, Count);
+        }
+        return;
+    }
+
+    int32 Pos = 0;
+    while (Pos < NumBytes && State != EState::Finished)
+    {
+        int32 LineEnd = Pos;
+        while (LineEnd < NumBytes && Bytes[LineEnd] != '\n')
+        {
+            ++LineEnd;
+        }
+
+        if (LineEnd >= NumBytes)
+        {
+            EventLine.Append(Bytes + Pos, NumBytes - Pos);
+            return;
+        }
+
+        if (EventLine.Num() > 0)
+        {
+            EventLine.Append(Bytes + Pos, LineEnd - Pos);
+            ProcessLine(EventLine.GetData(), EventLine.Num(), OutTokens);
+            EventLine.Reset();
+        }
+        else
+        {
+            ProcessLine(Bytes + Pos, LineEnd - Pos, OutTokens);
+        }
+
+        Pos = LineEnd + 1;
+    }
+}
+
+void FLLMStreamParser::ProcessLine(const ANSICHAR* Line, int32 Len, TArray<FString>& OutTokens)
+{
+    if (Len > 0 && Line[Len - 1] == '\r')
+    {
+        --Len;
+    }
+
+    if (Len == 0)
+    {
+        return;
+    }
+
+    if (!StartsWith(Line, Len, "data:", 5))
+    {
+        if (StartsWith(Line, Len, "error:", 6))
+        {
+            FUTF8ToTCHAR Converted(Line, Len);
+            UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | LLM] Server reported an error: %s"), *FString(Converted.Length(), Converted.Get()));
+        }
+        return;
+    }
+
+    const ANSICHAR* Payload = Line + 5;
+    const ANSICHAR* PayloadEnd = Line + Len;
+    while (Payload < PayloadEnd && (*Payload == ' ' || *Payload == '\t'))
+    {
+        ++Payload;
+    }
+    while (PayloadEnd > Payload && (PayloadEnd[-1] == ' ' || PayloadEnd[-1] == '\t'))
+    {
+        --PayloadEnd;
+    }
+    const int32 PayloadLen = static_cast<int32>(PayloadEnd - Payload);
+
+    if (PayloadLen == 6 && FMemory::Memcmp(Payload, "[DONE]", 6) == 0)
+    {
+        bDone = true;
+        State = EState::Finished;
+        return;
+    }
+
+    TokenUtf8.Reset();
+    if (!ExtractDeltaContent(Payload, PayloadLen, TokenUtf8))
+    {
+        UE_LOG(LogTemp, Verbose, TEXT("[LocalAIForNPCs | LLM] Streamed event without delta content."));
+        return;
+    }
+
+    if (TokenUtf8.Num() == 0)
+    {
+        return;
+    }
+
+    FUTF8ToTCHAR Converted(TokenUtf8.GetData(), TokenUtf8.Num());
+    OutTokens.Emplace(Converted.Length(), Converted.Get());
+}
+
+FString FLLMStreamParser::GetErrorBody() const
+{
+    FUTF8ToTCHAR Converted(ErrorBody.GetData(), ErrorBody.Num());
+    return FString(Converted.Length(), Converted.Get());
+}
+
+bool FLLMStreamParser::ExtractDeltaContent(const ANSICHAR* Json, int32 Len, TArray<ANSICHAR>& OutUtf8)
+{
+    FJsonCursor C{ Json, Json + Len };
+
+    if (!FindObjectField(C, "choices", 7))
+    {
+        return false;
+    }
+
+    SkipWhitespace(C);
+    if (C.Ptr >= C.End || *C.Ptr != '[')
+    {
+        return false;
+    }
+    ++C.Ptr;
+
+    if (!FindObjectField(C, "delta", 5) || !FindObjectField(C, "content", 7))
+    {
+        return false;
+    }
+
+    if (C.Ptr >= C.End || *C.Ptr != '"')
+    {
+        return false;
+    }
+
+    return DecodeString(C, OutUtf8);
+}
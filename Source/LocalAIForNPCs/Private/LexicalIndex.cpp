@@ -0,0 +1,194 @@
+#include "LexicalIndex.h"
+#include "KnowledgeIndex.h"
+
+bool FLexicalIndex::IsStopWord(const FString& Token)
+{
+    static const TSet<FString> StopWords = {
+        TEXT("a"), TEXT("an"), TEXT("the"), TEXT("and"), TEXT("or"), TEXT("but"), TEXT("if"), TEXT("so"), TEXT("of"),
+        TEXT("to"), TEXT("in"), TEXT("on"), TEXT("at"), TEXT("by"), TEXT("for"), TEXT("with"), TEXT("from"), TEXT("about"),
+        TEXT("as"), TEXT("into"), TEXT("than"), TEXT("then"), TEXT("is"), TEXT("are"), TEXT("was"), TEXT("were"), TEXT("be"),
+        TEXT("been"), TEXT("am"), TEXT("do"), TEXT("does"), TEXT("did"), TEXT("have"), TEXT("has"), TEXT("had"), TEXT("can"),
+        TEXT("could"), TEXT("will"), TEXT("would"), TEXT("should"), TEXT("may"), TEXT("might"), TEXT("must"), TEXT("i"),
+        TEXT("me"), TEXT("my"), TEXT("you"), TEXT("your"), TEXT("he"), TEXT("him"), TEXT("his"), TEXT("she"), TEXT("her"),
+        TEXT("it"), TEXT("its"), TEXT("we"), TEXT("us"), TEXT("our"), TEXT("they"), TEXT("them"), TEXT("their"), TEXT("this"),
+        TEXT("that"), TEXT("these"), TEXT("those"), TEXT("there"), TEXT("here"), TEXT("what"), TEXT("which"), TEXT("who"),
+        TEXT("whom"), TEXT("how"), TEXT("why"), TEXT("when"), TEXT("where"), TEXT("not"), TEXT("no"), TEXT("yes"), TEXT("all"),
+        TEXT("any"), TEXT("some"), TEXT("just"), TEXT("very"), TEXT("too"), TEXT("also"), TEXT("s"), TEXT("t"), TEXT("m"),
+        TEXT("re"), TEXT("ll"), TEXT("ve"), TEXT("d"), TEXT("hello"), TEXT("hi"), TEXT("hey"), TEXT("please"), TEXT("thanks"),
+        TEXT("thank"), TEXT("ok"), TEXT("okay"), TEXT("well"), TEXT("oh")
+    };
+    return StopWords.Contains(Token);
+}
+
+FLexicalIndex::FLexicalIndex(float InK1, float InB)
+    : K1(InK1)
+    , B(InB)
+{
+}
+
+void FLexicalIndex::Tokenize(FStringView Text, TFunctionRef<void(const FString&)> Visit)
+{
+    FString Token;
+    Token.Reserve(64);
+    for (TCHAR c : Text)
+    {
+        if (FChar::IsAlnum(c) || c == '_')
+        {
+            Token.AppendChar(FChar::ToLower(c));
+        }
+        else if (Token.Len() > 0)
+        {
+            Visit(Token);
+            Token.Reset();
+        }
+    }
+    if (Token.Len() > 0)
+    {
+        Visit(Token);
+    }
+}
+
+void FLexicalIndex::Add(FStringView Text)
+{
+    const int32 Doc = DocLengths.Num();
+    int32 Length = 0;
+
+    Tokenize(Text, [this, Doc, &Length](const FString& Token)
+        {
+            Length++;
+
+            int32* TermId = TermIds.Find(Token);
+            if (!TermId)
+            {
+                TermId = &TermIds.Add(Token, PendingPostings.Num());
+                PendingPostings.AddDefaulted();
+            }
+
+            TArray<FPosting>& TermPostings = PendingPostings[*TermId];
+            if (TermPostings.Num() > 0 && TermPostings.Last().Doc == Doc)
+            {
+                TermPostings.Last().TermFrequency++;
+            }
+            else
+            {
+                TermPostings.Add({ Doc, 1 });
+            }
+        });
+
+    DocLengths.Add(Length);
+}
+
+void FLexicalIndex::Finalize()
+{
+    int64 TotalLength = 0;
+    for (int32 Length : DocLengths)
+    {
+        TotalLength += Length;
+    }
+    AverageDocLength = DocLengths.Num() > 0 ? static_cast<float>(TotalLength) / DocLengths.Num() : 0.0f;
+
+    if (PendingPostings.Num() == 0)
+    {
+        return;
+    }
+
+    int32 NumPostings = 0;
+    for (const TArray<FPosting>& TermPostings : PendingPostings)
+    {
+        NumPostings += TermPostings.Num();
+    }
+
+    PostingOffsets.Reset(PendingPostings.Num() + 1);
+    Postings.Reset(NumPostings);
+    for (const TArray<FPosting>& TermPostings : PendingPostings)
+    {
+        PostingOffsets.Add(Postings.Num());
+        Postings.Append(TermPostings);
+    }
+    PostingOffsets.Add(Postings.Num());
+
+    PendingPostings.Empty();
+    TermIds.Compact();
+}
+
+void FLexicalIndex::Search(FStringView Query, int32 K, float MinScore, TArray<FKnowledgeMatch>& OutMatches) const
+{
+    OutMatches.Reset();
+
+    if (K <= 0 || DocLengths.Num() == 0 || PostingOffsets.Num() == 0)
+    {
+        return;
+    }
+
+    // Each distinct query term is scored once, however often it is repeated.
+    TArray<int32, TInlineAllocator<16>> QueryTerms;
+    Tokenize(Query, [this, &QueryTerms](const FString& Token)
+        {
+            if (IsStopWord(Token))
+            {
+                return;
+            }
+            if (const int32* TermId = TermIds.Find(Token))
+            {
+                QueryTerms.AddUnique(*TermId);
+            }
+        });
+
+    const float NumDocs = static_cast<float>(DocLengths.Num());
+    TMap<int32, float> Scores;
+    float MaxScore = 0.0f;
+    for (int32 TermId : QueryTerms)
+    {
+        const int32 First = PostingOffsets[TermId];
+        const int32 Last = PostingOffsets[TermId + 1];
+        const float DocFrequency = static_cast<float>(Last - First);
+        const float Idf = FMath::Loge(1.0f + (NumDocs - DocFrequency + 0.5f) / (DocFrequency + 0.5f));
+
+        // A term contributes at most Idf * (K1 + 1), reached as its frequency in a document grows.
+        MaxScore += Idf * (K1 + 1.0f);
+
+        for (int32 i = First; i < Last; i++)
+        {
+            const FPosting& Posting = Postings[i];
+            const float Tf = static_cast<float>(Posting.TermFrequency);
+            const float Norm = K1 * (1.0f - B + B * DocLengths[Posting.Doc] / AverageDocLength);
+            Scores.FindOrAdd(Posting.Doc) += Idf * Tf * (K1 + 1.0f) / (Tf + Norm);
+        }
+    }
+
+    auto WorstFirst = [](const FKnowledgeMatch& A, const FKnowledgeMatch& C)
+        {
+            return A.Score < C.Score;
+        };
+
+    if (MaxScore <= 0.0f)
+    {
+        return;
+    }
+
+    const float InvMaxScore = 1.0f / MaxScore;
+    OutMatches.Reserve(FMath::Min(K, Scores.Num()));
+    for (const TPair<int32, float>& Score : Scores)
+    {
+        const float Normalized = Score.Value * InvMaxScore;
+        if (Normalized < MinScore)
+        {
+            continue;
+        }
+
+        if (OutMatches.Num() < K)
+        {
+            OutMatches.HeapPush({ Score.Key, Normalized }, WorstFirst);
+        }
+        else if (Normalized > OutMatches.HeapTop().Score)
+        {
+            OutMatches.HeapPopDiscard(WorstFirst, EAllowShrinking::No);
+            OutMatches.HeapPush({ Score.Key, Normalized }, WorstFirst);
+        }
+    }
+
+    OutMatches.Sort([](const FKnowledgeMatch& A, const FKnowledgeMatch& C)
+        {
+            return A.Score > C.Score;
+        });
+}
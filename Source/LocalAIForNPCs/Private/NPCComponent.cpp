@@ -29,6 +29,8 @@ void UNPCComponent::StartRecording()
     bIsUsersConversationTurn = false;
     bIsRecording = true;
 
+    BeginConversationTurn();
+
     ASRComponent->StartRecording();
 }
 
@@ -46,8 +48,7 @@ void UNPCComponent::StopRecordingAndSendAudio()
         return;
     }
 
-    FString AudioPath = ASRComponent->StopRecording();
-    ASRComponent->TranscribeAudio(AudioPath);
+    ASRComponent->StopRecordingAndTranscribe();
 
     bIsRecording = false;
 }
@@ -68,7 +69,66 @@ void UNPCComponent::SendText(FString Input)
 
     bIsUsersConversationTurn = false;
 
-    LLMComponent->SendChatMessage(Input);
+    BeginConversationTurn();
+
+    RespondTo(Input);
+}
+
+void UNPCComponent::ClearResponseCache()
+{
+    ResponseCache.Empty();
+    bCollectingResponse = false;
+}
+
+void UNPCComponent::CancelConversationTurn()
+{
+    if (TurnToken.IsValid())
+    {
+        TurnToken->Cancel();
+        TurnToken.Reset();
+    }
+    // Requests made outside a turn must not inherit the cancelled token; each component makes a fresh one on demand.
+    SetTurnToken(nullptr);
+
+    bCollectingResponse = false;
+
+    if (bIsRecording && ASRComponent)
+    {
+        ASRComponent->DiscardRecording();
+    }
+    bIsRecording = false;
+
+    if (TTSComponent)
+    {
+        TTSComponent->StopSpeech();
+    }
+
+    bIsUsersConversationTurn = true;
+
+    UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | NPCComponent] Conversation turn cancelled."));
+}
+
+void UNPCComponent::BeginConversationTurn()
+{
+    // Work left over from the previous turn keeps its own token, so trailing speech is not cut off here.
+    TurnToken = MakeShared<FCancellationToken, ESPMode::ThreadSafe>();
+    SetTurnToken(TurnToken);
+}
+
+void UNPCComponent::SetTurnToken(const FCancellationTokenPtr& Token)
+{
+    if (ASRComponent)
+    {
+        ASRComponent->SetCancellationToken(Token);
+    }
+    if (LLMComponent)
+    {
+        LLMComponent->SetCancellationToken(Token);
+    }
+    if (TTSComponent)
+    {
+        TTSComponent->SetCancellationToken(Token);
+    }
 }
 
 void UNPCComponent::BeginPlay()
@@ -82,6 +142,8 @@ void UNPCComponent::BeginPlay()
     {
 
         ASRComponent->Port = ASRPort;
+        ASRComponent->MaxBufferedSeconds = MaxBufferedSeconds;
+        ASRComponent->ResamplerQuality = ResamplerQuality;
 
         ASRComponent->RegisterComponent();
 
@@ -94,6 +156,13 @@ void UNPCComponent::BeginPlay()
         LLMComponent->Port = LLMPort;
         LLMComponent->SystemMessage = SystemMessage;
         LLMComponent->bStream = bStream;
+        LLMComponent->bCachePrompt = bCachePrompt;
+        LLMComponent->NumServerSlots = NumServerSlots;
+        LLMComponent->SlotId = SlotId;
+        LLMComponent->WarmUpCooldownSeconds = WarmUpCooldownSeconds;
+        LLMComponent->MaxConcurrentWarmUps = MaxConcurrentWarmUps;
+        LLMComponent->MaxHistoryTokens = MaxHistoryTokens;
+        LLMComponent->bSummarizeEvictedHistory = bSummarizeEvictedHistory;
 
         LLMComponent->RagMode = RagMode;
         LLMComponent->EmbeddingPort = EmbeddingPort;
@@ -103,9 +172,27 @@ void UNPCComponent::BeginPlay()
         LLMComponent->RerankingTopN = RerankingTopN;
         LLMComponent->SentencesPerChunk = SentencesPerChunk;
         LLMComponent->SentenceOverlap = SentenceOverlap;
+        LLMComponent->SimilarityThreshold = SimilarityThreshold;
+        LLMComponent->LexicalScoreThreshold = LexicalScoreThreshold;
+        LLMComponent->LexicalWeight = LexicalWeight;
+        LLMComponent->MaxRagContextCharacters = MaxRagContextCharacters;
+        LLMComponent->EmbeddingBatchSize = EmbeddingBatchSize;
+        LLMComponent->MaxConcurrentEmbeddingRequests = MaxConcurrentEmbeddingRequests;
+        LLMComponent->KnowledgeIndexType = KnowledgeIndexType;
+        LLMComponent->HnswM = HnswM;
+        LLMComponent->HnswEfConstruction = HnswEfConstruction;
+        LLMComponent->HnswEfSearch = HnswEfSearch;
+        LLMComponent->HnswRecallQueries = HnswRecallQueries;
+        LLMComponent->EmbeddingQuantization = EmbeddingQuantization;
+        LLMComponent->QuantizedRescoreFactor = QuantizedRescoreFactor;
+        LLMComponent->bUseEmbeddingCache = bUseEmbeddingCache;
+        LLMComponent->EmbeddingModelName = EmbeddingModelName;
+        LLMComponent->QueryEmbeddingCacheSize = QueryEmbeddingCacheSize;
+        LLMComponent->MaxEmbeddingCacheEntries = MaxEmbeddingCacheEntries;
 
         LLMComponent->KnownActions = KnownActions;
         LLMComponent->KnownObjects = KnownObjects;
+        LLMComponent->bConstrainActionGrammar = bConstrainActionGrammar;
 
         LLMComponent->RegisterComponent();
 
@@ -114,6 +201,9 @@ void UNPCComponent::BeginPlay()
         LLMComponent->OnActionReceived.AddDynamic(this, &UNPCComponent::HandleActionReceived);
     }
 
+    ResponseCache.MaxEntries = ResponseCacheMaxEntries;
+    ResponseCache.MaxAgeSeconds = ResponseCacheMaxAgeSeconds;
+
     TTSComponent = NewObject<UTTSComponent>(this, UTTSComponent::StaticClass(), TEXT("TTSComponent"));
     if (TTSComponent)
     {
@@ -143,6 +233,13 @@ void UNPCComponent::BeginPlay()
     }
 }
 
+void UNPCComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    CancelConversationTurn();
+
+    Super::EndPlay(EndPlayReason);
+}
+
 void UNPCComponent::HandleTranscriptionComplete(const FString& Transcription)
 {
     if (Transcription.IsEmpty())
@@ -164,7 +261,7 @@ void UNPCComponent::HandleTranscriptionComplete(const FString& Transcription)
 
     if (LLMComponent)
     {
-        LLMComponent->SendChatMessage(Transcription);
+        RespondTo(Transcription);
     }
     else
     {
@@ -174,12 +271,79 @@ void UNPCComponent::HandleTranscriptionComplete(const FString& Transcription)
     }
 }
 
+void UNPCComponent::RespondTo(const FString& Message)
+{
+    bCollectingResponse = false;
+
+    if (!bUseResponseCache)
+    {
+        LLMComponent->SendChatMessage(Message);
+        return;
+    }
+
+    // The context is captured before the message itself enters the history.
+    const uint32 ContextHash = LLMComponent->GetConversationHash(ResponseCacheContextTurns);
+
+    LLMComponent->EmbedQuery(Message, [this, Message, ContextHash](const TArray<float>& Embedding)
+        {
+            if (Embedding.IsEmpty())
+            {
+                UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | NPCComponent] Could not embed message, response cache skipped."));
+                LLMComponent->SendChatMessage(Message);
+                return;
+            }
+
+            float Score = 0.0f;
+            if (const FSemanticResponseCache::FEntry* Entry = ResponseCache.Find(Embedding, ContextHash, ResponseCacheThreshold, &Score))
+            {
+                UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | NPCComponent] Response cache hit (similarity %.3f, %d hits)."), Score, Entry->Hits);
+                ReplayCachedResponse(Message, *Entry);
+                return;
+            }
+
+            bCollectingResponse = true;
+            PendingEmbedding = Embedding;
+            PendingContextHash = ContextHash;
+            PendingResponse.Reset();
+            bPendingResponseComplete = false;
+            PendingClipsRequested = 0;
+            PendingClips.Reset();
+
+            LLMComponent->SendChatMessage(Message);
+        });
+}
+
+void UNPCComponent::ReplayCachedResponse(const FString& Message, const FSemanticResponseCache::FEntry& Entry)
+{
+    LLMComponent->AppendExchange(Message, Entry.Response);
+
+    for (const FSemanticResponseCache::FClip& Clip : Entry.Clips)
+    {
+        HandleSoundReady(Clip.AudioData, Clip.Text);
+    }
+}
+
+void UNPCComponent::TryCacheResponse()
+{
+    if (!bCollectingResponse || !bPendingResponseComplete || PendingClipsRequested == 0 || PendingClips.Num() < PendingClipsRequested)
+    {
+        return;
+    }
+
+    bCollectingResponse = false;
+    ResponseCache.Add(MoveTemp(PendingEmbedding), PendingContextHash, PendingResponse, MoveTemp(PendingClips));
+
+    UE_LOG(LogTemp, Log, TEXT("[LocalAIForNPCs | NPCComponent] Response cached (%d entries)."), ResponseCache.Num());
+}
+
 void UNPCComponent::HandleResponseReceived(const FString& Response)
 {
     if (Response.IsEmpty())
     {
         UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | NPCComponent] Received empty response."));
 
+        bCollectingResponse = false;
+
         if (TTSComponent)
         {
             TTSComponent->CreateSoundWave(TEXT("I'm sorry, I didn't understand that. Could you please repeat?"));
@@ -197,12 +361,18 @@ void UNPCComponent::HandleResponseReceived(const FString& Response)
         if (!bStream)
         {
             TTSComponent->CreateSoundWave(Response);
+            ++PendingClipsRequested;
         }
     }
     else
     {
         UE_LOG(LogTemp, Error, TEXT("[LocalAIForNPCs | NPCComponent] TTSComponent is not initialized."));
     }
+
+    // Streamed chunks arrive before the full response, so every clip of the reply has been requested by now.
+    PendingResponse = Response;
+    bPendingResponseComplete = true;
+    TryCacheResponse();
 }
 
 void UNPCComponent::HandleChunkReceived(const FString& Chunk, bool bDone)
@@ -212,7 +382,7 @@ void UNPCComponent::HandleChunkReceived(const FString& Chunk, bool bDone)
         if (!Chunk.IsEmpty())
         {
             TTSComponent->CreateSoundWave(Chunk);
-
+            ++PendingClipsRequested;
         }
         else
         {
@@ -227,11 +397,30 @@ void UNPCComponent::HandleChunkReceived(const FString& Chunk, bool bDone)
 
 void UNPCComponent::HandleActionReceived(const FString& Action, AActor* Object)
 {
+    // Replaying the reply would not repeat the action, so replies that act are never cached.
+    bCollectingResponse = false;
+
     OnActionReceived.Broadcast(Action, Object);
 }
 
 void UNPCComponent::HandleSoundReady(const TArray<uint8>& AudioData, FString InputText)
 {
+    if (bCollectingResponse)
+    {
+        if (AudioData.Num() == 0)
+        {
+            // Synthesis failed; a cached reply would replay this clip as silence.
+            UE_LOG(LogTemp, Warning, TEXT("[LocalAIForNPCs | NPCComponent] Speech synthesis failed, response will not be cached."));
+            bCollectingResponse = false;
+            PendingClips.Reset();
+        }
+        else
+        {
+            PendingClips.Add({ InputText, AudioData });
+            TryCacheResponse();
+        }
+    }
+
     if (TTSComponent)
     {
         TTSComponent->PlaySpeech(AudioData);
@@ -72,8 +72,13 @@ void UPlayerComponent::BeginPlay()
             ASRComponent->VadMode = VadMode;
             ASRComponent->SecondsOfSilenceBeforeSend = SecondsOfSilenceBeforeSend;
             ASRComponent->MinSpeechDuration = MinSpeechDuration;
+            ASRComponent->VadOnsetFrames = VadOnsetFrames;
+            ASRComponent->VadHangoverMs = VadHangoverMs;
+            ASRComponent->PreRollMs = PreRollMs;
             ASRComponent->EnergyThreshold = EnergyThreshold;
             ASRComponent->WebRtcVadAggressiveness = WebRtcVadAggressiveness;
+            ASRComponent->MaxBufferedSeconds = MaxBufferedSeconds;
+            ASRComponent->ResamplerQuality = ResamplerQuality;
 
             ASRComponent->RegisterComponent();
 
@@ -94,6 +99,11 @@ void UPlayerComponent::OnBeginOverlap(UPrimitiveComponent* OverlappedComp, AActo
     {
         NearbyNpcs.AddUnique(NpcComp);
         UE_LOG(LogTemp, Verbose, TEXT("[LocalAINpc | PlayerComponent] NPC entered interaction range: %s"), *NpcComp->Name);
+
+        if (NpcComp->bWarmUpOnApproach && NpcComp->LLMComponent)
+        {
+            NpcComp->LLMComponent->WarmUpPrompt();
+        }
     }
 }
 
@@ -114,6 +124,25 @@ void UPlayerComponent::OnEndOverlap(UPrimitiveComponent* OverlappedComp, AActor*
         {
             UE_LOG(LogTemp, Verbose, TEXT("[LocalAINpc | PlayerComponent] NPC not found in nearby list: %s"), *NpcComp->Name);
         }
+
+        // Walking away ends the conversation: nothing the NPC was still working on should play out of range.
+        NpcComp->CancelConversationTurn();
+        if (NpcComp->LLMComponent)
+        {
+            NpcComp->LLMComponent->CancelWarmUp();
+        }
+
+        if (CurrentRecordingNpc == NpcComp)
+        {
+            bIsRecording = false;
+            CurrentRecordingNpc = nullptr;
+        }
+
+        if (CurrentTypingNpc == NpcComp)
+        {
+            bIsTyping = false;
+            CurrentTypingNpc = nullptr;
+        }
     }
 }
 
@@ -0,0 +1,116 @@
+#include "SemanticResponseCache.h"
+
+const FSemanticResponseCache::FEntry* FSemanticResponseCache::Find(const TArray<float>& Embedding, uint32 ContextHash, float Threshold, float* OutScore)
+{
+    const double Now = FPlatformTime::Seconds();
+    RemoveExpired(Now);
+
+    TArray<float> Query = Embedding;
+    if (!Normalize(Query))
+    {
+        return nullptr;
+    }
+
+    FEntry* Best = nullptr;
+    float BestScore = Threshold;
+    for (FEntry& Entry : Entries)
+    {
+        if (Entry.ContextHash != ContextHash || Entry.Embedding.Num() != Query.Num())
+        {
+            continue;
+        }
+
+        float Score = 0.0f;
+        for (int32 i = 0; i < Query.Num(); ++i)
+        {
+            Score += Query[i] * Entry.Embedding[i];
+        }
+
+        if (Score >= BestScore)
+        {
+            Best = &Entry;
+            BestScore = Score;
+        }
+    }
+
+    if (Best)
+    {
+        Best->LastUsedTime = Now;
+        ++Best->Hits;
+        if (OutScore)
+        {
+            *OutScore = BestScore;
+        }
+    }
+    return Best;
+}
+
+void FSemanticResponseCache::Add(TArray<float> Embedding, uint32 ContextHash, const FString& Response, TArray<FClip> Clips)
+{
+    if (MaxEntries <= 0 || !Normalize(Embedding))
+    {
+        return;
+    }
+
+    const double Now = FPlatformTime::Seconds();
+    RemoveExpired(Now);
+
+    while (Entries.Num() >= MaxEntries)
+    {
+        int32 Oldest = 0;
+        for (int32 i = 1; i < Entries.Num(); ++i)
+        {
+            if (Entries[i].LastUsedTime < Entries[Oldest].LastUsedTime)
+            {
+                Oldest = i;
+            }
+        }
+        Entries.RemoveAtSwap(Oldest, 1, EAllowShrinking::No);
+    }
+
+    FEntry& Entry = Entries.AddDefaulted_GetRef();
+    Entry.Embedding = MoveTemp(Embedding);
+    Entry.ContextHash = ContextHash;
+    Entry.Response = Response;
+    Entry.Clips = MoveTemp(Clips);
+    Entry.CreatedTime = Now;
+    Entry.LastUsedTime = Now;
+}
+
+void FSemanticResponseCache::Empty()
+{
+    Entries.Empty();
+}
+
+void FSemanticResponseCache::RemoveExpired(double Now)
+{
+    if (MaxAgeSeconds <= 0.0)
+    {
+        return;
+    }
+
+    Entries.RemoveAllSwap([this, Now](const FEntry& Entry)
+        {
+            return Now - Entry.CreatedTime > MaxAgeSeconds;
+        }, EAllowShrinking::No);
+}
+
+bool FSemanticResponseCache::Normalize(TArray<float>& Vector)
+{
+    double SquaredNorm = 0.0;
+    for (const float Value : Vector)
+    {
+        SquaredNorm += Value * Value;
+    }
+    if (SquaredNorm <= UE_SMALL_NUMBER)
+    {
+        return false;
+    }
+
+    const float InvNorm = static_cast<float>(1.0 / FMath::Sqrt(SquaredNorm));
+    for (float& Value : Vector)
+    {
+        Value *= InvNorm;
+    }
+    return true;
+}
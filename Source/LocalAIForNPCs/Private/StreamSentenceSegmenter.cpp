@@ -0,0 +1,200 @@
+#include "StreamSentenceSegmenter.h"
+
+namespace
+{
+    constexpr int32 AbbreviationSlots = 32;
+    constexpr int32 MaxAbbreviationLen = 6;
+
+    /**
+     * Known abbreviations, lower case, without the final dot. Each is stored at the slot given by
+     * AbbreviationHash. The multipliers were picked so that no two entries collide, which makes a lookup a
+     * single comparison. The static_assert below checks this.
+     */
+    constexpr const TCHAR* AbbreviationTable[AbbreviationSlots] = {
+        nullptr, TEXT("fig"), TEXT("prof"), TEXT("vs"), TEXT("lt"), TEXT("st"), nullptr, TEXT("sgt"),
+        TEXT("jr"), TEXT("gen"), TEXT("e.g"), TEXT("approx"), nullptr, TEXT("mr"), nullptr, nullptr,
+        TEXT("dept"), nullptr, nullptr, nullptr, TEXT("ms"), nullptr, TEXT("mrs"), TEXT("sr"),
+        TEXT("i.e"), TEXT("capt"), nullptr, TEXT("mt"), nullptr, nullptr, TEXT("dr"), TEXT("col")
+    };
+
+    constexpr uint32 AbbreviationHash(int32 Len, TCHAR First, TCHAR Last)
+    {
+        return (uint32(Len) * 2 + uint32(First) * 23 + uint32(Last) * 7) % AbbreviationSlots;
+    }
+
+    constexpr bool IsAbbreviationTableValid()
+    {
+        for (int32 Slot = 0; Slot < AbbreviationSlots; Slot++)
+        {
+            const TCHAR* Entry = AbbreviationTable[Slot];
+            if (Entry == nullptr)
+            {
+                continue;
+            }
+
+            int32 Len = 0;
+            while (Entry[Len] != 0)
+            {
+                Len++;
+            }
+            if (Len > MaxAbbreviationLen || AbbreviationHash(Len, Entry[0], Entry[Len - 1]) != uint32(Slot))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    static_assert(IsAbbreviationTableValid(), "Abbreviation table entries must sit in the slot their hash selects");
+
+    bool IsTerminator(TCHAR c)
+    {
+        switch (c)
+        {
+        case '.': case '!': case '?': case ';':
+        case 0x2026: // horizontal ellipsis
+        case 0x3002: case 0xFF0E: case 0xFF61: // ideographic, fullwidth and halfwidth full stops
+        case 0xFF01: case 0xFF1F: case 0xFF1B: // fullwidth ! ? ;
+        case 0x0964: case 0x0965: // Devanagari danda and double danda
+        case 0x061F: case 0x06D4: case 0x061B: // Arabic question mark, full stop and semicolon
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    /** Characters that stay with the sentence they close, such as the quote in: "Go." */
+    bool IsCloser(TCHAR c)
+    {
+        switch (c)
+        {
+        case '"': case '\'': case ')': case ']':
+        case 0x2019: case 0x201D: // right single and double quotation marks
+        case 0x300D: case 0x300F: case 0xFF09: // CJK corner brackets and fullwidth parenthesis
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool IsLineBreak(TCHAR c)
+    {
+        return c == '\n' || c == '\r';
+    }
+}
+
+FStreamSentenceSegmenter::FStreamSentenceSegmenter()
+{
+    Reset();
+}
+
+void FStreamSentenceSegmenter::Reset()
+{
+    Buffer.Reset();
+    Boundary = 0;
+    bPendingTerminator = false;
+    bPendingDot = false;
+}
+
+void FStreamSentenceSegmenter::Append(FStringView Text)
+{
+    const int32 Start = Buffer.Len();
+    Buffer.Append(Text.GetData(), Text.Len());
+
+    for (int32 i = Start; i < Buffer.Len(); i++)
+    {
+        ScanChar(i);
+    }
+}
+
+void FStreamSentenceSegmenter::ScanChar(int32 Index)
+{
+    const TCHAR c = Buffer[Index];
+
+    if (bPendingTerminator)
+    {
+        if (IsTerminator(c) || IsCloser(c))
+        {
+            bPendingDot = false;
+            return;
+        }
+
+        if (!(bPendingDot && FChar::IsAlnum(c)))
+        {
+            Boundary = Index;
+        }
+        bPendingTerminator = false;
+        bPendingDot = false;
+    }
+
+    if (IsLineBreak(c))
+    {
+        Boundary = Index + 1;
+    }
+    else if (IsTerminator(c))
+    {
+        if (c == '.' && EndsWithAbbreviation(Index))
+        {
+            return;
+        }
+        bPendingTerminator = true;
+        bPendingDot = c == '.';
+    }
+}
+
+bool FStreamSentenceSegmenter::EndsWithAbbreviation(int32 DotIndex) const
+{
+    // Abbreviations are made of letters and inner dots, so walk back over those. Stop one character past the
+    // longest entry, because a longer word cannot match.
+    int32 Start = DotIndex;
+    while (Start > 0 && DotIndex - Start <= MaxAbbreviationLen)
+    {
+        const TCHAR Prev = Buffer[Start - 1];
+        if (!FChar::IsAlpha(Prev) && Prev != '.')
+        {
+            break;
+        }
+        Start--;
+    }
+
+    // The word must start at a boundary: a digit before it makes an ordinal such as "1st.", which ends a sentence.
+    const int32 Len = DotIndex - Start;
+    if (Len == 0 || Len > MaxAbbreviationLen || (Start > 0 && FChar::IsAlnum(Buffer[Start - 1])))
+    {
+        return false;
+    }
+
+    const TCHAR* Word = *Buffer + Start;
+    const TCHAR* Entry = AbbreviationTable[AbbreviationHash(Len, FChar::ToLower(Word[0]), FChar::ToLower(Word[Len - 1]))];
+    if (Entry == nullptr)
+    {
+        return false;
+    }
+
+    for (int32 i = 0; i < Len; i++)
+    {
+        if (Entry[i] == 0 || FChar::ToLower(Word[i]) != Entry[i])
+        {
+            return false;
+        }
+    }
+    return Entry[Len] == 0;
+}
+
+bool FStreamSentenceSegmenter::PopSentences(FString& OutText)
+{
+    if (Boundary == 0)
+    {
+        return false;
+    }
+
+    OutText = Buffer.Left(Boundary);
+    Buffer.RemoveAt(0, Boundary, EAllowShrinking::No);
+    Boundary = 0;
+    return true;
+}
+
+void FStreamSentenceSegmenter::Flush(FString& OutText)
+{
+    OutText = MoveTemp(Buffer);
+    Reset();
+}
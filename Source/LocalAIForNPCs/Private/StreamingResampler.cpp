@@ -0,0 +1,152 @@
+#include "StreamingResampler.h"
+
+namespace
+{
+    // Rates whose reduced ratio needs more phases are approximated; the error stays far below what VAD or ASR notice.
+    constexpr int32 MaxPhases = 1024;
+
+    // Cutoff as a fraction of the lower Nyquist frequency, leaving room for the transition band.
+    constexpr double Rolloff = 0.92;
+    constexpr double KaiserBeta = 8.0;
+
+    /** Zeroth-order modified Bessel function of the first kind, for the Kaiser window. */
+    double BesselI0(double X)
+    {
+        double Sum = 1.0;
+        double Term = 1.0;
+        for (int32 k = 1; k < 32; k++)
+        {
+            Term *= (X / (2.0 * k)) * (X / (2.0 * k));
+            Sum += Term;
+            if (Term < Sum * 1e-12)
+            {
+                break;
+            }
+        }
+        return Sum;
+    }
+}
+
+void FStreamingResampler::Init(int32 InInputRate, int32 InOutputRate, int32 InZeroCrossings)
+{
+    InputRate = FMath::Max(1, InInputRate);
+    OutputRate = FMath::Max(1, InOutputRate);
+    ZeroCrossings = FMath::Max(1, InZeroCrossings);
+
+    int32 A = InputRate;
+    int32 B = OutputRate;
+    while (B != 0)
+    {
+        const int32 R = A % B;
+        A = B;
+        B = R;
+    }
+    Interpolation = OutputRate / A;
+    Decimation = InputRate / A;
+    if (Interpolation > MaxPhases)
+    {
+        Decimation = FMath::Max(1, FMath::RoundToInt(static_cast<double>(Decimation) * MaxPhases / Interpolation));
+        Interpolation = MaxPhases;
+    }
+
+    // The prototype filter runs at InputRate * Interpolation; its cutoff is set by the lower of the two rates.
+    const double Cutoff = 0.5 / FMath::Max(Interpolation, Decimation) * Rolloff;
+    NumTaps = FMath::Max(1, FMath::CeilToInt(ZeroCrossings / (Cutoff * Interpolation)));
+
+    const int32 Length = NumTaps * Interpolation;
+    const double Center = (Length - 1) * 0.5;
+    const double InvI0Beta = 1.0 / BesselI0(KaiserBeta);
+
+    Coefficients.SetNumUninitialized(Length);
+    for (int32 p = 0; p < Interpolation; p++)
+    {
+        float* PhaseCoefficients = Coefficients.GetData() + p * NumTaps;
+        double Sum = 0.0;
+        for (int32 k = 0; k < NumTaps; k++)
+        {
+            const double Offset = p + k * Interpolation - Center;
+            const double X = 2.0 * Cutoff * Offset;
+            const double Sinc = FMath::IsNearlyZero(X) ? 1.0 : FMath::Sin(UE_DOUBLE_PI * X) / (UE_DOUBLE_PI * X);
+            const double Ratio = Length > 1 ? Offset / Center : 0.0;
+            const double Window = BesselI0(KaiserBeta * FMath::Sqrt(FMath::Max(0.0, 1.0 - Ratio * Ratio))) * InvI0Beta;
+
+            PhaseCoefficients[k] = static_cast<float>(Sinc * Window);
+            Sum += PhaseCoefficients[k];
+        }
+
+        // Unity gain for every phase, so a constant input stays constant.
+        if (Sum != 0.0)
+        {
+            const float Scale = static_cast<float>(1.0 / Sum);
+            for (int32 k = 0; k < NumTaps; k++)
+            {
+                PhaseCoefficients[k] *= Scale;
+            }
+        }
+    }
+
+    History.SetNumUninitialized(2 * NumTaps);
+    Reset();
+}
+
+bool FStreamingResampler::IsInitialized(int32 InInputRate, int32 InOutputRate, int32 InZeroCrossings) const
+{
+    return NumTaps > 0 && InputRate == InInputRate && OutputRate == InOutputRate && ZeroCrossings == InZeroCrossings;
+}
+
+void FStreamingResampler::Reset()
+{
+    FMemory::Memzero(History.GetData(), History.Num() * sizeof(float));
+    HistoryPos = 0;
+    Phase = 0;
+}
+
+int32 FStreamingResampler::GetMaxOutputFrames(int32 NumInputFrames) const
+{
+    return static_cast<int32>((static_cast<int64>(NumInputFrames) * Interpolation + Decimation - 1) / Decimation) + 1;
+}
+
+int32 FStreamingResampler::Process(const float* InSamples, int32 NumInputFrames, float* OutSamples)
+{
+    int32 NumWritten = 0;
+    for (int32 i = 0; i < NumInputFrames; i++)
+    {
+        NumWritten += PushSample(InSamples[i], OutSamples + NumWritten);
+    }
+    return NumWritten;
+}
+
+int32 FStreamingResampler::Flush(float* OutSamples)
+{
+    // The filter delays the signal by half its length; push that much silence to get the last samples out.
+    int32 NumWritten = 0;
+    for (int32 i = 0; i < NumTaps / 2 + 1; i++)
+    {
+        NumWritten += PushSample(0.0f, OutSamples + NumWritten);
+    }
+    Reset();
+    return NumWritten;
+}
+
+int32 FStreamingResampler::PushSample(float Sample, float* OutSamples)
+{
+    HistoryPos = HistoryPos == 0 ? NumTaps - 1 : HistoryPos - 1;
+    History[HistoryPos] = Sample;
+    History[HistoryPos + NumTaps] = Sample;
+
+    const float* Window = History.GetData() + HistoryPos;
+    int32 NumWritten = 0;
+    while (Phase < Interpolation)
+    {
+        const float* PhaseCoefficients = Coefficients.GetData() + Phase * NumTaps;
+        float Sum = 0.0f;
+        for (int32 k = 0; k < NumTaps; k++)
+        {
+            Sum += PhaseCoefficients[k] * Window[k];
+        }
+        OutSamples[NumWritten++] = Sum;
+        Phase += Decimation;
+    }
+    Phase -= Interpolation;
+    return NumWritten;
+}
@@ -72,19 +72,32 @@ void UTTSComponent::CreateSoundWave(const FString& Text)
     FString Url = FString::Printf(TEXT("http://localhost:%d/v1/audio/speech"), Port);
     FString Content = CreateJsonRequest(Text);
 
+    const FCancellationTokenPtr Token = GetCancellationToken();
     TSharedRef<IHttpRequest, ESPMode::ThreadSafe> Request = FHttpModule::Get().CreateRequest();
     Request->SetURL(Url);
     Request->SetVerb("POST");
     Request->SetHeader("Content-Type", "application/json");
     Request->SetContentAsString(Content);
 
-    Request->OnProcessRequestComplete().BindLambda([this, Text](FHttpRequestPtr Req, FHttpResponsePtr Response, bool bWasSuccessful)
+    const uint32 CancelHandle = Token->AddCallback([Request]()
         {
+            Request->CancelRequest();
+        });
+
+    Request->OnProcessRequestComplete().BindLambda([this, WeakThis = TWeakObjectPtr<UTTSComponent>(this), Text, Token, CancelHandle](FHttpRequestPtr Req, FHttpResponsePtr Response, bool bWasSuccessful)
+        {
+            Token->RemoveCallback(CancelHandle);
+            if (!WeakThis.IsValid() || Token->IsCancelled())
+            {
+                UE_LOG(LogTemp, Log, TEXT("[LocalAINpc | TTS] Request cancelled."));
+                return;
+            }
+
             if (!bWasSuccessful || !Response.IsValid())
             {
                 UE_LOG(LogTemp, Error, TEXT("[LocalAINpc | Whisper] Request failed."));
 
-                AsyncTask(ENamedThreads::GameThread, [this, Text]()
+                AsyncTaskForTurn(WeakThis, Token, [this, Text]()
                     {
                         OnSoundReady.Broadcast(TArray<uint8>(), Text);
                     });
@@ -97,7 +110,7 @@ void UTTSComponent::CreateSoundWave(const FString& Text)
             {
                 UE_LOG(LogTemp, Error, TEXT("[LocalAINpc | Whisper] HTTP %d: %s"), Code, *Response->GetContentAsString());
 
-                AsyncTask(ENamedThreads::GameThread, [this, Text]()
+                AsyncTaskForTurn(WeakThis, Token, [this, Text]()
                     {
                         OnSoundReady.Broadcast(TArray<uint8>(), Text);
                     });
@@ -110,7 +123,7 @@ void UTTSComponent::CreateSoundWave(const FString& Text)
             {
                 UE_LOG(LogTemp, Log, TEXT("[LocalAINpc | TTS] Audio generated."));
 
-                AsyncTask(ENamedThreads::GameThread, [this, AudioData, Text]()
+                AsyncTaskForTurn(WeakThis, Token, [this, AudioData, Text]()
                     {
                         OnSoundReady.Broadcast(AudioData, Text);
                     });
@@ -119,7 +132,7 @@ void UTTSComponent::CreateSoundWave(const FString& Text)
             {
                 UE_LOG(LogTemp, Error, TEXT("[LocalAINpc | TTS] Received empty response."));
 
-                AsyncTask(ENamedThreads::GameThread, [this, Text]()
+                AsyncTaskForTurn(WeakThis, Token, [this, Text]()
                     {
                         OnSoundReady.Broadcast(TArray<uint8>(), Text);
                     });
@@ -244,7 +257,7 @@ void UTTSComponent::PlayNextInQueue()
     CustomAttenuation->Attenuation.AbsorptionMethod = EAirAbsorptionMethod::Linear;
     CustomAttenuation->Attenuation.AttenuationShape = EAttenuationShape::Sphere;
     CustomAttenuation->Attenuation.FalloffDistance = 1000.f;
-    UGameplayStatics::PlaySoundAtLocation(this, NextSound.SoundWave, Location, 1.0f, 1.0f, 0.0f, CustomAttenuation);
+    ActiveAudio = UGameplayStatics::SpawnSoundAtLocation(this, NextSound.SoundWave, Location, FRotator::ZeroRotator, 1.0f, 1.0f, 0.0f, CustomAttenuation);
 
     UE_LOG(LogTemp, Log, TEXT("[LocalAINpc | TTS] Playing sound for %.2f seconds."), NextSound.Duration);
     GetWorld()->GetTimerManager().SetTimer(AudioFinishTimer, this, &UTTSComponent::AudioFinishedHandler, NextSound.Duration, false);
@@ -266,8 +279,21 @@ void UTTSComponent::PlaySoundWithNeuroSync(const TArray<uint8>& AudioData)
     Request->SetHeader(TEXT("Content-Type"), "application/octet-stream");
     Request->SetContent(AudioData);
 
-    Request->OnProcessRequestComplete().BindLambda([this, AudioData](FHttpRequestPtr Req, FHttpResponsePtr Response, bool bSuccess)
+    const FCancellationTokenPtr Token = GetCancellationToken();
+    const uint32 CancelHandle = Token->AddCallback([Request]()
         {
+            Request->CancelRequest();
+        });
+
+    Request->OnProcessRequestComplete().BindLambda([this, WeakThis = TWeakObjectPtr<UTTSComponent>(this), AudioData, Token, CancelHandle](FHttpRequestPtr Req, FHttpResponsePtr Response, bool bSuccess)
+        {
+            Token->RemoveCallback(CancelHandle);
+            if (!WeakThis.IsValid() || Token->IsCancelled())
+            {
+                UE_LOG(LogTemp, Log, TEXT("[LocalAINpc | TTS | LipSync] NeuroSync request cancelled."));
+                return;
+            }
+
             UE_LOG(LogTemp, Log, TEXT("[LocalAINpc | TTS | LipSync] NeuroSync response received."));
 
             if (!bSuccess || !Response.IsValid())
@@ -340,18 +366,7 @@ void UTTSComponent::PlayNextNeuroInQueue()
 
     if (NextData.BlendshapeFrames.Num() == 0)
     {
-        FVector Location = GetOwner() ? GetOwner()->GetActorLocation() : FVector::ZeroVector;
-        USoundAttenuation* CustomAttenuation = NewObject<USoundAttenuation>();
-        CustomAttenuation->Attenuation.bAttenuate = true;
-        CustomAttenuation->Attenuation.bAttenuateWithLPF = true;
-        CustomAttenuation->Attenuation.bSpatialize = true;
-        CustomAttenuation->Attenuation.AbsorptionMethod = EAirAbsorptionMethod::Linear;
-        CustomAttenuation->Attenuation.AttenuationShape = EAttenuationShape::Sphere;
-        CustomAttenuation->Attenuation.FalloffDistance = 1000.f;
-        UGameplayStatics::PlaySoundAtLocation(this, Sound.SoundWave, Location, 1.0f, 1.0f, 0.0f, CustomAttenuation);
-
-        UE_LOG(LogTemp, Log, TEXT("[LocalAINpc | TTS] Playing sound for %.2f seconds."), Sound.Duration);
-        GetWorld()->GetTimerManager().SetTimer(NeuroFinishTimer, this, &UTTSComponent::NeuroFinishedHandler, Sound.Duration, false);
+        PlayNeuroSound(Sound, false);
         return;
     }
 
@@ -382,13 +397,14 @@ void UTTSComponent::PlayNextNeuroInQueue()
     FString ScriptPath = FPaths::Combine(FPaths::ProjectPluginsDir(), TEXT("LocalAIForNPCs"), TEXT("Source"), TEXT("ThirdParty"),
         TEXT("NeuroSync"), TEXT("dist"), TEXT("run_neurosync"), TEXT("run_neurosync.exe"));
 
-    Async(EAsyncExecution::Thread, [this, ScriptPath, TempFilePath, Sound]()
+    FString Args = FString::Printf(TEXT("\"%s\" \"%s\""), *TempFilePath, *FaceSubjectName);
+
+    Async(EAsyncExecution::Thread, [WeakThis = TWeakObjectPtr<UTTSComponent>(this), ScriptPath, Args, Sound, Token = GetCancellationToken()]()
         {
             void* PipeRead = nullptr;
             void* PipeWrite = nullptr;
             FPlatformProcess::CreatePipe(PipeRead, PipeWrite);
 
-            FString Args = FString::Printf(TEXT("\"%s\" \"%s\""), *TempFilePath, *FaceSubjectName);
             FProcHandle ProcHandle = FPlatformProcess::CreateProc(
                 *ScriptPath, *Args,
                 true, true, true,
@@ -402,31 +418,24 @@ void UTTSComponent::PlayNextNeuroInQueue()
 
             FString Output;
             bool bReadyFound = false;
+            double Deadline = DBL_MAX;
 
-            while (FPlatformProcess::IsProcRunning(ProcHandle) && !bReadyFound)
+            // NeuroSync keeps animating after READY, so wait for it to exit with the clip. A cancelled turn, or a
+            // process still running well after the clip ended, is terminated below.
+            while (FPlatformProcess::IsProcRunning(ProcHandle) && !Token->IsCancelled() && FPlatformTime::Seconds() < Deadline)
             {
                 FString NewOutput = FPlatformProcess::ReadPipe(PipeRead);
-                if (!NewOutput.IsEmpty())
+                if (!NewOutput.IsEmpty() && !bReadyFound)
                 {
                     Output += NewOutput;
                     if (Output.Contains("READY"))
                     {
                         bReadyFound = true;
+                        Deadline = FPlatformTime::Seconds() + Sound.Duration + 5.0;
 
-                        AsyncTask(ENamedThreads::GameThread, [this, Sound]()
+                        AsyncTaskForTurn(WeakThis, Token, [Sound](UTTSComponent* This)
                             {
-                                FVector Location = GetOwner() ? GetOwner()->GetActorLocation() : FVector::ZeroVector;
-                                USoundAttenuation* CustomAttenuation = NewObject<USoundAttenuation>();
-                                CustomAttenuation->Attenuation.bAttenuate = true;
-                                CustomAttenuation->Attenuation.bAttenuateWithLPF = true;
-                                CustomAttenuation->Attenuation.bSpatialize = true;
-                                CustomAttenuation->Attenuation.AbsorptionMethod = EAirAbsorptionMethod::Linear;
-                                CustomAttenuation->Attenuation.AttenuationShape = EAttenuationShape::Sphere;
-                                CustomAttenuation->Attenuation.FalloffDistance = 1000.f;
-                                UGameplayStatics::PlaySoundAtLocation(this, Sound.SoundWave, Location, 1.0f, 1.0f, 0.0f, CustomAttenuation);
-
-                                UE_LOG(LogTemp, Log, TEXT("[LocalAINpc | TTS] Playing sound for %.2f seconds (synced)."), Sound.Duration);
-                                GetWorld()->GetTimerManager().SetTimer(NeuroFinishTimer, this, &UTTSComponent::NeuroFinishedHandler, Sound.Duration, false);
+                                This->PlayNeuroSound(Sound, true);
                             });
                     }
                 }
@@ -435,27 +444,42 @@ void UTTSComponent::PlayNextNeuroInQueue()
 
             if (!bReadyFound)
             {
-                AsyncTask(ENamedThreads::GameThread, [this, Sound]()
+                AsyncTaskForTurn(WeakThis, Token, [Sound](UTTSComponent* This)
                     {
-                        FVector Location = GetOwner() ? GetOwner()->GetActorLocation() : FVector::ZeroVector;
-                        USoundAttenuation* CustomAttenuation = NewObject<USoundAttenuation>();
-                        CustomAttenuation->Attenuation.bAttenuate = true;
-                        CustomAttenuation->Attenuation.bAttenuateWithLPF = true;
-                        CustomAttenuation->Attenuation.bSpatialize = true;
-                        CustomAttenuation->Attenuation.AbsorptionMethod = EAirAbsorptionMethod::Linear;
-                        CustomAttenuation->Attenuation.AttenuationShape = EAttenuationShape::Sphere;
-                        CustomAttenuation->Attenuation.FalloffDistance = 1000.f;
-                        UGameplayStatics::PlaySoundAtLocation(this, Sound.SoundWave, Location, 1.0f, 1.0f, 0.0f, CustomAttenuation);
-
-                        UE_LOG(LogTemp, Log, TEXT("[LocalAINpc | TTS] Playing sound for %.2f seconds."), Sound.Duration);
-                        GetWorld()->GetTimerManager().SetTimer(NeuroFinishTimer, this, &UTTSComponent::NeuroFinishedHandler, Sound.Duration, false);
+                        This->PlayNeuroSound(Sound, false);
                     });
             }
 
+            if (ProcHandle.IsValid())
+            {
+                if (FPlatformProcess::IsProcRunning(ProcHandle))
+                {
+                    UE_LOG(LogTemp, Log, TEXT("[LocalAINpc | TTS | LipSync] Terminating NeuroSync process."));
+                    FPlatformProcess::TerminateProc(ProcHandle, true);
+                }
+                FPlatformProcess::CloseProc(ProcHandle);
+            }
+
             FPlatformProcess::ClosePipe(PipeRead, PipeWrite);
         });
 }
 
+void UTTSComponent::PlayNeuroSound(const FSoundWaveWithDuration& Sound, bool bSynced)
+{
+    FVector Location = GetOwner() ? GetOwner()->GetActorLocation() : FVector::ZeroVector;
+    USoundAttenuation* CustomAttenuation = NewObject<USoundAttenuation>();
+    CustomAttenuation->Attenuation.bAttenuate = true;
+    CustomAttenuation->Attenuation.bAttenuateWithLPF = true;
+    CustomAttenuation->Attenuation.bSpatialize = true;
+    CustomAttenuation->Attenuation.AbsorptionMethod = EAirAbsorptionMethod::Linear;
+    CustomAttenuation->Attenuation.AttenuationShape = EAttenuationShape::Sphere;
+    CustomAttenuation->Attenuation.FalloffDistance = 1000.f;
+    ActiveAudio = UGameplayStatics::SpawnSoundAtLocation(this, Sound.SoundWave, Location, FRotator::ZeroRotator, 1.0f, 1.0f, 0.0f, CustomAttenuation);
+
+    UE_LOG(LogTemp, Log, TEXT("[LocalAINpc | TTS] Playing sound for %.2f seconds%s."), Sound.Duration, bSynced ? TEXT(" (synced)") : TEXT(""));
+    GetWorld()->GetTimerManager().SetTimer(NeuroFinishTimer, this, &UTTSComponent::NeuroFinishedHandler, Sound.Duration, false);
+}
+
 void UTTSComponent::NeuroFinishedHandler()
 {
     bIsPlayingNeuro = false;
@@ -563,8 +587,57 @@ void UTTSComponent::A2FFinishedHandler()
 #endif
 }
 
+void UTTSComponent::StopSpeech()
+{
+    {
+        FScopeLock Lock(&SoundQueueLock);
+        SoundQueue.Empty();
+        bIsPlayingSound = false;
+    }
+    {
+        FScopeLock Lock(&NeuroQueueLock);
+        NeuroQueue.Empty();
+        bIsPlayingNeuro = false;
+    }
+    {
+        FScopeLock Lock(&A2FQueueLock);
+        A2FQueue.Empty();
+        bIsPlayingA2F = false;
+    }
+
+    if (UWorld* World = GetWorld())
+    {
+        World->GetTimerManager().ClearTimer(AudioFinishTimer);
+        World->GetTimerManager().ClearTimer(NeuroFinishTimer);
+        World->GetTimerManager().ClearTimer(A2FFinishTimer);
+    }
+
+    if (IsValid(ActiveAudio))
+    {
+        ActiveAudio->Stop();
+    }
+    ActiveAudio = nullptr;
+
+    UE_LOG(LogTemp, Log, TEXT("[LocalAINpc | TTS] Speech stopped and queue cleared."));
+}
+
+FCancellationTokenPtr UTTSComponent::GetCancellationToken()
+{
+    if (!CancellationToken)
+    {
+        CancellationToken = MakeShared<FCancellationToken, ESPMode::ThreadSafe>();
+    }
+    return CancellationToken;
+}
+
 void UTTSComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
+    if (CancellationToken)
+    {
+        CancellationToken->Cancel();
+    }
+    StopSpeech();
+
     Super::EndPlay(EndPlayReason);
 
     if (!OutputAudioFolder.IsEmpty() && IFileManager::Get().DirectoryExists(*OutputAudioFolder))
@@ -0,0 +1,249 @@
+#include "TextSanitizer.h"
+
+#if !UE_BUILD_SHIPPING
+#include "HAL/IConsoleManager.h"
+#include "Internationalization/Regex.h"
+#endif
+
+namespace
+{
+    const TCHAR ActionPrefix[] = TEXT("[[action: ");
+    constexpr int32 ActionPrefixLen = UE_ARRAY_COUNT(ActionPrefix) - 1;
+
+    /** Characters the regex '.' refuses to match, which end an action tag search. */
+    bool IsLineTerminator(TCHAR c)
+    {
+        return c == '\n' || c == '\r' || c == 0x85 || c == 0x2028 || c == 0x2029;
+    }
+
+    int32 FindCloser(const TCHAR* Data, int32 From, int32 Len, TCHAR Closer)
+    {
+        for (int32 i = From; i < Len; i++)
+        {
+            if (Data[i] == Closer)
+            {
+                return i;
+            }
+        }
+        return INDEX_NONE;
+    }
+
+    /** Returns the index just past the first "]]" on the current line, or INDEX_NONE with OutStop set to where the search ended. */
+    int32 FindActionCloser(const TCHAR* Data, int32 From, int32 Len, int32& OutStop)
+    {
+        int32 i = From;
+        for (; i < Len && !IsLineTerminator(Data[i]); i++)
+        {
+            if (Data[i] == ']' && i + 1 < Len && Data[i + 1] == ']')
+            {
+                return i + 2;
+            }
+        }
+        OutStop = i;
+        return INDEX_NONE;
+    }
+}
+
+FString FTextSanitizer::Sanitize(FStringView Text, ETextSanitizeFlags Flags)
+{
+    FString Result;
+    SanitizeInto(Text, Flags, Result);
+    return Result;
+}
+
+void FTextSanitizer::SanitizeInto(FStringView Text, ETextSanitizeFlags Flags, FString& Out)
+{
+    Out.Reset(Text.Len());
+
+    const TCHAR* Data = Text.GetData();
+    const int32 Len = Text.Len();
+
+    const bool bActionTags = EnumHasAnyFlags(Flags, ETextSanitizeFlags::ActionTags);
+    const bool bQuotes = EnumHasAnyFlags(Flags, ETextSanitizeFlags::Quotes);
+    const bool bNewlines = EnumHasAnyFlags(Flags, ETextSanitizeFlags::Newlines);
+
+    // A failed search for a closer means no closer exists further on either, so each opener kind is dropped
+    // once its search fails. Action tags end at a line break, so their failure only holds up to that point.
+    bool bBracketOpen = EnumHasAnyFlags(Flags, ETextSanitizeFlags::Brackets);
+    bool bAsteriskOpen = EnumHasAnyFlags(Flags, ETextSanitizeFlags::Asterisks);
+    bool bHtmlOpen = EnumHasAnyFlags(Flags, ETextSanitizeFlags::HtmlTags);
+    int32 ActionFailedUntil = 0;
+
+    int32 RunStart = 0;
+    auto FlushRun = [&Out, Data, &RunStart](int32 RunEnd)
+        {
+            if (RunEnd > RunStart)
+            {
+                Out.AppendChars(Data + RunStart, RunEnd - RunStart);
+            }
+        };
+
+    int32 i = 0;
+    while (i < Len)
+    {
+        const TCHAR c = Data[i];
+        int32 SkipTo = INDEX_NONE;
+
+        if (c == '[')
+        {
+            if (bActionTags && i >= ActionFailedUntil && i + ActionPrefixLen <= Len
+                && FMemory::Memcmp(Data + i, ActionPrefix, ActionPrefixLen * sizeof(TCHAR)) == 0)
+            {
+                SkipTo = FindActionCloser(Data, i + ActionPrefixLen, Len, ActionFailedUntil);
+            }
+            if (SkipTo == INDEX_NONE && bBracketOpen)
+            {
+                const int32 Close = FindCloser(Data, i + 1, Len, ']');
+                bBracketOpen = Close != INDEX_NONE;
+                SkipTo = bBracketOpen ? Close + 1 : INDEX_NONE;
+            }
+        }
+        else if (c == '*' && bAsteriskOpen)
+        {
+            const int32 Close = FindCloser(Data, i + 1, Len, '*');
+            bAsteriskOpen = Close != INDEX_NONE;
+            SkipTo = bAsteriskOpen ? Close + 1 : INDEX_NONE;
+        }
+        else if (c == '<' && bHtmlOpen)
+        {
+            const int32 Close = FindCloser(Data, i + 1, Len, '>');
+            bHtmlOpen = Close != INDEX_NONE;
+            SkipTo = bHtmlOpen ? Close + 1 : INDEX_NONE;
+        }
+        else if (c == '"' && bQuotes)
+        {
+            SkipTo = i + 1;
+        }
+        else if ((c == '\n' || c == '\r') && bNewlines)
+        {
+            FlushRun(i);
+            Out.AppendChar(' ');
+            RunStart = ++i;
+            continue;
+        }
+
+        if (SkipTo != INDEX_NONE)
+        {
+            FlushRun(i);
+            RunStart = i = SkipTo;
+            continue;
+        }
+
+        i++;
+    }
+    FlushRun(Len);
+
+    if (EnumHasAnyFlags(Flags, ETextSanitizeFlags::Trim))
+    {
+        Out.TrimStartAndEndInline();
+    }
+}
+
+#if !UE_BUILD_SHIPPING
+namespace
+{
+    /** The regex chain the components used before FTextSanitizer, kept as the benchmark baseline. */
+    FString LegacySanitize(const FString& String, bool bLLM)
+    {
+        auto RegexReplace = [](const FString& InputStr, const FString& PatternStr) -> FString
+            {
+                FRegexPattern Pattern(PatternStr);
+                FString Output = InputStr;
+
+                FRegexMatcher Matcher(Pattern, Output);
+                while (Matcher.FindNext())
+                {
+                    int32 Start = Matcher.GetMatchBeginning();
+                    int32 Length = Matcher.GetMatchEnding() - Start;
+                    Output.RemoveAt(Start, Length);
+
+                    Matcher = FRegexMatcher(Pattern, Output);
+                }
+
+                return Output;
+            };
+
+        FString Result = String;
+        if (bLLM)
+        {
+            Result = RegexReplace(Result, TEXT("\\[\\[action: .*?\\]\\]"));
+        }
+        Result = RegexReplace(Result, TEXT("\\[[^\\]]*\\]"));
+        Result = RegexReplace(Result, TEXT("\\*[^\\*]*\\*"));
+        if (bLLM)
+        {
+            Result = RegexReplace(Result, TEXT("<[^>]*>"));
+        }
+        Result = Result.Replace(TEXT("\""), TEXT(""));
+        Result = Result.Replace(TEXT("\n"), TEXT(" "));
+        Result = Result.Replace(TEXT("\r"), TEXT(" "));
+        return Result.TrimStartAndEnd();
+    }
+
+    void BenchmarkSanitizer(const TArray<FString>& Args)
+    {
+        const int32 Iterations = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 200;
+
+        TArray<FString> Samples;
+        Samples.Add(TEXT("Well met, traveler."));
+        Samples.Add(TEXT("*leans on the counter* \"Ah, you're back!\" [smiles warmly] The road north is dangerous. [[action: give_item]]"));
+        Samples.Add(TEXT("<think>The player wants a sword.</think>I have just the thing.\nCome, take a look. [[action: open_shop]]\r\n"));
+        Samples.Add(TEXT("[laughs] Fine, fine. *sighs* You win this time, \"hero\"."));
+
+        FString Long;
+        for (int32 i = 0; i < 64; i++)
+        {
+            Long += Samples[1 + (i % 3)];
+            Long += TEXT(" ");
+        }
+        Samples.Add(Long);
+
+        const ETextSanitizeFlags FlagSets[] = { ETextSanitizeFlags::ASR, ETextSanitizeFlags::LLM };
+        for (ETextSanitizeFlags Flags : FlagSets)
+        {
+            const bool bLLM = Flags == ETextSanitizeFlags::LLM;
+
+            int32 Mismatches = 0;
+            for (const FString& Sample : Samples)
+            {
+                if (!FTextSanitizer::Sanitize(Sample, Flags).Equals(LegacySanitize(Sample, bLLM), ESearchCase::CaseSensitive))
+                {
+                    Mismatches++;
+                }
+            }
+
+            int64 Sink = 0;
+            double Start = FPlatformTime::Seconds();
+            for (int32 It = 0; It < Iterations; It++)
+            {
+                for (const FString& Sample : Samples)
+                {
+                    Sink += LegacySanitize(Sample, bLLM).Len();
+                }
+            }
+            const double LegacySeconds = FPlatformTime::Seconds() - Start;
+
+            FString Scratch;
+            Start = FPlatformTime::Seconds();
+            for (int32 It = 0; It < Iterations; It++)
+            {
+                for (const FString& Sample : Samples)
+                {
+                    FTextSanitizer::SanitizeInto(Sample, Flags, Scratch);
+                    Sink += Scratch.Len();
+                }
+            }
+            const double NewSeconds = FPlatformTime::Seconds() - Start;
+
+            UE_LOG(LogTemp, Display, TEXT("[LocalAIForNPCs | Sanitizer] %s: regex %.2f ms, single pass %.2f ms (%.1fx) over %d iterations, %d mismatches (%lld)"),
+                bLLM ? TEXT("LLM") : TEXT("ASR"), LegacySeconds * 1000.0, NewSeconds * 1000.0,
+                LegacySeconds / FMath::Max(NewSeconds, 1e-9), Iterations, Mismatches, Sink);
+        }
+    }
+
+    FAutoConsoleCommand BenchmarkSanitizerCommand(
+        TEXT("LocalAI.BenchmarkSanitizer"),
+        TEXT("Compares FTextSanitizer against the legacy regex sanitizer. Usage: LocalAI.BenchmarkSanitizer [Iterations]"),
+        FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkSanitizer));
+}
+#endif
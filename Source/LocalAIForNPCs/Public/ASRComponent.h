@@ -5,6 +5,9 @@
 #include "AudioCaptureCore.h"
 #include "fvad.h"
 #include "ten_vad.h"
+#include "CancellationToken.h"
+#include "AudioRingBuffer.h"
+#include "StreamingResampler.h"
 #include "ASRComponent.generated.h"
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnTranscriptionComplete, const FString&, Transcription);
@@ -18,6 +21,14 @@ enum class EVadMode : uint8
     TEN             UMETA(DisplayName = "TEN")
 };
 
+UENUM(BlueprintType)
+enum class EResamplerQuality : uint8
+{
+    Fast            UMETA(DisplayName = "Fast"),
+    Balanced        UMETA(DisplayName = "Balanced"),
+    Best            UMETA(DisplayName = "Best")
+};
+
 UCLASS(ClassGroup = (LocalAIForNPCs), meta = (BlueprintSpawnableComponent))
 class LOCALAIFORNPCS_API UASRComponent : public UActorComponent
 {
@@ -35,12 +46,30 @@ public:
     UFUNCTION(BlueprintCallable, Category = "LocalAIForNPCs|ASR", meta = (ToolTip = "Stop audio capture and return the recorded file path."))
     FString StopRecording();
 
+    UFUNCTION(BlueprintCallable, Category = "LocalAIForNPCs|ASR", meta = (ToolTip = "Stop audio capture and transcribe the recording in memory, without writing a file."))
+    void StopRecordingAndTranscribe();
+
+    UFUNCTION(BlueprintCallable, Category = "LocalAIForNPCs|ASR", meta = (ToolTip = "Stop audio capture and drop the recording."))
+    void DiscardRecording();
+
     UFUNCTION(BlueprintCallable, Category = "LocalAIForNPCs|ASR", meta = (ToolTip = "Transcribe the specified audio file using whisper.cpp."))
     void TranscribeAudio(const FString& AudioPath);
 
+    UFUNCTION(BlueprintCallable, Category = "LocalAIForNPCs|ASR", meta = (ToolTip = "Transcribe mono audio samples using whisper.cpp. The audio is converted to 16 kHz and uploaded from memory."))
+    void TranscribeAudioData(const TArray<float>& MonoAudio, int32 SampleRate);
+
     UPROPERTY(BlueprintAssignable, Category = "LocalAIForNPCs|ASR", meta = (ToolTip = "Event fired when audio transcription is complete."))
     FOnTranscriptionComplete OnTranscriptionComplete;
 
+    /** Ties the transcriptions started from now on to Token. Cancelling it aborts them without broadcasting OnTranscriptionComplete. */
+    void SetCancellationToken(const FCancellationTokenPtr& Token);
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|ASR", meta = (ClampMin = "1", ToolTip = "Maximum seconds of audio kept for one transcription. Longer recordings are cut off; with VAD, longer speech segments are sent early."))
+    float MaxBufferedSeconds = 30.0f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|ASR", meta = (ToolTip = "Quality of the conversion to 16 kHz for WebRTC/TEN VAD and uploads. Higher quality keeps more of the speech band at more CPU cost."))
+    EResamplerQuality ResamplerQuality = EResamplerQuality::Balanced;
+
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|ASR|VAD", meta = (ToolTip = "Voice Activity Detection mode for automatic speech segmentation."))
     EVadMode VadMode = EVadMode::Disabled;
 
@@ -50,6 +79,15 @@ public:
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|ASR|VAD", meta = (EditCondition = "VadMode != EVadMode::Disabled", EditConditionHides, ClampMin = "0.1", ToolTip = "Minimum speech duration (in seconds) before audio is accepted for transcription."))
     float MinSpeechDuration = 0.5f;
 
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|ASR|VAD", meta = (EditCondition = "VadMode != EVadMode::Disabled", EditConditionHides, ClampMin = "1", ToolTip = "Consecutive speech frames required before speech is detected. Filters out clicks and short noises."))
+    int32 VadOnsetFrames = 2;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|ASR|VAD", meta = (EditCondition = "VadMode != EVadMode::Disabled", EditConditionHides, ClampMin = "0", ToolTip = "Milliseconds speech stays detected after the last speech frame, bridging short pauses between words."))
+    float VadHangoverMs = 200.0f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|ASR|VAD", meta = (EditCondition = "VadMode != EVadMode::Disabled", EditConditionHides, ClampMin = "0", ToolTip = "Milliseconds of audio before detected speech that are kept, so the first syllable is not cut off. Applied when play begins."))
+    float PreRollMs = 300.0f;
+
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|ASR|VAD", meta = (EditCondition = "VadMode == EVadMode::EnergyBased", EditConditionHides, ClampMin = "0.0", ClampMax = "1.0", ToolTip = "Energy threshold for speech detection when using Energy-based VAD."))
     float EnergyThreshold = 0.1f;
 
@@ -68,28 +106,74 @@ private:
 
     TArray<float> CapturedAudioData;
     FCriticalSection AudioDataLock;
+    bool bCaptureLimitReached = false;
+
+    // The capture callback only downmixes into CaptureRing; a worker thread drains it and runs VAD and uploads.
+    static constexpr int32 CaptureBufferFrames = 1024;
+    static constexpr int32 CaptureRingSeconds = 4;
+    FAudioRingBuffer CaptureRing;
+    TArray<float> DownmixBuffer;
+    std::atomic<int32> CaptureSampleRate{ 0 };
+    /** Rate the capture stream actually delivers, which can differ from the device's preferred rate. */
+    int32 GetCaptureSampleRate() const;
+    std::atomic<int32> DroppedCaptureSamples{ 0 };
+    std::atomic<int32> CaptureOverflows{ 0 };
+    FEvent* CaptureWorkerEvent = nullptr;
+    FEvent* CaptureDrainedEvent = nullptr;
+    FThreadSafeBool bStopCaptureWorker = false;
+    // Flushes requested by StopCapture, and the last request the worker has drained up to.
+    std::atomic<uint32> CaptureFlushRequests{ 0 };
+    std::atomic<uint32> CaptureFlushesDone{ 0 };
+    TFuture<void> CaptureWorker;
+    void RunCaptureWorker();
+    void ProcessCapturedAudio(const float* Samples, int32 NumSamples, int32 SampleRate);
+    void StopCaptureWorker();
 
     void SaveWavFile(const TArray<float>& InAudioData, FString OutputPath) const;
 
-    TArray<uint8> CreateMultiPartRequest(FString FilePath);
-    FString CurrentBoundary;
+    bool StopCapture(TArray<float>& OutAudio);
+
+    static FString CreateBoundary();
+    static TArray<uint8> CreateMultiPartRequest(const FString& Boundary, int32 FileSize, TFunctionRef<void(uint8*)> WriteFile);
+    void SendTranscriptionRequest(TArray<uint8>&& Content, const FString& Boundary, const FString& Description);
 
-    FString SanitizeString(const FString& String);
+    // In VAD mode transcriptions start on the capture thread, so the token is guarded.
+    FCancellationTokenPtr CancellationToken;
+    FCriticalSection CancellationTokenLock;
+    FCancellationTokenPtr GetCancellationToken();
 
 
-    bool IsSpeechFrame(const float* Samples, int32 NumSamples, int32 SampleRate);
+    // Fraction of the block's VAD frames that count as speech after onset and hangover smoothing.
+    float GetSpeechRatio(const float* Samples, int32 NumSamples, int32 SampleRate);
+    float ClassifyFrames(const float* Samples, int32 NumSamples, TArray<int16>& FrameBuffer, int32& FrameFill, int32 FrameSize, int32 FrameRate, TFunctionRef<int32(const int16*)> ClassifyFrame);
+    bool UpdateVadState(bool bFrameIsSpeech, float FrameMs);
+    void ResetVadState();
     int32 SilenceSamplesCount = 0;
 
+    // The most recent audio before speech starts, overwritten in place while no segment is open.
+    TArray<float> PreRollBuffer;
+    int32 PreRollWritePos = 0;
+    int32 PreRollNum = 0;
+    void WritePreRoll(const float* Samples, int32 NumSamples);
+    void TakePreRoll(TArray<float>& OutAudio);
+    bool bVadInSpeech = false;
+    int32 VadOnsetCount = 0;
+    float VadHangoverRemainingMs = 0.0f;
+
     Fvad* WebRtcInstance = nullptr;
     TArray<int16> WebRtcInputBuffer;
-    Audio::VectorOps::FAlignedFloatBuffer WebRtcResampledBuffer;
+    int32 WebRtcInputFill = 0;
+    FStreamingResampler WebRtcResampler;
+    TArray<float> WebRtcResampledBuffer;
     const int32 WebRtcSampleRate = 16000;
     const int32 WebRtcFrameDurationMs = 20;
     FCriticalSection WebRtcMutex;
 
     ten_vad_handle_t TenVadHandle = nullptr;
     TArray<int16> TenVadInputBuffer;
-    Audio::VectorOps::FAlignedFloatBuffer TenVadResampledBuffer;
+    int32 TenVadInputFill = 0;
+    FStreamingResampler TenVadResampler;
+    TArray<float> TenVadResampledBuffer;
     const int32 TenVadSampleRate = 16000;
     const size_t TenVadHopSize = 256;
     FCriticalSection TenVadMutex;
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Finds [[action: <command>]] tags in text that may arrive in arbitrary pieces.
+ *
+ * The matcher keeps its position inside a partially received tag between calls, so a tag split across any
+ * number of streamed tokens is reported as soon as its closing "]]" arrives. Matching follows the pattern
+ * \[\[action: (.+?)\]\] : the command is at least one character, stops at the first "]]", and may not
+ * contain a line break.
+ */
+class LOCALAIFORNPCS_API FActionTagMatcher
+{
+public:
+    FActionTagMatcher();
+
+    void Reset();
+
+    /** Scans the next piece of text. The command of every tag completed by it is appended to OutCommands. */
+    void Feed(FStringView Text, TArray<FString>& OutCommands);
+
+    /** Scans a complete text in one go. */
+    static void FindAll(FStringView Text, TArray<FString>& OutCommands);
+
+private:
+    /** Number of characters of "[[action: " matched so far. */
+    int32 PrefixMatched;
+
+    bool bInCommand;
+    FString Command;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include <atomic>
+
+/**
+ * Single-producer, single-consumer ring of audio samples.
+ *
+ * Write is meant for the audio capture callback and Read for one worker thread. Neither locks nor allocates, so the
+ * callback can never stall on the worker. When the ring is full, Write drops what does not fit and reports it.
+ */
+class LOCALAIFORNPCS_API FAudioRingBuffer
+{
+public:
+    /** Allocates room for at least MinCapacity samples, rounded up to a power of two. Not thread-safe. */
+    void Init(int32 MinCapacity);
+
+    /** Producer side. Returns the number of samples written. */
+    int32 Write(const float* Samples, int32 NumSamples);
+
+    /** Consumer side. Returns the number of samples read. */
+    int32 Read(float* OutSamples, int32 MaxSamples);
+
+    int32 Num() const;
+    int32 Capacity() const { return Buffer.Num(); }
+
+private:
+    TArray<float> Buffer;
+    uint32 Mask = 0;
+
+    // Free-running indices; their difference is the fill level even after they wrap.
+    std::atomic<uint32> WriteIndex{ 0 };
+    std::atomic<uint32> ReadIndex{ 0 };
+};
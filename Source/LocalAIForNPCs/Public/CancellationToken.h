@@ -0,0 +1,76 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Async.h"
+#include "Templates/IsInvocable.h"
+#include "UObject/WeakObjectPtrTemplates.h"
+
+/**
+ * Cooperative cancellation for the async work of one conversation turn.
+ *
+ * Worker threads poll IsCancelled() between steps. Work that blocks on something it cannot poll, such as an HTTP
+ * request, registers a callback that unblocks it. Cancel() is one-way and may be called from any thread.
+ */
+class LOCALAIFORNPCS_API FCancellationToken
+{
+public:
+    bool IsCancelled() const { return bCancelled; }
+
+    /** Marks the token as cancelled and runs every registered callback once, on the calling thread. */
+    void Cancel();
+
+    /** Runs Callback when the token is cancelled, or right away if it already is. Returns a handle for RemoveCallback. */
+    uint32 AddCallback(TFunction<void()> Callback);
+    void RemoveCallback(uint32 Handle);
+
+private:
+    FThreadSafeBool bCancelled;
+    FCriticalSection Mutex;
+    TArray<TPair<uint32, TFunction<void()>>> Callbacks;
+    uint32 NextHandle = 1;
+};
+
+typedef TSharedPtr<FCancellationToken, ESPMode::ThreadSafe> FCancellationTokenPtr;
+
+/** Keeps a cancellation callback registered for as long as the scope lives. A null token registers nothing. */
+class LOCALAIFORNPCS_API FCancellationScope
+{
+public:
+    FCancellationScope(const FCancellationTokenPtr& InToken, TFunction<void()> Callback);
+    ~FCancellationScope();
+
+    UE_NONCOPYABLE(FCancellationScope);
+
+private:
+    FCancellationTokenPtr Token;
+    uint32 Handle = 0;
+};
+
+/**
+ * Queues Task on the game thread like AsyncTask, but drops it if Owner has been destroyed or Token cancelled by
+ * the time it runs. Task may therefore use the owner freely.
+ *
+ * Build Owner on the game thread, before handing it to a worker: a worker must not touch the owner except through
+ * this call. Task may take the owner as its only parameter, so workers can queue it without holding a raw pointer.
+ */
+template <typename OwnerType, typename TaskType>
+void AsyncTaskForTurn(const TWeakObjectPtr<OwnerType>& Owner, const FCancellationTokenPtr& Token, TaskType&& Task)
+{
+    AsyncTask(ENamedThreads::GameThread, [Owner, Token, Task = Forward<TaskType>(Task)]() mutable
+        {
+            OwnerType* Pinned = Owner.Get();
+            if (!Pinned || (Token.IsValid() && Token->IsCancelled()))
+            {
+                return;
+            }
+
+            if constexpr (TIsInvocable<typename TDecay<TaskType>::Type, OwnerType*>::Value)
+            {
+                Task(Pinned);
+            }
+            else
+            {
+                Task();
+            }
+        });
+}
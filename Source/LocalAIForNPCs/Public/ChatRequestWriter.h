@@ -0,0 +1,56 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FChatMessage;
+
+struct FChatRequestParams
+{
+    bool bStream = false;
+    bool bCachePrompt = false;
+    int32 SlotId = -1;
+
+    /** Per-turn text prepended to the last message only. It is never cached, so earlier turns stay byte-identical. */
+    const FString* TurnContext = nullptr;
+
+    /** GBNF grammar the server constrains sampling with. Empty or null for unconstrained output. */
+    const FString* Grammar = nullptr;
+
+    /** Maximum number of tokens to generate (n_predict). 0 only prefills the prompt; negative leaves the server default. */
+    int32 MaxTokens = -1;
+};
+
+/**
+ * Serializes chat completion requests straight into a reusable UTF-8 buffer.
+ *
+ * The escaped bytes of the system message and of every history entry already sent are kept between requests,
+ * so a new turn only escapes the messages appended since the previous one. The cache is rebuilt automatically
+ * when the system message or history prefix changes or the history shrinks; call Invalidate() after any other in-place edit.
+ */
+class LOCALAIFORNPCS_API FChatRequestWriter
+{
+public:
+    void Invalidate();
+
+    /**
+     * Writes the complete JSON body to Out, replacing its contents but keeping its allocation. HistoryPrefix is
+     * prepended to the first history message, so text that changes over a conversation stays out of the system prompt.
+     */
+    void Write(TArray<uint8>& Out, const FChatRequestParams& Params, const FString& SystemMessage, const FString& HistoryPrefix, const TArray<FChatMessage>& History);
+
+    static void AppendRaw(TArray<uint8>& Out, const ANSICHAR* Str);
+    static void AppendInt(TArray<uint8>& Out, int64 Value);
+    /** Appends Str as a quoted, escaped JSON string encoded in UTF-8. */
+    static void AppendString(TArray<uint8>& Out, const FString& Str);
+    static void AppendEscaped(TArray<uint8>& Out, const FString& Str);
+
+private:
+    void AppendMessage(const FString& Role, const FString& Prefix, const FString& Content);
+
+    /** Comma-prefixed, already escaped message objects. */
+    TArray<uint8> CachedMessages;
+    int32 NumCachedMessages = 0;
+    bool bHasCachedSystem = false;
+    FString CachedSystemMessage;
+    FString CachedHistoryPrefix;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/LruCache.h"
+
+/**
+ * Content-addressed store of embedding vectors.
+ *
+ * Vectors are keyed by a hash of the embedding model identity and the embedded text, so unchanged knowledge chunks
+ * can be reused across runs from a compact binary file. Each vector records the last session that used it, and a save
+ * keeps only the most recently used MaxEntries. Player queries are served from a separate in-memory LRU.
+ * All methods are thread-safe.
+ */
+class LOCALAIFORNPCS_API FEmbeddingCache
+{
+public:
+    explicit FEmbeddingCache(int32 QueryCapacity = 128);
+
+    static uint64 MakeKey(const FString& ModelId, const FString& Text);
+
+    /** Replaces the stored vectors with the contents of FilePath. Returns false if the file is missing or invalid. */
+    bool Load(const FString& FilePath);
+
+    /**
+     * Writes the stored vectors to FilePath if anything changed since the last load or save, evicting the least
+     * recently used ones beyond MaxEntries first. The file is written beside FilePath and moved over it when complete,
+     * so a crash never leaves a truncated cache.
+     */
+    bool Save(const FString& FilePath);
+
+    /** Caps the number of stored vectors kept by Save. 0 keeps every vector. */
+    void SetMaxEntries(int32 InMaxEntries);
+
+    /** Copies the vector stored for Key and marks it as used in this session. */
+    bool Find(uint64 Key, TArray<float>& OutEmbedding);
+    void Add(uint64 Key, const TArray<float>& Embedding);
+    int32 Num() const;
+
+    bool FindQuery(uint64 Key, TArray<float>& OutEmbedding);
+    void AddQuery(uint64 Key, const TArray<float>& Embedding);
+
+private:
+    static constexpr uint32 FileMagic = 0x4345414C; // "LAEC"
+    static constexpr uint32 FileVersion = 2;
+
+    void EvictLeastRecentlyUsed();
+
+    mutable FCriticalSection Mutex;
+
+    int32 Dimension = 0;
+    TMap<uint64, int32> RowByKey;
+    TArray<uint64> Keys;
+    TArray<float> Rows;
+    bool bDirty = false;
+
+    /** Session in which each row was last used. Every load starts a new session. */
+    TArray<uint32> LastUsed;
+    uint32 Session = 1;
+    int32 MaxEntries = 0;
+
+    TLruCache<uint64, TArray<float>> QueryCache;
+};
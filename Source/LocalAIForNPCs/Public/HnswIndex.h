@@ -0,0 +1,79 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Math/RandomStream.h"
+
+class FKnowledgeIndex;
+struct FKnowledgeMatch;
+
+struct FHnswParams
+{
+    /** Maximum links per node on the upper layers. The bottom layer allows twice as many. */
+    int32 M = 16;
+
+    /** Size of the candidate list used while inserting. Higher builds a better graph, more slowly. */
+    int32 EfConstruction = 200;
+};
+
+/**
+ * Hierarchical navigable small world graph over the rows of an FKnowledgeIndex.
+ *
+ * The graph only stores links; vectors and scoring stay in the knowledge index, so every operation takes the index
+ * the graph was built for. Rows must be inserted in order. Searching is safe from several threads at once, inserting is not.
+ */
+class LOCALAIFORNPCS_API FHnswIndex
+{
+public:
+    explicit FHnswIndex(const FHnswParams& InParams = FHnswParams());
+
+    const FHnswParams& GetParams() const { return Params; }
+    int32 Num() const { return Levels.Num(); }
+
+    /** Links the next row of Vectors into the graph. Row must equal Num(). */
+    void Insert(const FKnowledgeIndex& Vectors, int32 Row);
+
+    /** Default size of the candidate list used while searching. */
+    static constexpr int32 DefaultEfSearch = 64;
+
+    /**
+     * Finds up to K rows with a score of at least MinScore for a query prepared by Vectors. Sorted by descending score.
+     * EfSearch is the candidate list size; higher improves recall at the cost of latency.
+     */
+    void Search(const FKnowledgeIndex& Vectors, const float* Query, int32 K, int32 EfSearch, float MinScore, TArray<FKnowledgeMatch>& OutMatches) const;
+
+    /** Writes the graph to FilePath, tagged with a key identifying the vectors it was built for. */
+    bool Save(const FString& FilePath, uint64 ContentKey) const;
+
+    /** Reads a graph previously saved for the same content key and node count. */
+    bool Load(const FString& FilePath, uint64 ContentKey, int32 ExpectedNodes);
+
+private:
+    static constexpr uint32 FileMagic = 0x57534E48; // "HNSW"
+    static constexpr uint32 FileVersion = 1;
+
+    int32 GetMaxLinks(int32 Level) const { return Level == 0 ? Params.M * 2 : Params.M; }
+    int32* GetLinks(int32 Node, int32 Level, int32*& OutCount);
+    const int32* GetLinks(int32 Node, int32 Level, int32& OutCount) const;
+
+    int32 RandomLevel();
+    int32 GreedyClosest(const FKnowledgeIndex& Vectors, const float* Query, int32 Entry, int32 FromLevel, int32 ToLevel) const;
+    void SearchLayer(const FKnowledgeIndex& Vectors, const float* Query, int32 Entry, int32 Ef, int32 Level, TArray<FKnowledgeMatch>& OutNearest) const;
+    void SelectNeighbors(const FKnowledgeIndex& Vectors, TArray<FKnowledgeMatch>& Candidates, int32 MaxLinks) const;
+    void Connect(const FKnowledgeIndex& Vectors, int32 Node, int32 Neighbor, int32 Level);
+
+    FHnswParams Params;
+    FRandomStream Random;
+
+    int32 EntryPoint = -1;
+    int32 MaxLevel = -1;
+
+    /** Top layer of each node. */
+    TArray<int32> Levels;
+
+    /** Bottom-layer links, GetMaxLinks(0) slots per node, with the used count per node. */
+    TArray<int32> BaseLinks;
+    TArray<int32> BaseLinkCounts;
+
+    /** Links for layers 1..Levels[Node], M slots per layer, prefixed by the used count of each layer. */
+    TArray<TArray<int32>> UpperLinks;
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Splits knowledge files into overlapping chunks of sentences.
+ *
+ * Files are streamed in fixed-size blocks, so memory use per file is bounded by the block size plus the chunks it
+ * produces. Overlong sentences are cut so text without terminators does not break that bound. Several files are chunked in parallel on the task graph; the result keeps file order.
+ */
+class LOCALAIFORNPCS_API FKnowledgeChunker
+{
+public:
+    FKnowledgeChunker(int32 InSentencesPerChunk, int32 InSentenceOverlap);
+
+    /**
+     * Expands a knowledge path into a sorted list of files. The path may be a single file, a directory (searched
+     * recursively for .txt and .md files), a wildcard pattern such as "Lore/*.txt", or several of these separated by ';'.
+     */
+    static TArray<FString> FindKnowledgeFiles(const FString& KnowledgePath);
+
+    /** Chunks every file in parallel. Chunks are returned in file order, then document order. */
+    TArray<FString> ChunkFiles(const TArray<FString>& Files) const;
+
+    /** Streams one file and appends its chunks. Returns false if the file could not be read. */
+    bool ChunkFile(const FString& FilePath, TArray<FString>& OutChunks) const;
+
+private:
+    static constexpr int32 BlockSize = 64 * 1024;
+
+    int32 SentencesPerChunk;
+    int32 Step;
+};
@@ -0,0 +1,155 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HnswIndex.h"
+#include "LexicalIndex.h"
+
+struct FKnowledgeMatch
+{
+    int32 Index;
+    float Score;
+};
+
+enum class EEmbeddingStorage : uint8
+{
+    /** Full precision, 4 bytes per dimension. */
+    Float,
+
+    /** One signed byte per dimension plus a float scale per row. */
+    Int8,
+
+    /** One sign bit per dimension plus a float scale per row. */
+    Binary
+};
+
+/**
+ * Exact cosine-similarity index over knowledge chunks.
+ *
+ * Embeddings are normalized on insertion and stored as one 16-byte aligned, row-major float matrix whose rows are
+ * zero-padded to a multiple of four, so a query is a single pass of SIMD dot products. Chunk texts live in a separate
+ * pool and are only touched for the rows that make it into the result.
+ *
+ * With Int8 or Binary storage the matrix is quantized instead. A scan then ranks every row with an integer dot product
+ * or Hamming distance, and rescores the best K * RescoreFactor candidates against the float query. The float rows are
+ * not kept, so the rescore uses the dequantized rows: it recovers the ordering lost to quantizing the query, but the
+ * scores still carry the rows' quantization error. Int8 scores are close to the float ones; Binary scores are coarse,
+ * which also makes a similarity threshold less precise.
+ *
+ * An optional HNSW graph can be built over the rows, in which case Search walks the graph instead of scanning.
+ * An optional BM25 index over the texts serves lexical and hybrid queries. An index built only with AddText has no
+ * vectors and serves lexical queries alone.
+ */
+class LOCALAIFORNPCS_API FKnowledgeIndex
+{
+public:
+    explicit FKnowledgeIndex(EEmbeddingStorage InStorage = EEmbeddingStorage::Float);
+    ~FKnowledgeIndex();
+
+    FKnowledgeIndex(const FKnowledgeIndex&) = delete;
+    FKnowledgeIndex& operator=(const FKnowledgeIndex&) = delete;
+
+    void Reserve(int32 InDimension, int32 NumRows);
+
+    /** Normalizes and appends an embedding. Returns false if its dimension does not match the index or its norm is zero. */
+    bool Add(const FString& Text, const TArray<float>& Embedding);
+
+    /** Appends a chunk without an embedding. Only valid for lexical-only indices, which never hold vectors. */
+    void AddText(const FString& Text);
+
+    int32 Num() const { return NumRows; }
+    bool HasVectors() const { return Dimension > 0; }
+    int32 GetDimension() const { return Dimension; }
+    FStringView GetText(int32 Index) const;
+
+    typedef TArray<float, TAlignedHeapAllocator<16>> FPreparedQuery;
+
+    /** Normalizes and pads a query so it can be scored against rows. Returns false for a mismatched or zero query. */
+    bool PrepareQuery(const TArray<float>& Query, FPreparedQuery& OutPrepared) const;
+
+    EEmbeddingStorage GetStorage() const { return Storage; }
+
+    /** Bytes used by the stored vectors, excluding texts and the graph. */
+    SIZE_T GetVectorBytes() const;
+
+    /** Returns a row in prepared-query form: the stored row itself for float storage, otherwise decoded into Scratch. */
+    const float* GetRowQuery(int32 Index, FPreparedQuery& Scratch) const;
+
+    /** Cosine similarity between a prepared query (or another row) and a row, using the dequantized row if quantized. */
+    float ScoreRow(const float* PreparedQuery, int32 Index) const;
+
+    /** Default number of candidates per requested result rescored by a quantized scan. */
+    static constexpr int32 DefaultRescoreFactor = 4;
+
+    /**
+     * Finds up to K rows with a cosine similarity of at least MinScore, sorted by descending score. EfSearch is the
+     * HNSW candidate list size and is ignored without a graph. RescoreFactor only applies to a quantized scan.
+     */
+    void Search(const TArray<float>& Query, int32 K, float MinScore, TArray<FKnowledgeMatch>& OutMatches, int32 EfSearch = FHnswIndex::DefaultEfSearch, int32 RescoreFactor = DefaultRescoreFactor) const;
+
+    /** Like Search, for a query already prepared with PrepareQuery. */
+    void SearchPrepared(const float* PreparedQuery, int32 K, float MinScore, TArray<FKnowledgeMatch>& OutMatches, int32 EfSearch = FHnswIndex::DefaultEfSearch, int32 RescoreFactor = DefaultRescoreFactor) const;
+
+    /** Builds the BM25 index over every chunk text. */
+    void BuildLexicalIndex();
+    bool HasLexicalIndex() const { return Lexical.IsValid(); }
+
+    /** Finds up to K chunks sharing terms with Query with a normalized BM25 score of at least MinScore, best first. */
+    void SearchLexical(FStringView Query, int32 K, float MinScore, TArray<FKnowledgeMatch>& OutMatches) const;
+
+    /**
+     * Fuses vector and BM25 retrieval. A candidate from either side is kept if its cosine similarity reaches
+     * MinSimilarity or its normalized BM25 score (see SearchLexical) reaches MinLexicalScore. The kept candidates are
+     * ranked by (1 - LexicalWeight) * cosine similarity + LexicalWeight * normalized BM25 score.
+     */
+    void SearchHybrid(const TArray<float>& QueryEmbedding, FStringView QueryText, int32 K, float LexicalWeight, float MinSimilarity, float MinLexicalScore, TArray<FKnowledgeMatch>& OutMatches, int32 EfSearch = FHnswIndex::DefaultEfSearch, int32 RescoreFactor = DefaultRescoreFactor) const;
+
+    /** Always scans every row, regardless of the graph. */
+    void SearchExact(const float* PreparedQuery, int32 K, float MinScore, TArray<FKnowledgeMatch>& OutMatches, int32 RescoreFactor = DefaultRescoreFactor) const;
+
+    /** Links every row not yet in the graph, creating the graph on first use. */
+    void BuildGraph(const FHnswParams& Params);
+    bool HasGraph() const { return Graph.IsValid(); }
+    bool SaveGraph(const FString& FilePath) const;
+    bool LoadGraph(const FString& FilePath, const FHnswParams& Params);
+
+    /**
+     * Fraction of exact top-K results the graph also returns, averaged over NumQueries queries. Each query is a row
+     * moved away from itself by seeded random noise, so it resembles a real query rather than an exact match.
+     */
+    float MeasureGraphRecall(int32 K, int32 NumQueries, int32 EfSearch) const;
+
+    /** Hash of the dimension and chunk texts, used to match saved graphs to their content. */
+    uint64 GetContentKey() const;
+
+private:
+    static int32 GetStride(int32 InDimension) { return Align(InDimension, 4); }
+    static float Dot(const float* RESTRICT A, const float* RESTRICT B, int32 Stride);
+    void SetDimension(int32 InDimension);
+    void Grow(int32 NewCapacity);
+    void EncodeRow(const float* Normalized);
+    void SearchQuantized(const float* PreparedQuery, int32 K, float MinScore, TArray<FKnowledgeMatch>& OutMatches, int32 RescoreFactor) const;
+
+    EEmbeddingStorage Storage;
+
+    float* Rows = nullptr;
+    int32 Dimension = 0;
+    int32 Stride = 0;
+    int32 NumRows = 0;
+    int32 Capacity = 0;
+
+    /** Dequantization scale per row, for Int8 and Binary storage. */
+    TArray<float> RowScales;
+
+    /** Int8 storage: Stride bytes per row. */
+    TArray<int8> Int8Rows;
+
+    /** Binary storage: WordsPerRow sign-bit words per row. */
+    TArray<uint64> BinaryRows;
+    int32 WordsPerRow = 0;
+
+    TArray<TCHAR> TextPool;
+    TArray<int32> TextOffsets;
+
+    TUniquePtr<FHnswIndex> Graph;
+    TUniquePtr<FLexicalIndex> Lexical;
+};
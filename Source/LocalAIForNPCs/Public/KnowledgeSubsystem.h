@@ -0,0 +1,83 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "Async/Future.h"
+#include "KnowledgeIndex.h"
+#include "EmbeddingCache.h"
+#include "KnowledgeSubsystem.generated.h"
+
+typedef TSharedPtr<const FKnowledgeIndex, ESPMode::ThreadSafe> FKnowledgeHandle;
+
+/**
+ * Thread-safe table of shared knowledge indices, keyed by their source path and every setting that changes their
+ * contents. Each key is built once: the first caller builds it and any caller asking meanwhile waits on the same future.
+ */
+class LOCALAIFORNPCS_API FKnowledgeRegistry
+{
+public:
+    /** Registers an NPC's interest in Key, paired with Release. */
+    void AddReference(const FString& Key);
+
+    /** Drops an NPC's interest in Key. The index is freed when no NPC and no pending lookup holds it. */
+    void Release(const FString& Key);
+
+    /**
+     * Returns the index for Key, running Build if no one has built it yet or blocking while another thread does. If the
+     * build being waited on fails, the waiter retries. Returns null if Key is no longer referenced.
+     */
+    FKnowledgeHandle GetOrBuild(const FString& Key, TFunctionRef<FKnowledgeHandle()> Build);
+
+    /**
+     * Returns the embedding store for the cache file at FilePath, loading it on first use. Every build sharing the file
+     * shares one store, so their additions all reach the file. The store is freed once no build holds it.
+     * MaxEntries only applies when the store is created.
+     */
+    TSharedRef<FEmbeddingCache, ESPMode::ThreadSafe> GetEmbeddingStore(const FString& FilePath, int32 MaxEntries);
+
+    void Empty();
+
+private:
+    struct FKnowledgeEntry
+    {
+        TSharedFuture<FKnowledgeHandle> Index;
+        uint32 BuildId = 0;
+        int32 References = 0;
+    };
+
+    FCriticalSection Mutex;
+    TMap<FString, FKnowledgeEntry> Entries;
+    uint32 NextBuildId = 0;
+
+    TMap<FString, TWeakPtr<FEmbeddingCache, ESPMode::ThreadSafe>> EmbeddingStores;
+};
+
+typedef TSharedRef<FKnowledgeRegistry, ESPMode::ThreadSafe> FKnowledgeRegistryRef;
+
+/**
+ * Owns the knowledge indices shared by every NPC in the game instance.
+ *
+ * NPCs pointed at the same knowledge with the same settings share one read-only index, which is dropped once the last
+ * NPC using it releases it. Worker threads hold the registry rather than the subsystem, so a build still running when
+ * the game instance shuts down never touches a destroyed object.
+ */
+UCLASS()
+class LOCALAIFORNPCS_API UKnowledgeSubsystem : public UGameInstanceSubsystem
+{
+    GENERATED_BODY()
+
+public:
+    /** Registers an NPC's interest in Key. Call on the game thread, paired with ReleaseKnowledge. */
+    void AddKnowledgeReference(const FString& Key) { Registry->AddReference(Key); }
+
+    /** Drops an NPC's interest in Key. Call on the game thread. */
+    void ReleaseKnowledge(const FString& Key) { Registry->Release(Key); }
+
+    /** The registry behind this subsystem, for worker threads. Call on the game thread. */
+    FKnowledgeRegistryRef GetRegistry() const { return Registry; }
+
+    virtual void Deinitialize() override;
+
+private:
+    FKnowledgeRegistryRef Registry = MakeShared<FKnowledgeRegistry, ESPMode::ThreadSafe>();
+};
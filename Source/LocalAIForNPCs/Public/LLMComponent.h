@@ -2,6 +2,12 @@
 
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
+#include "ChatRequestWriter.h"
+#include "EmbeddingCache.h"
+#include "KnowledgeIndex.h"
+#include "KnowledgeSubsystem.h"
+#include "StreamSentenceSegmenter.h"
+#include "CancellationToken.h"
 #include "LLMComponent.generated.h"
 
 USTRUCT()
@@ -12,6 +18,8 @@ struct FChatMessage
     FString Role;
     UPROPERTY()
     FString Content;
+    UPROPERTY()
+    int32 TokenCount = -1;
 };
 
 UENUM(BlueprintType)
@@ -19,17 +27,24 @@ enum class ERagMode : uint8
 {
     Disabled               UMETA(DisplayName = "Disabled"),
     Embedding              UMETA(DisplayName = "Embedding"),
-    EmbeddingPlusReranker  UMETA(DisplayName = "Embedding + Reranker")
+    EmbeddingPlusReranker  UMETA(DisplayName = "Embedding + Reranker"),
+    Lexical                UMETA(DisplayName = "Lexical (BM25)"),
+    Hybrid                 UMETA(DisplayName = "Hybrid (BM25 + Embedding)")
 };
 
-USTRUCT()
-struct FKnowledgeEntry
+UENUM(BlueprintType)
+enum class EKnowledgeIndexType : uint8
 {
-    GENERATED_BODY()
-    UPROPERTY()
-    FString Text;
-    UPROPERTY()
-    TArray<float> Embedding;
+    BruteForce  UMETA(DisplayName = "Brute Force"),
+    HNSW        UMETA(DisplayName = "HNSW")
+};
+
+UENUM(BlueprintType)
+enum class EEmbeddingQuantization : uint8
+{
+    None    UMETA(DisplayName = "None (Float)"),
+    Int8    UMETA(DisplayName = "Int8"),
+    Binary  UMETA(DisplayName = "Binary")
 };
 
 USTRUCT(BlueprintType)
@@ -59,6 +74,8 @@ struct FNpcObject
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnResponseReceived, const FString&, Response);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnStreamTokenReceived, const FString&, Token, bool, bDone);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnStreamChunkReceived, const FString&, Chunk, bool, bDone);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnKnowledgeProgress, int32, ChunksDone, int32, TotalChunks);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnKnowledgeReady, int32, NumChunks);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnActionReceived, const FString&, Action, AActor*, Object);
 
 UCLASS(ClassGroup = (LocalAIForNPCs), meta = (BlueprintSpawnableComponent))
@@ -78,6 +95,27 @@ public:
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM", meta = (ToolTip = "If enabled, responses stream token-by-token. If disabled, responses are returned all at once."))
     bool bStream = false;
 
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|Cache", meta = (ToolTip = "If enabled, the server keeps this conversation's prompt in its KV cache so follow-up turns only prefill the newly appended tokens."))
+    bool bCachePrompt = true;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|Cache", meta = (EditCondition = "bCachePrompt", EditConditionHides, ClampMin = "1", ToolTip = "Number of parallel slots the llama.cpp server was started with (--parallel). Above 1, NPCs are pinned to slots and spread across them. At 1 with no SlotId, no slot is requested and the server picks one itself."))
+    int32 NumServerSlots = 1;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|Cache", meta = (EditCondition = "bCachePrompt", EditConditionHides, ClampMin = "-1", ToolTip = "Server slot this NPC is pinned to. Use -1 to pick the least used slot automatically when NumServerSlots is above 1."))
+    int32 SlotId = -1;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|Cache", meta = (EditCondition = "bCachePrompt", EditConditionHides, ClampMin = "0", ToolTip = "Minimum seconds between two prompt warm-ups of this conversation."))
+    float WarmUpCooldownSeconds = 30.0f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|Cache", meta = (EditCondition = "bCachePrompt", EditConditionHides, ClampMin = "1", ToolTip = "Maximum number of prompt warm-ups in flight at once on this server, across all NPCs."))
+    int32 MaxConcurrentWarmUps = 1;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|History", meta = (ClampMin = "0", ToolTip = "Maximum number of tokens of chat history sent with each request. Older turns are dropped once the budget is exceeded. Use 0 for no limit."))
+    int32 MaxHistoryTokens = 0;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|History", meta = (EditCondition = "MaxHistoryTokens > 0", EditConditionHides, ToolTip = "If enabled, turns dropped from the history are summarized in the background and the summary is prepended to the oldest message kept."))
+    bool bSummarizeEvictedHistory = true;
+
     UFUNCTION(BlueprintCallable, Category = "LocalAIForNPCs|LLM")
     void SendChatMessage(FString Message);
 
@@ -93,6 +131,12 @@ public:
     UFUNCTION(BlueprintCallable, Category = "LocalAIForNPCs|LLM")
     void ClearChatHistory();
 
+    UFUNCTION(BlueprintCallable, Category = "LocalAIForNPCs|LLM|Cache", meta = (ToolTip = "Prefill the system prompt and history on this conversation's server slot without generating, so the next message only pays for its own tokens. Rate-limited; does nothing if the slot already holds the conversation."))
+    void WarmUpPrompt();
+
+    UFUNCTION(BlueprintCallable, Category = "LocalAIForNPCs|LLM|Cache", meta = (ToolTip = "Abort a prompt warm-up that is still in flight."))
+    void CancelWarmUp();
+
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (ToolTip = "Retrieval mode. Controls whether external knowledge is used and how it is retrieved."))
     ERagMode RagMode = ERagMode::Disabled;
 
@@ -102,7 +146,7 @@ public:
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode == ERagMode::EmbeddingPlusReranker", EditConditionHides, ToolTip = "Port for the reranker server used in advanced RAG pipelines."))
     int32 RerankerPort = 8082;
 
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled", EditConditionHides, ToolTip = "Path to the knowledge directory or file(s) used for retrieval."))
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled", EditConditionHides, ToolTip = "Knowledge used for retrieval: a file, a directory (searched recursively for .txt and .md files), a wildcard pattern such as Lore/*.txt, or several of these separated by ';'."))
     FString KnowledgePath;
 
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled", EditConditionHides, ClampMin = "1", ToolTip = "Number of top embedding results to retrieve before reranking or passing to the model."))
@@ -117,42 +161,178 @@ public:
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled", EditConditionHides, ClampMin = "0", ToolTip = "Overlap between chunks, in number of sentences. Prevents context fragmentation."))
     int32 SentenceOverlap = 1;
 
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled", EditConditionHides, ClampMin = "-1", ClampMax = "1", ToolTip = "Minimum cosine similarity a retrieved chunk must meet to be considered relevant."))
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled", EditConditionHides, ClampMin = "-1", ClampMax = "1", ToolTip = "Minimum cosine similarity a retrieved chunk must meet to be considered relevant. In Hybrid mode a chunk is also kept if it meets the lexical score threshold instead."))
     float SimilarityThreshold = 0.5f;
 
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode == ERagMode::Lexical || RagMode == ERagMode::Hybrid", EditConditionHides, ClampMin = "0", ClampMax = "1", ToolTip = "Minimum keyword match a chunk must reach in Lexical mode, or to be kept in Hybrid mode without meeting the similarity threshold. The BM25 score is divided by the best score the query's words could reach, so 1 means every word matched strongly. Common words such as 'the' or 'how' are ignored."))
+    float LexicalScoreThreshold = 0.2f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode == ERagMode::Hybrid", EditConditionHides, ClampMin = "0", ClampMax = "1", ToolTip = "Share of the hybrid ranking score taken from BM25 keyword matching. The rest comes from embedding similarity. Which chunks are kept is decided by the two thresholds."))
+    float LexicalWeight = 0.5f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled", EditConditionHides, ClampMin = "0", ToolTip = "Maximum number of characters of retrieved context added to a single turn."))
+    int32 MaxRagContextCharacters = 2000;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled", EditConditionHides, ClampMin = "1", ToolTip = "Number of knowledge chunks sent in each embedding request."))
+    int32 EmbeddingBatchSize = 32;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled", EditConditionHides, ClampMin = "1", ToolTip = "Maximum number of embedding requests in flight while generating knowledge."))
+    int32 MaxConcurrentEmbeddingRequests = 4;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled", EditConditionHides, ToolTip = "How knowledge is searched. Brute force is exact; HNSW is approximate but scales to very large knowledge bases."))
+    EKnowledgeIndexType KnowledgeIndexType = EKnowledgeIndexType::BruteForce;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled && KnowledgeIndexType == EKnowledgeIndexType::HNSW", EditConditionHides, ClampMin = "2", ClampMax = "64", ToolTip = "Links per node in the HNSW graph. Higher improves recall and uses more memory."))
+    int32 HnswM = 16;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled && KnowledgeIndexType == EKnowledgeIndexType::HNSW", EditConditionHides, ClampMin = "2", ToolTip = "Candidate list size while building the HNSW graph. Higher builds a better graph, more slowly."))
+    int32 HnswEfConstruction = 200;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled && KnowledgeIndexType == EKnowledgeIndexType::HNSW", EditConditionHides, ClampMin = "1", ToolTip = "Candidate list size while searching the HNSW graph. Higher improves recall at the cost of latency."))
+    int32 HnswEfSearch = 64;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled && KnowledgeIndexType == EKnowledgeIndexType::HNSW", EditConditionHides, ClampMin = "0", ToolTip = "Number of test queries, each a knowledge chunk perturbed with random noise, used to log HNSW recall against the exact scan after building. 0 disables the measurement."))
+    int32 HnswRecallQueries = 0;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled", EditConditionHides, ToolTip = "How knowledge embeddings are stored in memory. Int8 uses about 4x less memory and Binary about 32x less, at some cost in retrieval accuracy."))
+    EEmbeddingQuantization EmbeddingQuantization = EEmbeddingQuantization::None;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled && EmbeddingQuantization != EEmbeddingQuantization::None", EditConditionHides, ClampMin = "1", ToolTip = "With quantized storage, how many candidates per requested result are rescored with the full-precision query. The rescore runs against the quantized rows, so scores keep their quantization error; mostly noticeable with Binary."))
+    int32 QuantizedRescoreFactor = 4;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled", EditConditionHides, ToolTip = "Reuse knowledge embeddings from the on-disk cache under Saved/ and keep recent query embeddings in memory."))
+    bool bUseEmbeddingCache = true;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled && bUseEmbeddingCache", EditConditionHides, ToolTip = "Identity of the embedding model, used to key cached embeddings. Leave empty to ask the embedding server."))
+    FString EmbeddingModelName;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled && bUseEmbeddingCache", EditConditionHides, ClampMin = "1", ToolTip = "Number of recent player query embeddings kept in memory."))
+    int32 QueryEmbeddingCacheSize = 128;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled && bUseEmbeddingCache", EditConditionHides, ClampMin = "0", ToolTip = "Maximum number of knowledge embeddings kept in the on-disk cache per embedding model. The least recently used are evicted when it is saved. Use 0 for no limit."))
+    int32 MaxEmbeddingCacheEntries = 100000;
+
+    UPROPERTY(BlueprintAssignable, Category = "LocalAIForNPCs|LLM|RAG", meta = (ToolTip = "Broadcast while knowledge is being generated, after each embedding batch completes."))
+    FOnKnowledgeProgress OnKnowledgeProgress;
+
+    UPROPERTY(BlueprintAssignable, Category = "LocalAIForNPCs|LLM|RAG", meta = (ToolTip = "Broadcast once knowledge generation has finished and retrieval is available."))
+    FOnKnowledgeReady OnKnowledgeReady;
+
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|Actions", meta = (ToolTip = "List of actions the NPC is allowed to perform. Used for function-calling-style model outputs."))
     TArray<FNpcAction> KnownActions;
 
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|Actions", meta = (ToolTip = "List of objects the NPC can reference or interact with, usable by the model during reasoning."))
     TArray<FNpcObject> KnownObjects;
 
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|Actions", meta = (ToolTip = "Constrain generation with a grammar built from the known actions and objects, so only valid action tags can be produced. Also shortens the actions system message. The grammar forbids the characters [, * and < anywhere in normal dialogue, which blocks *starred* and <tagged> stage directions but also any legitimate use of them."))
+    bool bConstrainActionGrammar = false;
+
     UPROPERTY(BlueprintAssignable, Category = "LocalAIForNPCs|LLM|Actions", meta = (ToolTip = "Broadcast when the model outputs an action the NPC should perform."))
     FOnActionReceived OnActionReceived;
 
+    /** Ties the requests started from now on to Token. Cancelling it aborts them without broadcasting a response. */
+    void SetCancellationToken(const FCancellationTokenPtr& Token) { CancellationToken = Token; }
+
+    /** Embeds Text with the embedding server on a worker thread and calls OnComplete on the game thread. The result is empty on failure. */
+    void EmbedQuery(const FString& Text, TFunction<void(const TArray<float>&)> OnComplete);
+
+    /** Hash of the system prompt and the last NumTurns exchanges, identifying the context a reply was given in. */
+    uint32 GetConversationHash(int32 NumTurns) const;
+
+    /** Records an exchange that was answered without the model, so later turns see it in the history. */
+    void AppendExchange(const FString& Message, const FString& Response);
+
 private:
     TArray<FChatMessage> ChatHistory;
 
+    void AddToHistory(const FString& Role, const FString& Content);
+    void RequestTokenCount(const FString& Content);
+    int32 GetMessageTokens(const FChatMessage& Message) const;
+    void EnforceHistoryBudget();
+    void SummarizeEvictedHistory();
+    TSet<FString> PendingTokenCounts;
+    TArray<FChatMessage> EvictedHistory;
+    FString HistorySummary;
+    bool bIsSummarizing = false;
+
     void SendRequest();
     void SendRequestStreaming();
-    FString CreateJsonRequest();
+    FCancellationTokenPtr CancellationToken;
+    FCancellationTokenPtr GetCancellationToken();
+    void BuildRequestBody();
+    FChatRequestWriter RequestWriter;
+    TArray<uint8> RequestBody;
+
+    void BuildTurnContext(const TArray<FString>& Documents);
+    FString TurnContext;
+
+    int32 AssignedSlot = -1;
+    FGuid ConversationId;
+    void MarkSlotServed();
+    FString GetHistoryPrefix() const;
+    FCancellationTokenPtr WarmUpToken;
+    double LastWarmUpTime = -DBL_MAX;
 
     UFUNCTION()
     void HandleStreamChunk(const FString& PartialText, bool bDone);
-    FString AccumulatedChunk;
+    FStreamSentenceSegmenter SentenceSegmenter;
     FCriticalSection ChunkMutex;
 
-    FString SanitizeString(const FString& String);
-
-    TArray<FKnowledgeEntry> Knowledge;
-    TArray<float> EmbedText(const FString& Text);
-    void GenerateKnowledge();
-    float ComputeCosineSimilarity(const TArray<float>& A, const TArray<float>& B);
-    TArray<FString> GetTopKDocuments(const TArray<float>& QueryEmbedding);
-    TArray<FString> RerankDocuments(const FString& Query, const TArray<FString>& Documents);
+    /** RAG settings and state copied on the game thread, so retrieval and knowledge building never read the component from a worker. */
+    struct FRagContext
+    {
+        ERagMode RagMode = ERagMode::Disabled;
+        int32 EmbeddingPort = 0;
+        int32 RerankerPort = 0;
+        FString KnowledgePath;
+        int32 EmbeddingTopK = 0;
+        int32 RerankingTopN = 0;
+        int32 SentencesPerChunk = 0;
+        int32 SentenceOverlap = 0;
+        float SimilarityThreshold = 0.0f;
+        float LexicalScoreThreshold = 0.0f;
+        float LexicalWeight = 0.0f;
+        int32 EmbeddingBatchSize = 0;
+        int32 MaxConcurrentEmbeddingRequests = 0;
+        EKnowledgeIndexType KnowledgeIndexType = EKnowledgeIndexType::BruteForce;
+        FHnswParams Hnsw;
+        int32 HnswEfSearch = 0;
+        int32 HnswRecallQueries = 0;
+        EEmbeddingQuantization EmbeddingQuantization = EEmbeddingQuantization::None;
+        int32 QuantizedRescoreFactor = 0;
+        bool bUseEmbeddingCache = false;
+        FString EmbeddingModelName;
+        FString EmbeddingModelId;
+        int32 MaxEmbeddingCacheEntries = 0;
+        TSharedPtr<FEmbeddingCache, ESPMode::ThreadSafe> EmbeddingCache;
+        FKnowledgeHandle KnowledgeIndex;
+        TSharedPtr<FKnowledgeRegistry, ESPMode::ThreadSafe> Registry;
+    };
+    FRagContext MakeRagContext() const;
+
+    FKnowledgeHandle KnowledgeIndex;
+    static TArray<float> EmbedText(const FRagContext& Rag, const FString& Text, const FCancellationTokenPtr& Token);
+    FString LastQueryText;
+    TArray<float> LastQueryEmbedding;
+    static void RequestEmbeddings(const FRagContext& Rag, const TArray<FString>& Texts, TFunction<void(TArray<TArray<float>>&)> OnComplete);
+    static FKnowledgeHandle BuildKnowledge(const FRagContext& Rag, const TFunction<void(int32, int32)>& OnProgress);
+    FString BuildKnowledgeKey() const;
+    FString KnowledgeKey;
+    TWeakObjectPtr<UKnowledgeSubsystem> KnowledgeSubsystem;
+    static FString ResolveEmbeddingModelId(const FRagContext& Rag);
+    static FString GetEmbeddingCacheFile(const FString& ModelId);
+    static FString GetKnowledgeGraphFile(const FString& ModelId, const FKnowledgeIndex& Index);
+    TSharedPtr<FEmbeddingCache, ESPMode::ThreadSafe> EmbeddingCache;
+    FString EmbeddingModelId;
+    static TArray<FString> GetTopKDocuments(const FRagContext& Rag, const FString& Query, const TArray<float>& QueryEmbedding);
+    static TArray<FString> RerankDocuments(const FRagContext& Rag, const FString& Query, const TArray<FString>& Documents, const FCancellationTokenPtr& Token);
 
     void HandleNpcAction(const FString& ActionCommand);
     FString BuildActionsSystemMessage();
+    FString BuildActionGrammar() const;
+    FString ActionGrammar;
 
 protected:
     virtual void BeginPlay() override;
+    virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 };
\ No newline at end of file
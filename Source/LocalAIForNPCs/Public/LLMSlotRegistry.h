@@ -0,0 +1,42 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Process-wide bookkeeping of llama-server slots.
+ *
+ * LLM components configured for several slots, or for an explicit one, pin their conversation to one slot (id_slot)
+ * so the server can keep that conversation's prompt in the slot's KV cache between turns. The registry spreads components across the slots of each server
+ * and remembers which conversation a slot served last, so a turn can tell whether its prefix is still cached.
+ */
+class LOCALAIFORNPCS_API FLLMSlotRegistry
+{
+public:
+    static FLLMSlotRegistry& Get();
+
+    /** Reserves a slot on the server at Port. A non-negative PreferredSlot is honored, otherwise the least used slot is picked. */
+    int32 AcquireSlot(int32 Port, int32 NumSlots, int32 PreferredSlot = -1);
+
+    void ReleaseSlot(int32 Port, int32 Slot);
+
+    /** Records that Slot now serves ConversationId. Returns true if it already served it on the previous request. */
+    bool MarkServed(int32 Port, int32 Slot, const FGuid& ConversationId);
+
+    /** Returns true if ConversationId is the last conversation Slot served, so its prompt is likely still cached. */
+    bool IsServing(int32 Port, int32 Slot, const FGuid& ConversationId);
+
+    /** Reserves one of MaxInFlight speculative warm-up requests to the server at Port. Returns false if all are taken. */
+    bool TryBeginWarmUp(int32 Port, int32 MaxInFlight);
+    void EndWarmUp(int32 Port);
+
+private:
+    struct FSlotState
+    {
+        int32 NumUsers = 0;
+        FGuid LastConversation;
+    };
+
+    FCriticalSection Mutex;
+    TMap<int32, TArray<FSlotState>> SlotsByPort;
+    TMap<int32, int32> WarmUpsByPort;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Incremental parser for the raw HTTP/SSE byte stream returned by llama-server's streaming chat endpoint.
+ *
+ * Bytes can be fed exactly as they come out of the socket: the parser keeps its state between calls, so
+ * status lines, chunk-size lines, SSE lines and multi-byte UTF-8 sequences may be split across reads.
+ * Each complete "data:" event is scanned in place for choices[0].delta.content without building a JSON DOM.
+ */
+class LOCALAIFORNPCS_API FLLMStreamParser
+{
+public:
+    FLLMStreamParser();
+
+    void Reset();
+
+    /** Feeds raw socket bytes. Decoded tokens are appended to OutTokens. Returns true once the stream has finished. */
+    bool Feed(const uint8* Data, int32 NumBytes, TArray<FString>& OutTokens);
+
+    bool IsDone() const { return bDone; }
+    bool HasError() const { return bError; }
+    int32 GetStatusCode() const { return StatusCode; }
+
+    /** Body bytes received with a non-200 status, kept for logging. */
+    FString GetErrorBody() const;
+
+    /** Extracts choices[0].delta.content from a single JSON event. Returns false if the field is missing or null. */
+    static bool ExtractDeltaContent(const ANSICHAR* Json, int32 Len, TArray<ANSICHAR>& OutUtf8);
+
+private:
+    enum class EState : uint8
+    {
+        StatusLine,
+        Headers,
+        ChunkSize,
+        ChunkData,
+        ChunkDataEnd,
+        Body,
+        Finished
+    };
+
+    void ConsumeBody(const uint8* Data, int32 NumBytes, TArray<FString>& OutTokens);
+    void ProcessLine(const ANSICHAR* Line, int32 Len, TArray<FString>& OutTokens);
+    void ProcessHeaderLine(const ANSICHAR* Line, int32 Len);
+
+    EState State;
+    bool bChunked;
+    bool bDone;
+    bool bError;
+    int32 StatusCode;
+    int64 ChunkRemaining;
+
+    /** Bytes of an incomplete protocol line (status, header or chunk-size line). */
+    TArray<ANSICHAR> ProtocolLine;
+
+    /** Bytes of an incomplete SSE line, kept until its terminating newline arrives. */
+    TArray<ANSICHAR> EventLine;
+
+    /** Scratch buffer reused for every decoded token. */
+    TArray<ANSICHAR> TokenUtf8;
+
+    /** Raw body of an error response. */
+    TArray<ANSICHAR> ErrorBody;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FKnowledgeMatch;
+
+/**
+ * In-memory inverted index over knowledge chunks with Okapi BM25 scoring.
+ *
+ * Documents are tokenized into lowercase alphanumeric runs, so names, item IDs and quest codes match exactly.
+ * Postings are stored in one flat array per index once Finalize is called.
+ */
+class LOCALAIFORNPCS_API FLexicalIndex
+{
+public:
+    FLexicalIndex(float InK1 = 1.2f, float InB = 0.75f);
+
+    /** Adds the next document. Documents are numbered in the order they are added. */
+    void Add(FStringView Text);
+
+    /** Packs the postings and computes length statistics. Must be called before searching. */
+    void Finalize();
+
+    int32 Num() const { return DocLengths.Num(); }
+
+    /**
+     * Finds up to K documents sharing at least one term with Query, sorted by descending BM25 score. Function words
+     * are dropped from the query. Scores are divided by the highest score the query terms could reach, which puts them
+     * on a fixed 0..1 scale independent of the other matches; documents below MinScore are left out.
+     */
+    void Search(FStringView Query, int32 K, float MinScore, TArray<FKnowledgeMatch>& OutMatches) const;
+
+    /** True for common function and small-talk words, which carry no topic. Token must be lowercase. */
+    static bool IsStopWord(const FString& Token);
+
+    /** Calls Visit with every token of Text, lowercased. */
+    static void Tokenize(FStringView Text, TFunctionRef<void(const FString&)> Visit);
+
+private:
+    struct FPosting
+    {
+        int32 Doc;
+        int32 TermFrequency;
+    };
+
+    float K1;
+    float B;
+    float AverageDocLength = 0.0f;
+
+    TMap<FString, int32> TermIds;
+    TArray<int32> DocLengths;
+
+    /** Postings of term T are Postings[PostingOffsets[T] .. PostingOffsets[T + 1]). */
+    TArray<int32> PostingOffsets;
+    TArray<FPosting> Postings;
+
+    /** Per-term postings while documents are still being added. */
+    TArray<TArray<FPosting>> PendingPostings;
+};
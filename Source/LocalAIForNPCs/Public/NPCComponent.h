@@ -5,6 +5,7 @@
 #include "ASRComponent.h"
 #include "LLMComponent.h"
 #include "TTSComponent.h"
+#include "SemanticResponseCache.h"
 #include "NPCComponent.generated.h"
 
 class UPlayerComponent;
@@ -32,6 +33,12 @@ public:
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|ASR", meta = (ToolTip = "Port of the whisper.cpp server used for speech-to-text."))
     int32 ASRPort = 8000;
 
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|ASR", meta = (ClampMin = "1", ToolTip = "Maximum seconds of audio kept for one transcription. Longer recordings are cut off; with VAD, longer speech segments are sent early."))
+    float MaxBufferedSeconds = 30.0f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|ASR", meta = (ToolTip = "Quality of the conversion to 16 kHz before upload. Higher quality keeps more of the speech band at more CPU cost."))
+    EResamplerQuality ResamplerQuality = EResamplerQuality::Balanced;
+
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM", meta = (ToolTip = "Port used to communicate with the local LLaMA.cpp text-generation server."))
     int32 LLMPort = 8080;
 
@@ -41,16 +48,58 @@ public:
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM", meta = (ToolTip = "If enabled, responses stream token-by-token. If disabled, responses are returned all at once."))
     bool bStream = false;
 
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|Cache", meta = (ToolTip = "If enabled, the server keeps this conversation's prompt in its KV cache so follow-up turns only prefill the newly appended tokens."))
+    bool bCachePrompt = true;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|Cache", meta = (EditCondition = "bCachePrompt", EditConditionHides, ClampMin = "1", ToolTip = "Number of parallel slots the llama.cpp server was started with (--parallel). Above 1, NPCs are pinned to slots and spread across them. At 1 with no SlotId, no slot is requested and the server picks one itself."))
+    int32 NumServerSlots = 1;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|Cache", meta = (EditCondition = "bCachePrompt", EditConditionHides, ClampMin = "-1", ToolTip = "Server slot this NPC is pinned to. Use -1 to pick the least used slot automatically when NumServerSlots is above 1."))
+    int32 SlotId = -1;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|Cache", meta = (EditCondition = "bCachePrompt", EditConditionHides, ToolTip = "If enabled, the NPC's prompt is prefilled on its server slot when the player comes into range, so the first question only pays for its own tokens. With fewer slots than NPCs this may evict another NPC's cached prompt."))
+    bool bWarmUpOnApproach = false;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|Cache", meta = (EditCondition = "bCachePrompt && bWarmUpOnApproach", EditConditionHides, ClampMin = "0", ToolTip = "Minimum seconds between two prompt warm-ups of this conversation."))
+    float WarmUpCooldownSeconds = 30.0f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|Cache", meta = (EditCondition = "bCachePrompt && bWarmUpOnApproach", EditConditionHides, ClampMin = "1", ToolTip = "Maximum number of prompt warm-ups in flight at once on this server, across all NPCs."))
+    int32 MaxConcurrentWarmUps = 1;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|History", meta = (ClampMin = "0", ToolTip = "Maximum number of tokens of chat history sent with each request. Older turns are dropped once the budget is exceeded. Use 0 for no limit."))
+    int32 MaxHistoryTokens = 0;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|History", meta = (EditCondition = "MaxHistoryTokens > 0", EditConditionHides, ToolTip = "If enabled, turns dropped from the history are summarized in the background and the summary is prepended to the oldest message kept."))
+    bool bSummarizeEvictedHistory = true;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|ResponseCache", meta = (ToolTip = "If enabled, player messages that mean the same as an earlier one are answered with the earlier reply and speech, skipping the LLM and TTS servers. Needs the embedding server."))
+    bool bUseResponseCache = false;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|ResponseCache", meta = (EditCondition = "bUseResponseCache", EditConditionHides, ClampMin = "-1", ClampMax = "1", ToolTip = "Minimum cosine similarity between a message and a cached one for the cached reply to be used."))
+    float ResponseCacheThreshold = 0.92f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|ResponseCache", meta = (EditCondition = "bUseResponseCache", EditConditionHides, ClampMin = "0", ToolTip = "Number of preceding exchanges that must match for a cached reply to be used. 0 reuses replies regardless of the conversation so far."))
+    int32 ResponseCacheContextTurns = 0;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|ResponseCache", meta = (EditCondition = "bUseResponseCache", EditConditionHides, ClampMin = "1", ToolTip = "Maximum number of cached replies. The least recently used one is evicted first."))
+    int32 ResponseCacheMaxEntries = 64;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|ResponseCache", meta = (EditCondition = "bUseResponseCache", EditConditionHides, ClampMin = "0", ToolTip = "Seconds after which a cached reply is discarded. Use 0 to keep replies until they are evicted."))
+    float ResponseCacheMaxAgeSeconds = 0.0f;
+
+    UFUNCTION(BlueprintCallable, Category = "LocalAIForNPCs", meta = (ToolTip = "Discard all cached replies, for example after the NPC's situation has changed."))
+    void ClearResponseCache();
+
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (ToolTip = "Retrieval mode. Controls whether external knowledge is used and how it is retrieved."))
     ERagMode RagMode = ERagMode::Disabled;
 
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled", EditConditionHides, ToolTip = "Port for the LLaMA.cpp embedding server used for vectorizing documents."))
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled || bUseResponseCache", EditConditionHides, ToolTip = "Port for the LLaMA.cpp embedding server used for vectorizing documents and, with the response cache, player messages."))
     int32 EmbeddingPort = 8081;
 
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode == ERagMode::EmbeddingPlusReranker", EditConditionHides, ToolTip = "Port for the reranker server used in advanced RAG pipelines."))
     int32 RerankerPort = 8082;
 
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled", EditConditionHides, ToolTip = "Path to the knowledge directory or file(s) used for retrieval."))
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled", EditConditionHides, ToolTip = "Knowledge used for retrieval: a file, a directory (searched recursively for .txt and .md files), a wildcard pattern such as Lore/*.txt, or several of these separated by ';'."))
     FString KnowledgePath;
 
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled", EditConditionHides, ClampMin = "1", ToolTip = "Number of top embedding results to retrieve before reranking or passing to the model."))
@@ -65,15 +114,66 @@ public:
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled", EditConditionHides, ClampMin = "0", ToolTip = "Overlap between chunks, in number of sentences. Prevents context fragmentation."))
     int32 SentenceOverlap = 1;
 
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled", EditConditionHides, ClampMin = "-1", ClampMax = "1", ToolTip = "Minimum cosine similarity a retrieved chunk must meet to be considered relevant."))
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled", EditConditionHides, ClampMin = "-1", ClampMax = "1", ToolTip = "Minimum cosine similarity a retrieved chunk must meet to be considered relevant. In Hybrid mode a chunk is also kept if it meets the lexical score threshold instead."))
     float SimilarityThreshold = 0.5f;
 
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode == ERagMode::Lexical || RagMode == ERagMode::Hybrid", EditConditionHides, ClampMin = "0", ClampMax = "1", ToolTip = "Minimum keyword match a chunk must reach in Lexical mode, or to be kept in Hybrid mode without meeting the similarity threshold. The BM25 score is divided by the best score the query's words could reach, so 1 means every word matched strongly. Common words such as 'the' or 'how' are ignored."))
+    float LexicalScoreThreshold = 0.2f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode == ERagMode::Hybrid", EditConditionHides, ClampMin = "0", ClampMax = "1", ToolTip = "Share of the hybrid ranking score taken from BM25 keyword matching. The rest comes from embedding similarity. Which chunks are kept is decided by the two thresholds."))
+    float LexicalWeight = 0.5f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled", EditConditionHides, ClampMin = "0", ToolTip = "Maximum number of characters of retrieved context added to a single turn."))
+    int32 MaxRagContextCharacters = 2000;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled", EditConditionHides, ClampMin = "1", ToolTip = "Number of knowledge chunks sent in each embedding request."))
+    int32 EmbeddingBatchSize = 32;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled", EditConditionHides, ClampMin = "1", ToolTip = "Maximum number of embedding requests in flight while generating knowledge."))
+    int32 MaxConcurrentEmbeddingRequests = 4;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled", EditConditionHides, ToolTip = "How knowledge is searched. Brute force is exact; HNSW is approximate but scales to very large knowledge bases."))
+    EKnowledgeIndexType KnowledgeIndexType = EKnowledgeIndexType::BruteForce;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled && KnowledgeIndexType == EKnowledgeIndexType::HNSW", EditConditionHides, ClampMin = "2", ClampMax = "64", ToolTip = "Links per node in the HNSW graph. Higher improves recall and uses more memory."))
+    int32 HnswM = 16;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled && KnowledgeIndexType == EKnowledgeIndexType::HNSW", EditConditionHides, ClampMin = "2", ToolTip = "Candidate list size while building the HNSW graph. Higher builds a better graph, more slowly."))
+    int32 HnswEfConstruction = 200;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled && KnowledgeIndexType == EKnowledgeIndexType::HNSW", EditConditionHides, ClampMin = "1", ToolTip = "Candidate list size while searching the HNSW graph. Higher improves recall at the cost of latency."))
+    int32 HnswEfSearch = 64;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled && KnowledgeIndexType == EKnowledgeIndexType::HNSW", EditConditionHides, ClampMin = "0", ToolTip = "Number of test queries, each a knowledge chunk perturbed with random noise, used to log HNSW recall against the exact scan after building. 0 disables the measurement."))
+    int32 HnswRecallQueries = 0;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled", EditConditionHides, ToolTip = "How knowledge embeddings are stored in memory. Int8 uses about 4x less memory and Binary about 32x less, at some cost in retrieval accuracy."))
+    EEmbeddingQuantization EmbeddingQuantization = EEmbeddingQuantization::None;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled && EmbeddingQuantization != EEmbeddingQuantization::None", EditConditionHides, ClampMin = "1", ToolTip = "With quantized storage, how many candidates per requested result are rescored with the full-precision query. The rescore runs against the quantized rows, so scores keep their quantization error; mostly noticeable with Binary."))
+    int32 QuantizedRescoreFactor = 4;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled", EditConditionHides, ToolTip = "Reuse knowledge embeddings from the on-disk cache under Saved/ and keep recent query embeddings in memory."))
+    bool bUseEmbeddingCache = true;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled && bUseEmbeddingCache", EditConditionHides, ToolTip = "Identity of the embedding model, used to key cached embeddings. Leave empty to ask the embedding server."))
+    FString EmbeddingModelName;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled && bUseEmbeddingCache", EditConditionHides, ClampMin = "1", ToolTip = "Number of recent player query embeddings kept in memory."))
+    int32 QueryEmbeddingCacheSize = 128;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|RAG", meta = (EditCondition = "RagMode != ERagMode::Disabled && bUseEmbeddingCache", EditConditionHides, ClampMin = "0", ToolTip = "Maximum number of knowledge embeddings kept in the on-disk cache per embedding model. The least recently used are evicted when it is saved. Use 0 for no limit."))
+    int32 MaxEmbeddingCacheEntries = 100000;
+
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|Actions", meta = (ToolTip = "List of actions the NPC is allowed to perform. Used for function-calling-style model outputs."))
     TArray<FNpcAction> KnownActions;
 
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|Actions", meta = (ToolTip = "List of objects the NPC can reference or interact with, usable by the model during reasoning."))
     TArray<FNpcObject> KnownObjects;
 
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|LLM|Actions", meta = (ToolTip = "Constrain generation with a grammar built from the known actions and objects, so only valid action tags can be produced. Also shortens the actions system message. The grammar forbids the characters [, * and < anywhere in normal dialogue, which blocks *starred* and <tagged> stage directions but also any legitimate use of them."))
+    bool bConstrainActionGrammar = false;
+
     UPROPERTY(BlueprintAssignable, Category = "LocalAiNpc|Actions")
     FOnActionReceived OnActionReceived;
 
@@ -104,6 +204,9 @@ public:
     UFUNCTION(BlueprintCallable, Category = "LocalAIForNPCs", meta = (ToolTip = "Send a text message from the player to the NPC for processing by the LLM."))
     void SendText(FString Input);
 
+    UFUNCTION(BlueprintCallable, Category = "LocalAIForNPCs", meta = (ToolTip = "Abort the current conversation turn: stop recording, drop pending transcription, generation and speech, and hand the turn back to the player."))
+    void CancelConversationTurn();
+
     UPROPERTY()
     bool bIsUsersConversationTurn = true;
 
@@ -121,10 +224,29 @@ private:
 
     bool bIsRecording = false;
 
+    FCancellationTokenPtr TurnToken;
+    void BeginConversationTurn();
+    void SetTurnToken(const FCancellationTokenPtr& Token);
+
+    FSemanticResponseCache ResponseCache;
+    void RespondTo(const FString& Message);
+    void ReplayCachedResponse(const FString& Message, const FSemanticResponseCache::FEntry& Entry);
+    void TryCacheResponse();
+
+    // Reply being collected for the response cache; cleared when the turn cannot be cached.
+    bool bCollectingResponse = false;
+    TArray<float> PendingEmbedding;
+    uint32 PendingContextHash = 0;
+    FString PendingResponse;
+    bool bPendingResponseComplete = false;
+    int32 PendingClipsRequested = 0;
+    TArray<FSemanticResponseCache::FClip> PendingClips;
+
     bool bIsFirstChunk = true;
 
     UPlayerComponent* PlayerComponent;
 
 protected:
     virtual void BeginPlay() override;
+    virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 };
\ No newline at end of file
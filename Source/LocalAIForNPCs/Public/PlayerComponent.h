@@ -60,6 +60,15 @@ public:
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|VAD", meta = (EditCondition = "VadMode != EVadMode::Disabled", EditConditionHides, ClampMin = "0.1", ToolTip = "Minimum speech duration (in seconds) before audio is accepted for transcription."))
     float MinSpeechDuration = 0.5f;
 
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|VAD", meta = (EditCondition = "VadMode != EVadMode::Disabled", EditConditionHides, ClampMin = "1", ToolTip = "Consecutive speech frames required before speech is detected. Filters out clicks and short noises."))
+    int32 VadOnsetFrames = 2;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|VAD", meta = (EditCondition = "VadMode != EVadMode::Disabled", EditConditionHides, ClampMin = "0", ToolTip = "Milliseconds speech stays detected after the last speech frame, bridging short pauses between words."))
+    float VadHangoverMs = 200.0f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|VAD", meta = (EditCondition = "VadMode != EVadMode::Disabled", EditConditionHides, ClampMin = "0", ToolTip = "Milliseconds of audio before detected speech that are kept, so the first syllable is not cut off."))
+    float PreRollMs = 300.0f;
+
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|VAD", meta = (EditCondition = "VadMode == EVadMode::EnergyBased", EditConditionHides, ClampMin = "0.0", ClampMax = "1.0", ToolTip = "Energy threshold for speech detection when using Energy-based VAD."))
     float EnergyThreshold = 0.1f;
 
@@ -69,6 +78,12 @@ public:
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|VAD", meta = (EditCondition = "VadMode == EVadMode::TEN", EditConditionHides, ClampMin = "0", ClampMax = "1", ToolTip = "Confidence threshold for speech detection when using TEN VAD."))
     float TenVadThreshold = 0.75f;
 
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|VAD", meta = (EditCondition = "VadMode != EVadMode::Disabled", EditConditionHides, ClampMin = "1", ToolTip = "Maximum seconds of audio kept for one transcription. Longer speech segments are sent early."))
+    float MaxBufferedSeconds = 30.0f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|VAD", meta = (EditCondition = "VadMode != EVadMode::Disabled", EditConditionHides, ToolTip = "Quality of the conversion to 16 kHz for WebRTC/TEN VAD and uploads. Higher quality keeps more of the speech band at more CPU cost."))
+    EResamplerQuality ResamplerQuality = EResamplerQuality::Balanced;
+
 private:
     UPROPERTY(VisibleAnywhere)
     USphereComponent* InteractionSphere;
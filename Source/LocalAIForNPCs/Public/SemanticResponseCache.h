@@ -0,0 +1,53 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Past replies of one NPC, looked up by what the player's message means rather than its exact wording.
+ *
+ * Each entry keeps the normalized embedding of a player message, the reply and the speech clips synthesized for it.
+ * A new message close enough to a stored one, asked in the same conversation context, can be answered from the
+ * entry without the LLM or TTS servers. Entries past MaxAgeSeconds are dropped; beyond MaxEntries the least recently
+ * used one is evicted. Game thread only.
+ */
+class LOCALAIFORNPCS_API FSemanticResponseCache
+{
+public:
+    struct FClip
+    {
+        FString Text;
+        TArray<uint8> AudioData;
+    };
+
+    struct FEntry
+    {
+        TArray<float> Embedding;
+        uint32 ContextHash = 0;
+        FString Response;
+        TArray<FClip> Clips;
+        double CreatedTime = 0.0;
+        double LastUsedTime = 0.0;
+        int32 Hits = 0;
+    };
+
+    int32 MaxEntries = 64;
+
+    /** Entries older than this are dropped. 0 keeps them until evicted. */
+    double MaxAgeSeconds = 0.0;
+
+    /**
+     * Returns the most similar entry with the same context whose cosine similarity is at least Threshold, or nullptr.
+     * The entry stays valid until the cache is next modified.
+     */
+    const FEntry* Find(const TArray<float>& Embedding, uint32 ContextHash, float Threshold, float* OutScore = nullptr);
+
+    void Add(TArray<float> Embedding, uint32 ContextHash, const FString& Response, TArray<FClip> Clips);
+    void Empty();
+    int32 Num() const { return Entries.Num(); }
+
+private:
+    TArray<FEntry> Entries;
+
+    void RemoveExpired(double Now);
+    static bool Normalize(TArray<float>& Vector);
+};
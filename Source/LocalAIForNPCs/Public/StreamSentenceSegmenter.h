@@ -0,0 +1,44 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Splits streamed LLM text into complete sentences as tokens arrive.
+ *
+ * Each character is examined once, when it arrives. A sentence ends at a terminator (. ! ? ; and the CJK,
+ * Devanagari and Arabic equivalents), together with any closing quotes or brackets after it. The boundary is
+ * only confirmed by the next character, so "3.14", "..." and "?!" are not split. A '.' is not a boundary
+ * after a known abbreviation ("Mr.", "e.g.") or when a letter or digit follows it. Line breaks end a
+ * sentence immediately.
+ */
+class LOCALAIFORNPCS_API FStreamSentenceSegmenter
+{
+public:
+    FStreamSentenceSegmenter();
+
+    void Reset();
+
+    /** Appends streamed text and scans only the new characters. */
+    void Append(FStringView Text);
+
+    /** Moves all text up to the last confirmed sentence boundary into OutText. Returns false if no sentence is complete yet. */
+    bool PopSentences(FString& OutText);
+
+    /** Moves everything still buffered into OutText, complete or not, and resets the segmenter. */
+    void Flush(FString& OutText);
+
+private:
+    void ScanChar(int32 Index);
+    bool EndsWithAbbreviation(int32 DotIndex) const;
+
+    FString Buffer;
+
+    /** Text before this index forms complete sentences that have not been popped yet. */
+    int32 Boundary;
+
+    /** True while the last scanned characters are a terminator run waiting for the next character. */
+    bool bPendingTerminator;
+
+    /** True if the pending run is a single '.', which a following letter or digit cancels. */
+    bool bPendingDot;
+};
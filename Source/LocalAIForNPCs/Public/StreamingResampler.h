@@ -0,0 +1,57 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Polyphase windowed-sinc sample rate converter for a continuous mono stream.
+ *
+ * The filter history is kept between Process calls, so a stream fed in blocks converts exactly as if it were fed in
+ * one piece, without artifacts at block edges. Init designs the filter and allocates; Process and Flush do neither.
+ * Not thread-safe: use one instance per stream.
+ */
+class LOCALAIFORNPCS_API FStreamingResampler
+{
+public:
+    /**
+     * Sets up conversion from InputRate to OutputRate and clears the history. ZeroCrossings is the filter half-length
+     * in zero crossings of the sinc at the lower of the two rates; more is sharper and costs proportionally more.
+     */
+    void Init(int32 InputRate, int32 OutputRate, int32 ZeroCrossings);
+
+    bool IsInitialized(int32 InInputRate, int32 InOutputRate, int32 InZeroCrossings) const;
+
+    /** Clears the history, keeping the filter. */
+    void Reset();
+
+    /** Upper bound of the frames Process produces from NumInputFrames. */
+    int32 GetMaxOutputFrames(int32 NumInputFrames) const;
+
+    /** Converts NumInputFrames samples. OutSamples must hold GetMaxOutputFrames(NumInputFrames). Returns the frames written. */
+    int32 Process(const float* InSamples, int32 NumInputFrames, float* OutSamples);
+
+    /** Pushes the samples still inside the filter out, as at the end of a stream, then clears the history. OutSamples must hold GetMaxOutputFrames(GetNumTaps()). */
+    int32 Flush(float* OutSamples);
+
+    int32 GetNumTaps() const { return NumTaps; }
+
+private:
+    // The ratio is OutputRate / InputRate = Interpolation / Decimation, reduced.
+    int32 InputRate = 0;
+    int32 OutputRate = 0;
+    int32 Interpolation = 1;
+    int32 Decimation = 1;
+    int32 ZeroCrossings = 0;
+
+    // Coefficients of phase p are Coefficients[p * NumTaps, (p + 1) * NumTaps), newest input sample first.
+    TArray<float> Coefficients;
+    int32 NumTaps = 0;
+
+    // Every sample is written twice, NumTaps apart, so the newest NumTaps samples are always contiguous.
+    TArray<float> History;
+    int32 HistoryPos = 0;
+
+    // Position of the next output between the newest input sample and the one after it, in 1/Interpolation steps.
+    int32 Phase = 0;
+
+    int32 PushSample(float Sample, float* OutSamples);
+};
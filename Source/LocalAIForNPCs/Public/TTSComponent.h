@@ -2,6 +2,7 @@
 
 #include "CoreMinimal.h"
 #include "Components/SceneComponent.h"
+#include "CancellationToken.h"
 #include "TTSComponent.generated.h"
 
 USTRUCT(BlueprintType)
@@ -57,6 +58,12 @@ public:
     UFUNCTION(BlueprintCallable, Category = "LocalAIForNPCs|TTS", meta = (ToolTip = "Play raw audio data as speech."))
     void PlaySpeech(const TArray<uint8>& AudioData);
 
+    UFUNCTION(BlueprintCallable, Category = "LocalAIForNPCs|TTS", meta = (ToolTip = "Stop the line being spoken and drop all queued speech."))
+    void StopSpeech();
+
+    /** Ties the speech requests started from now on to Token. Cancelling it aborts them without broadcasting OnSoundReady. */
+    void SetCancellationToken(const FCancellationTokenPtr& Token) { CancellationToken = Token; }
+
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LocalAIForNPCs|TTS|LipSync", meta = (ToolTip = "Select which lip-sync system to use with generated speech."))
     ELipSyncMode LipSyncMode = ELipSyncMode::Disabled;
 
@@ -76,6 +83,12 @@ private:
 
     FSoundWaveWithDuration LoadSoundWaveFromWav(const TArray<uint8>& AudioData);
 
+    FCancellationTokenPtr CancellationToken;
+    FCancellationTokenPtr GetCancellationToken();
+
+    UPROPERTY()
+    UAudioComponent* ActiveAudio = nullptr;
+
     TQueue<FSoundWaveWithDuration> SoundQueue;
     FCriticalSection SoundQueueLock;
     bool bIsPlayingSound = false;
@@ -93,6 +106,7 @@ private:
     void PlayNextNeuroInQueue();
     void NeuroFinishedHandler();
     void PlaySoundWithNeuroSync(const TArray<uint8>& AudioData);
+    void PlayNeuroSound(const FSoundWaveWithDuration& Sound, bool bSynced);
 
     TQueue<TArray<uint8>> A2FQueue;
     FCriticalSection A2FQueueLock;
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+enum class ETextSanitizeFlags : uint8
+{
+    None = 0,
+    /** Removes [[action: ...]] tags. The tag may not span a line break. */
+    ActionTags = 1 << 0,
+    /** Removes [bracketed] stage directions. */
+    Brackets = 1 << 1,
+    /** Removes *starred* stage directions. */
+    Asterisks = 1 << 2,
+    /** Removes <html-like> tags. */
+    HtmlTags = 1 << 3,
+    /** Removes double quotes. */
+    Quotes = 1 << 4,
+    /** Replaces \r and \n with spaces. */
+    Newlines = 1 << 5,
+    /** Trims leading and trailing whitespace. */
+    Trim = 1 << 6,
+
+    ASR = Brackets | Asterisks | Quotes | Newlines | Trim,
+    LLM = ASR | ActionTags | HtmlTags
+};
+ENUM_CLASS_FLAGS(ETextSanitizeFlags);
+
+/**
+ * Strips stage directions and markup from model output in a single left-to-right pass, without regex.
+ *
+ * Each opening delimiter is matched with the first closing delimiter after it, like the non-nesting patterns
+ * \[[^\]]*\], \*[^\*]*\* and <[^>]*>. An opener without a closer is kept as plain text. Once a search for a
+ * closer has failed, that result is remembered for the rest of the string, so the cost stays linear in the input.
+ */
+class LOCALAIFORNPCS_API FTextSanitizer
+{
+public:
+    static FString Sanitize(FStringView Text, ETextSanitizeFlags Flags);
+
+    /** Same as Sanitize, but writes into Out so a caller can reuse its allocation. */
+    static void SanitizeInto(FStringView Text, ETextSanitizeFlags Flags, FString& Out);
+};